@@ -1,10 +1,10 @@
 #pragma once
 #include "common/Logger.h"
 
-#define GameLogError    (gameLogger << Arya::L_ERROR)
-#define GameLogWarning  (gameLogger << Arya::L_WARNING)
-#define GameLogInfo     (gameLogger << Arya::L_INFO)
-#define GameLogDebug    (gameLogger << Arya::L_DEBUG)
+#define GameLogError    ARYA_LOG(gameLogger, Arya::L_ERROR)
+#define GameLogWarning  ARYA_LOG(gameLogger, Arya::L_WARNING)
+#define GameLogInfo     ARYA_LOG(gameLogger, Arya::L_INFO)
+#define GameLogDebug    ARYA_LOG(gameLogger, Arya::L_DEBUG)
 
 using Arya::endLog;
 
@@ -3,12 +3,18 @@
 #include "AnimationBase.h"
 #include <vector>
 #include <map>
+#include <memory>
 
 using std::vector;
 using std::map;
 
 namespace Arya
 {
+    using std::shared_ptr;
+
+    class JobSystem;
+    class VertexAnimationSystem;
+
     struct VertexAnim
     {
         int startFrame; //inclusive
@@ -19,38 +25,119 @@ namespace Arya
     class VertexAnimationData : public AnimationData
     {
         public:
+            VertexAnimationData() : system(0), systemClipBase(-1) {}
+
             unique_ptr<AnimationState> createAnimationState() const;
 
-            map<string, VertexAnim> animations;
+            //! Returns the clip id, which can be used instead of the
+            //! name to set an animation without string lookups
+            int addClip(const string& name, const VertexAnim& anim);
+            //! Returns -1 if there is no clip with this name
+            int getClipId(const string& name) const;
+
+            const vector<VertexAnim>& getClips() const { return clips; }
+
+        private:
+            vector<VertexAnim> clips;
+            map<string, int> clipIds;
+
+            //Index of the first clip in the tables of VertexAnimationSystem
+            friend class VertexAnimationSystem;
+            mutable const VertexAnimationSystem* system;
+            mutable int systemClipBase;
+    };
+
+    //! Advances all vertex animations at once
+    //! The state of every animation is stored in a slot: a position in
+    //! a set of arrays (clip, frame, timer, speed) so that they can
+    //! be updated in a few tight loops.
+    //! A slot can be shared by multiple entities that play the same
+    //! clip in phase (crowds), so it is only advanced once.
+    //! World owns the system and updates it in World::update
+    class VertexAnimationSystem
+    {
+        public:
+            VertexAnimationSystem();
+            ~VertexAnimationSystem();
+
+            //! Advances all animations, in parallel when jobs is nonzero
+            void update(float elapsedTime, JobSystem* jobs);
+
+            //! Returns a new slot that plays nothing
+            int createSlot();
+            //! Returns the shared slot for this clip, creating it when needed
+            int acquireSharedSlot(const VertexAnimationData* data, int clipId);
+            //! Returns a new slot that is not shared, at the same
+            //! point in the same clip as slot s
+            int cloneSlot(int s);
+            void releaseSlot(int slot);
+            bool isShared(int slot) const { return sharedKey[slot] >= 0; }
+
+            void setClip(int slot, const VertexAnimationData* data, int clipId);
+            void setSpeed(int slot, float s) { speed[slot] = s; }
+            float getSpeed(int slot) const { return speed[slot]; }
+            //! Sum of the frame times of the clip, 0 if no clip
+            float getClipDuration(int slot) const;
+
+            int getFrame(int slot) const { return clip[slot] < 0 ? 0 : clipStartFrame[clip[slot]] + frame[slot]; }
+            float getInterpolation(int slot) const { return interpolation[slot]; }
+
+            unsigned int getSlotCount() const { return clip.size(); }
+
+        private:
+            //Per slot
+            vector<int> clip; //index into the clip tables, -1 for none
+            vector<int> frame; //relative to the start frame of the clip
+            vector<float> timer;
+            vector<float> speed;
+            vector<float> frameTime; //duration of the current frame
+            vector<float> interpolation;
+            vector<int> refCount;
+            vector<int> sharedKey; //clip index when shared, -1 otherwise
+            vector<int> freeSlots;
+
+            //Per clip, for the clips of all registered VertexAnimationData
+            vector<int> clipStartFrame;
+            vector<int> clipFrameCount;
+            vector<int> clipTimesOffset;
+            vector<float> frameTimes;
+            map<int, int> sharedSlots; //clip index to slot
+
+            int getClipIndex(const VertexAnimationData* data, int clipId);
+            void advance(unsigned int begin, unsigned int end, float elapsedTime);
     };
 
     class VertexAnimationState : public AnimationState
     {
         public:
-            VertexAnimationState(const VertexAnimationData* data);
+            VertexAnimationState(const VertexAnimationData* data, shared_ptr<VertexAnimationSystem> system);
             ~VertexAnimationState();
 
             //Base class overloads
             void setAnimation(string name);
 
-            void updateAnimation(float elapsedTime);
+            //! The VertexAnimationSystem advances the animation
+            void updateAnimation(float) {}
 
-            int getCurFrame(){ return startFrame + curFrame; }
-            float getInterpolation(){ return interpolation; }
+            int getCurFrame(){ return system->getFrame(slot); }
+            float getInterpolation(){ return system->getInterpolation(slot); }
 
             float getAnimationTime();
             void setAnimationTime(float newTime);
 
-        private:
-            const VertexAnimationData* animData;
+            //! Set the animation by id, see VertexAnimationData::getClipId
+            void setAnimation(int clipId);
+            //! Play the animation in phase with all other entities
+            //! that play it shared. These share one slot.
+            void setSharedAnimation(int clipId);
 
-            const VertexAnim* curAnim; //one of the animations in animData
+            const VertexAnimationData* getAnimationData() const { return animData; }
 
-            int startFrame;
-            int curFrame; //current frame RELATIVE TO STARTFRAME
-            float timer;
-            float interpolation; //in range [0,1]
-            float speedFactor;
+        private:
+            const VertexAnimationData* animData;
+            shared_ptr<VertexAnimationSystem> system;
+            int slot;
+            int curClip;
     };
 
 }
@@ -1,19 +1,22 @@
 #pragma once
 #include "GraphicsComponent.h"
+#include "Pool.h"
 
 namespace Arya
 {
     using std::shared_ptr;
 
-    class BillboardGraphicsComponent : public GraphicsComponent
+    class BillboardGraphicsComponent : public GraphicsComponent, public PoolAllocated<BillboardGraphicsComponent>
     {
         public:
             BillboardGraphicsComponent(){ screenOffset = vec2(0.0f); screenSize = vec2(1.0f); };
             ~BillboardGraphicsComponent(){};
             RenderType getRenderType() const override { return TYPE_BILLBOARD; }
 
-            void setScale(const vec3& _scale) override { scale = vec2(_scale); }
+            void setScale(const vec3& _scale) override { scale = vec2(_scale); scaleChanged(); }
             vec3 getScale() const override { return vec3(scale.x, scale.y, 1.0f); }
+            //! The quad faces the camera so it can be rotated in any way
+            bool getLocalBounds(vec3& boxMin, vec3& boxMax) const override { boxMin = vec3(-1.0f); boxMax = vec3(1.0f); return true; }
 
             virtual void setScreenOffset(const vec2& offset) override { screenOffset = offset; }
             virtual vec2 getScreenOffset() const override { return screenOffset; }
@@ -22,6 +25,7 @@ namespace Arya
             virtual vec2 getScreenSize() const { return screenSize; }
 
             Material* getMaterial() const { return material.get(); }
+            const shared_ptr<Material>& getSharedMaterial() const { return material; }
             void setMaterial(shared_ptr<Material> mat) { material = mat; }
         private:
             shared_ptr<Material> material;
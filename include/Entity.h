@@ -1,9 +1,12 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include "ShaderUniformBase.h"
+#include "Pool.h"
+#include "UniformBlock.h"
 
 namespace Arya
 {
@@ -19,11 +22,28 @@ namespace Arya
     class Material;
     class Primitive;
     class GraphicsComponent;
+    class World;
+
+    //! Refers to an entity in World without owning it
+    //! A handle to a deleted entity is detected by its generation,
+    //! World::getEntity returns nullptr for such a handle
+    struct EntityHandle
+    {
+        uint32_t index;
+        uint32_t generation;
+
+        EntityHandle() : index(~0u), generation(0) {}
+        EntityHandle(uint32_t i, uint32_t g) : index(i), generation(g) {}
+
+        bool operator==(const EntityHandle& h) const { return index == h.index && generation == h.generation; }
+        bool operator!=(const EntityHandle& h) const { return !(*this == h); }
+    };
 
     //! The user can subclass EntityUserData
     class EntityUserData {};
 
-    class Entity : public ShaderUniformBase
+    //! Entities are allocated from a pool
+    class Entity : public ShaderUniformBase, public PoolAllocated<Entity>
     {
         private:
             // For details on this, see
@@ -36,21 +56,35 @@ namespace Arya
             explicit Entity(const this_is_private&);
             ~Entity();
 
-            //! Create an entity and add a weak reference to it in World
+            //! Create an entity and add it to World
+            //! The shared_ptr owns the entity, it is removed
+            //! from World when the last reference is gone.
+            //! See World::createEntity for entities owned by World
             static shared_ptr<Entity> create();
 
+            //! The handle of this entity in World
+            EntityHandle getHandle() const { return handle; }
+
             inline const vec3& getPosition() const { return position; }
             inline vec2 getPosition2() const { return vec2(position.x, position.y); }
             inline float getPitch() const { return pitch; }
             inline float getYaw() const { return yaw; }
 
-            inline void setPosition(const vec3& pos) { position = pos; updateMatrix(); }
-            inline void setPitch(float p) { pitch = p; updateMatrix(); }
-            inline void setYaw(float y) { yaw = y; updateMatrix(); }
+            void setPosition(const vec3& pos);
+            void setPitch(float p);
+            void setYaw(float y);
 
-            inline void setParent(shared_ptr<Entity> ent) { parent = ent; }
+            void setParent(shared_ptr<Entity> ent);
             inline shared_ptr<Entity> getParent() const { return parent.lock(); }
 
+            //! Move matrix based on position, orientation, graphics scale and parent
+            //! as computed by the last World update
+            const mat4& getMoveMatrix() const;
+            //! Move matrix to draw the entity with, see World::setInterpolation
+            mat4 getRenderMatrix() const;
+            //! Id of the transform in the TransformSystem of World
+            uint32_t getTransform() const { return transform; }
+
             //! Updates all components
             void update(float elapsedTime);
 
@@ -62,16 +96,25 @@ namespace Arya
             void setGraphics(unique_ptr<GraphicsComponent> gr);
 
             //! Creates a ModelGraphicsComponent with the specified model
+            //! An existing ModelGraphicsComponent is reused and its scale reset,
+            //! see ModelGraphicsComponent::setModel
             void setGraphics(shared_ptr<Model> model);
 
             //! Creates a BillboardGraphicsComponent with the specified material
             void setGraphics(shared_ptr<Material> material);
 
+            //! Per entity uniforms, used by shaders whose uniform defaults
+            //! have the same layout, see ShaderProgram::setUniformDefaults
+            void setUniformBlock(unique_ptr<UniformBlock> block) { uniformBlock = std::move(block); }
+            UniformBlock* getUniformBlock() { return uniformBlock.get(); }
+            const UniformBlock* getUniformBlock() const { return uniformBlock.get(); }
+
             void setUserData(EntityUserData* data) { userData = data; }
             EntityUserData* getUserData() const { return userData; }
 
         private:
-            //cached movematrix version of position, pitch, yaw, scale is in GraphicsComponent
+            //the move matrix is kept in the TransformSystem of World
+            //scale is in GraphicsComponent
             vec3 position;
             float pitch;
             float yaw;
@@ -79,9 +122,19 @@ namespace Arya
             EntityUserData* userData;
             weak_ptr<Entity> parent;
 
-            void updateMatrix();
+            //Set by World
+            friend class World;
+            World* world;
+            EntityHandle handle;
+            uint32_t transform;
+            uint32_t bounds; //proxy in the SpatialIndex of World
+
+            friend class GraphicsComponent;
+            void updateScale();
+            void updateBounds();
 
             //Components
             unique_ptr<GraphicsComponent> graphicsComponent;
+            unique_ptr<UniformBlock> uniformBlock;
     };
 }
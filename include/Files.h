@@ -41,6 +41,18 @@ namespace Arya
         //! When the caller is done it should call releaseFile
         File* getFile(string filename);
 
+        //! Adds file data that was read from disk elsewhere,
+        //! for example by the Preloader. The FileSystem takes ownership
+        //! of data, which must have two zero bytes after size.
+        //! Adds a reference to File, like getFile
+        File* addFile(string filename, char* data, unsigned int size);
+
+        //! Reads a file from disk without adding it to the FileSystem
+        //! Data is allocated with new[] and followed by two zero bytes
+        //! This does not touch the list of loaded files so it
+        //! can be called from any thread
+        bool readFromDisk(const string& filename, char*& data, unsigned int& size) const;
+
         //! Releases the file. When the reference count is zero
         //! the file is removed from memory
         void releaseFile(File* file);
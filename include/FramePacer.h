@@ -0,0 +1,114 @@
+//Frame pacing
+//
+//Root calls FramePacer::limit right before swapping the buffers and
+//FramePacer::frameDone right after.
+//
+//limit waits until the next frame is due when a target rate is set.
+//It sleeps for most of the remaining time, so the CPU is idle, and spins
+//for the last part because the sleep of the OS is not precise. The spin
+//margin follows the largest oversleep that was measured.
+//
+//frameDone measures the time between two swaps. The last frames are kept
+//so that percentiles of the frame time can be shown (console command
+//"framestats") and are written to a file when the game loop stops.
+//
+//When latency measurement is on, Root passes the SDL timestamp of every
+//input event it handles to inputEvent, and frameDone measures the time
+//from the event to the swap of the frame in which it was handled.
+//SDL timestamps have millisecond resolution.
+
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace Arya
+{
+    using std::vector;
+    using std::string;
+
+    enum VsyncMode
+    {
+        VSYNC_OFF,
+        VSYNC_ON,
+        //Does not wait for the vertical retrace when the frame is late,
+        //falls back to VSYNC_ON when the driver does not support it
+        VSYNC_ADAPTIVE
+    };
+
+    struct FrameStats
+    {
+        unsigned int frameCount; //frames the percentiles are taken over
+        float p50, p95, p99, max; //in milliseconds
+        float average;
+        unsigned int missedFrames; //frames that took more than 1.5 times the target
+    };
+
+    class FramePacer
+    {
+        public:
+            FramePacer();
+
+            //! Frames per second, 0 (default) for no limit
+            void setTargetRate(float hz);
+            float getTargetRate() const { return targetRate; }
+
+            //! Sets the swap interval of the current OpenGL context
+            //! Returns the mode that is in use
+            VsyncMode setVsync(VsyncMode mode);
+            VsyncMode getVsync() const { return vsync; }
+
+            //! Waits until the next frame is due
+            void limit();
+            //! Records the time since the previous frame
+            void frameDone();
+
+            //! Statistics of the last frames
+            FrameStats getStats() const;
+            //! Statistics since start or reset
+            FrameStats getSessionStats() const;
+            void resetStats();
+
+            //! Input to swap latency (console command "inputlatency on|off")
+            void setLatencyMeasurement(bool enable);
+            bool isMeasuringLatency() const { return measureLatency; }
+            //! timestamp in milliseconds, as in SDL events
+            void inputEvent(uint32_t timestamp);
+            //! Statistics of the last events, missedFrames is unused
+            FrameStats getLatencyStats() const;
+
+            //! Human readable summary
+            string getStatsText() const;
+            bool writeStats(const string& filename) const;
+
+        private:
+            float targetRate;
+            VsyncMode vsync;
+
+            double frequency; //performance counter ticks per second
+            uint64_t nextFrame; //performance counter value at which the next frame is due
+            uint64_t lastFrame; //of the previous frameDone
+            double spinMargin; //seconds
+
+            //Frame times in seconds, the last frames in a ring buffer
+            static const unsigned int windowSize = 1024;
+            vector<float> window;
+            unsigned int windowPos;
+
+            //Since start or reset, also in a histogram of 0.1 ms buckets
+            //so percentiles can be taken over long sessions
+            static const unsigned int bucketCount = 1000;
+            vector<unsigned int> histogram;
+            unsigned int sessionFrames;
+            unsigned int sessionMissed;
+            double sessionTotal;
+            float sessionMax;
+
+            bool measureLatency;
+            vector<uint32_t> frameEvents; //timestamps of the input of this frame
+            vector<float> latencies; //ring buffer of windowSize
+            unsigned int latencyPos;
+
+            FrameStats computeStats(vector<float> times) const;
+    };
+}
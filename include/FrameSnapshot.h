@@ -0,0 +1,82 @@
+//Frame snapshot
+//
+//Everything Graphics needs to draw the world for one frame: the camera,
+//the light and a draw packet per visible entity, copied out of World
+//by Graphics::buildSnapshot. Drawing a snapshot does not read World, so
+//the world can be drawn while the next frame is being simulated
+//(see Root::setThreadedSimulation).
+//
+//The snapshot keeps the models and materials it draws alive, so an entity
+//can release its model while an older snapshot is still being drawn.
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include "GraphicsComponent.h"
+
+namespace Arya
+{
+    using std::vector;
+    using std::shared_ptr;
+    using glm::vec2;
+    using glm::mat4;
+
+    class Model;
+    class Material;
+    class UniformLayout;
+    class ShaderUniformBase;
+
+    struct DrawPacket
+    {
+        RenderType type; //TYPE_MODEL or TYPE_BILLBOARD
+        Model* model;
+        Material* material; //billboards
+        mat4 moveMatrix;
+        int frame;
+        float interpolation;
+        vec2 screenOffset; //billboards
+        vec2 screenSize; //billboards
+        uint32_t entityIndex; //handle index of the entity, for picking
+        //Copy of the UniformBlock of the entity in FrameSnapshot::uniformData
+        const UniformLayout* uniformLayout; //nullptr when the entity has no block
+        unsigned int uniformOffset;
+        //For the custom uniform callbacks of shaders. This is the entity itself,
+        //so it is nullptr when the snapshot is drawn while World is updated
+        ShaderUniformBase* uniformSource;
+    };
+
+    struct FrameSnapshot
+    {
+        mat4 viewMatrix;
+        mat4 vpMatrix;
+        mat4 lightMatrix;
+
+        vector<DrawPacket> packets; //inside the view frustum
+        vector<DrawPacket> shadowPackets; //models inside the box of the shadow map
+        vector<char> uniformData;
+
+        //References that keep the drawn resources alive
+        vector<shared_ptr<Model> > models;
+        vector<shared_ptr<Material> > materials;
+        vector<shared_ptr<const UniformLayout> > layouts;
+
+        void clear()
+        {
+            packets.clear();
+            shadowPackets.clear();
+            uniformData.clear();
+            releaseResources();
+        }
+        //! Should be called where the resources may be deleted, which is
+        //! on the thread of the OpenGL context
+        void releaseResources()
+        {
+            models.clear();
+            materials.clear();
+            layouts.clear();
+        }
+    };
+}
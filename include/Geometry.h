@@ -4,12 +4,34 @@
 //
 //This Geometry class is one specific for OpenGL but it should
 //be so general that it can be replaced by a DirectX one
+//
+//Animated geometry is stored in one of two ways:
+// - One VAO per frame, with attribute pointers into a vertex buffer
+//   that holds all frames
+// - A frame texture: a texture buffer with the position and normal of
+//   every vertex in every frame. There is a single VAO and the vertex shader
+//   fetches the vertices of the current and next frame by gl_VertexID.
+//   This allows instanced drawing of many animated entities at once.
 #pragma once
 
 #include <GL/glew.h>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
 
 namespace Arya
 {
+    using std::vector;
+    using glm::vec4;
+    using glm::mat4;
+
+    //! Per instance data for instanced drawing of geometry with a frame texture
+    struct GeometryInstance
+    {
+        mat4 moveMatrix;
+        vec4 animation; //current frame, next frame, interpolation, unused
+    };
+
     class Geometry
     {
         public:
@@ -23,13 +45,30 @@ namespace Arya
             void setVertexBufferData(int size, void* data);
             void setIndexBufferData(int size, void* data);
 
-            void createVAOs(int frameCount);
+            void createVAOs(int vaoCount);
 
             void bindVAO(int vaoIndex);
             void setVAOdata(int attribArrayIndex, int components,
                     int stride, int offset);
 
+            //! Stores all frames in a texture buffer
+            //! data contains frameCount frames of vertexCount vertices,
+            //! every vertex has floatCount floats: position, texcoord, normal (optional)
+            //! nextFrames gives the frame to interpolate to for every frame
+            //! Returns false if the data does not fit in a texture buffer
+            //! Call this after setting frameCount and vertexCount
+            bool createFrameTexture(const GLfloat* data, int floatCount, const vector<int>& nextFrames);
+            bool hasFrameTexture() const { return frameTexture != 0; }
+            GLuint getFrameTexture() const { return frameTexture; }
+            int getNextFrame(int frame) const { return nextFrames[frame]; }
+
+            //! Adds the per instance attributes (GeometryInstance) to the bound VAO
+            //! at attribute index firstAttrib (mat4, 4 indices) and firstAttrib + 4 (vec4)
+            void createInstanceBuffer(int firstAttrib);
+
             void draw(int frame = 0);
+            //! Requires createInstanceBuffer
+            void drawInstanced(const GeometryInstance* instances, int instanceCount);
 
             int frameCount; //1 for static models
             GLsizei vertexCount; //PER FRAME
@@ -40,8 +79,16 @@ namespace Arya
             float maxX, maxY, maxZ;
 
         private:
-            GLuint* vaoHandles; //a list of framecount handles
+            GLuint* vaoHandles; //a list of vaoCount handles
+            int vaoCount; //frameCount, or 1 when using a frame texture
             GLuint vertexBuffer;
             GLuint indexBuffer;
+
+            GLuint frameTexture;
+            GLuint frameTextureBuffer;
+            vector<int> nextFrames;
+
+            GLuint instanceBuffer;
+            int instanceBufferSize; //in instances
     };
 }
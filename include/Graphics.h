@@ -1,6 +1,9 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <map>
+#include <atomic>
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 
@@ -8,6 +11,8 @@ namespace Arya {
 
 using std::shared_ptr;
 using std::make_shared;
+using std::vector;
+using std::weak_ptr;
 using glm::vec2;
 using glm::mat4;
 
@@ -20,10 +25,14 @@ class Renderer;
 class ImageView;
 class Interface;
 class RenderTarget;
+class PixelReadback;
+class UniformBlock;
 class ShaderProgram;
 class GraphicsComponent;
 class ModelGraphicsComponent;
 class BillboardGraphicsComponent;
+struct DrawPacket;
+struct FrameSnapshot;
 
 class Graphics
 {
@@ -47,6 +56,15 @@ class Graphics
         void render(World* world);
         void render(Interface* interface);
 
+        //! Copies everything needed to draw the visible part of the world
+        //! into snapshot, so that it can be drawn while the world changes.
+        //! When threaded is set the snapshot keeps the models and materials
+        //! alive and contains no pointers to entities, so custom uniform
+        //! callbacks of shaders are not called for it
+        void buildSnapshot(World* world, FrameSnapshot& snapshot, bool threaded);
+        //! Draws a snapshot made by buildSnapshot
+        void render(const FrameSnapshot& snapshot);
+
         //! Update camera
         void update(float elapsed);
 
@@ -54,6 +72,15 @@ class Graphics
         //! to [-1,1] coordinates with (-1,-1) bottom left
         vec2 normalizeMouseCoordinates(int x, int y);
 
+        //! Picking: every frame, the ids of the entities around the pick position
+        //! are rendered into an id buffer. The id under the position is read back
+        //! asynchronously, so the result is one or two frames old
+        void setPickingEnabled(bool enable);
+        //! Pixel coordinates with origin top left, like the mouse position
+        void setPickPosition(int x, int y) { pickX = x; pickY = y; }
+        //! The entity under the pick position, or nullptr
+        Entity* getPickedEntity() const;
+
         Renderer*       getRenderer() const { return renderer; }
         Camera*         getCamera() const { return camera; }
 
@@ -75,14 +102,47 @@ class Graphics
 
         shared_ptr<RenderTarget> shadowRenderTarget;
         shared_ptr<ShaderProgram> billboardShader;
+        shared_ptr<UniformBlock> billboardUniforms; //screenOffset, screenSize
+        unsigned int billboardOffsetField, billboardSizeField;
         shared_ptr<ShaderProgram> viewShader;
         shared_ptr<Geometry> quad2dGeometry;
 
-        // The Entity is temporary untill shader-uniform-setting has
-        // been moved into render()
+        // Result of the frustum queries on World, reused every frame
+        vector<Entity*> visibleEntities;
+        // Used by render(World*)
+        FrameSnapshot* frameSnapshot;
+        void addPacket(Entity* e, FrameSnapshot& snapshot, bool shadowPass, bool threaded);
+
+        bool pickingEnabled;
+        int pickX, pickY;
+        std::atomic<unsigned int> pickedId; //handle index + 1, 0 for nothing
+        shared_ptr<RenderTarget> pickRenderTarget;
+        PixelReadback* pickReadback;
+        // Picking variant of every shader, created on first use
+        struct PickShader
+        {
+            weak_ptr<ShaderProgram> original;
+            shared_ptr<ShaderProgram> picking;
+        };
+        std::map<ShaderProgram*, PickShader> pickShaders;
+        ShaderProgram* getPickShader(const shared_ptr<ShaderProgram>& shader);
+        void renderPicking(const FrameSnapshot& snapshot);
+
         void renderView(View* view);
-        void renderModel(ModelGraphicsComponent* gr, Entity* e, bool shadowPass);
-        void renderBillboard(BillboardGraphicsComponent* gr, Entity* e);
+        //! shader overrides the shader of the model or billboard, for picking
+        void renderModel(const DrawPacket& packet, const FrameSnapshot& snapshot, bool shadowPass, ShaderProgram* shader = 0);
+        //! The SHADOW_ONLY variant of shader when it has one, otherwise shader
+        ShaderProgram* shadowVariant(ShaderProgram* shader);
+
+        //! Entities with a model that supports instancing are collected
+        //! per model and drawn together by renderInstances
+        //! Returns false if the model does not support it
+        bool addInstance(const DrawPacket& packet);
+        void renderInstances(const FrameSnapshot& snapshot, bool shadowPass);
+        void uploadInstanceBlocks(ShaderProgram* shader, const FrameSnapshot& snapshot, const DrawPacket* const* packets, unsigned int count);
+        struct InstanceBatches;
+        InstanceBatches* instanceBatches;
+        void renderBillboard(const DrawPacket& packet, const FrameSnapshot& snapshot, ShaderProgram* shader = 0);
 };
 
 } // namespace Arya
@@ -23,17 +23,14 @@ namespace Arya
     class GraphicsComponent
     {
         public:
-            GraphicsComponent() { updateMatrix = true; }
+            GraphicsComponent() { ent = 0; }
             virtual ~GraphicsComponent() {}
             // RenderType determines the subclass of GraphicsComponent
             virtual RenderType getRenderType() const { return TYPE_NONE; }
 
             // Get the move matrix based on Entity position, orientation and graphics scale
-            const mat4& getMoveMatrix();
-            // Little hack for dirty matrix optimization
+            const mat4& getMoveMatrix() const;
             void setEntity(Entity* e) { ent = e; }
-            inline void setDirty() { updateMatrix = true; }
-            bool isDirty() const;
 
             // Subclasses can choose which of these they actually implement
 
@@ -41,6 +38,11 @@ namespace Arya
             virtual void setScale(const vec3& /* scale */) { return; }
             virtual vec3 getScale() const { return vec3(1.0f); }
 
+            //! Bounding box in model space, before the move matrix
+            //! Returns false if there are no bounds, then the entity
+            //! is treated as a point
+            virtual bool getLocalBounds(vec3& /* boxMin */, vec3& /* boxMax */) const { return false; }
+
             //! Set scale in x,y,z directions simultaneously
             void setScale(float scale) { return setScale(vec3(scale)); }
 
@@ -63,10 +65,14 @@ namespace Arya
             //! Usefull for making attack animations depend on attack speed
             virtual void setAnimationTime(float /* time */) { return; }
 
+        protected:
+            // Subclasses call this when the value of getScale changes
+            void scaleChanged();
+            // Subclasses call this when the value of getLocalBounds changes
+            void boundsChanged();
+
         private:
             Entity* ent;
-            mat4 mMatrix; //cached version of position, pitch, yaw, graphics.Scale
-            bool updateMatrix;
     };
 
 }
@@ -0,0 +1,87 @@
+//Input recording and replay
+//
+//While recording, Root passes every input event it gives to InputSystem
+//to the recorder, and the start of every frame with its elapsed time.
+//The mouse state that InputSystem reads from SDL between events (for key
+//events and the mouse latch) goes through the recorder as well.
+//They are written in order to a compact binary file.
+//
+//During replay the live input is ignored. Every frame takes the elapsed
+//time of the recorded frame and gets the events of that frame, so the
+//game callback sees exactly the same sequence as in the recorded session.
+//When the recording ends the game loop stops. The replay can run as fast
+//as possible (no vsync or frame limit) and with the window hidden, which
+//makes it a repeatable benchmark of a real play session.
+//
+//File format: a header (magic, version, window width and height) and
+//records that start with a byte of type:
+//  frame: float elapsed
+//  event: uint32 SDL event type, uint32 timestamp and the fields of the type
+//  mouse: int16 x, int16 y
+
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+union SDL_Event;
+
+namespace Arya
+{
+    using std::string;
+    using std::vector;
+
+    class InputRecorder
+    {
+        public:
+            InputRecorder();
+            ~InputRecorder();
+
+            bool startRecording(const string& filename, int windowWidth, int windowHeight);
+            void stopRecording();
+            bool isRecording() const { return recording; }
+
+            //! Loads a recording, replayed from the next frame on
+            bool startReplay(const string& filename);
+            void stopReplay();
+            bool isReplaying() const { return replaying; }
+
+            //! Window size of the recording
+            int getReplayWidth() const { return replayWidth; }
+            int getReplayHeight() const { return replayHeight; }
+            //! Frames replayed so far
+            unsigned int getFrameCount() const { return frameCount; }
+
+            //! Called by Root at the start of a frame.
+            //! Recording: stores elapsed. Replay: sets elapsed to the recorded
+            //! time, returns false when the recording has ended.
+            bool nextFrame(float& elapsed);
+
+            //! Called by Root for every input event while recording
+            void recordEvent(const SDL_Event& event);
+
+            //! Replay: the next recorded event of this frame
+            //! Returns false when the frame has no events left
+            bool replayEvent(SDL_Event& event);
+
+            //! The mouse position from SDL, recorded or replayed
+            void getMouseState(int& x, int& y);
+
+        private:
+            bool recording;
+            std::ofstream file;
+
+            bool replaying;
+            vector<char> data;
+            size_t readPos;
+            int replayWidth, replayHeight;
+            unsigned int frameCount;
+            int lastMouseX, lastMouseY;
+
+            template<typename T> void put(T value) { file.write((const char*)&value, sizeof(T)); }
+            template<typename T> T get();
+            uint8_t peekType() const;
+            bool readEvent(SDL_Event& event);
+    };
+}
@@ -13,6 +13,8 @@ struct SDL_Keysym;
 
 namespace Arya
 {
+    class InputRecorder;
+
     using std::function;
     using std::map;
     using std::unique_ptr;
@@ -78,14 +80,42 @@ namespace Arya
             // Enter is sent as an ASCII carriage-return: '\x0D' = '\r'
             // Escape is sent as an ASCII escape: '0x1B'
             InputBinding bindTextInput(function<bool(const char*)> f, CHAIN_POS pos = CHAIN_FIRST);
+
+            //! Called once per frame right before the frame is drawn, with
+            //! the newest mouse position. For state that follows the cursor,
+            //! like a hover highlight: it is also updated when the camera
+            //! moved under a cursor that stands still, and it includes the
+            //! movement that arrived after the events of the frame were handled.
+            //! Return true to stop the chain
+            InputBinding bindMouseLatch(function<bool(const MousePos&)> f, CHAIN_POS pos = CHAIN_FIRST);
+
+            //! Samples the mouse and calls the mouse latch bindings
+            //! Called by Root
+            void latchMouse();
             
             //! Handle an input related event generated by SDL
             //! Called by Root
             void handleInputEvent(const SDL_Event& event);
 
+            //! Merge the mouse motion events of a frame into one, with the
+            //! last position and the summed relative movement, and the wheel
+            //! events into one with the summed delta. Any other event first
+            //! delivers the merged ones, so clicks and keys keep their order
+            //! relative to the motion. Off by default
+            void setCoalesceMotion(bool coalesce);
+            bool getCoalesceMotion() const { return coalesceMotion; }
+
+            //! Delivers the merged motion and wheel events
+            //! Called by Root after the events of a frame
+            void flushInput();
+
             //! Called by Root when window resizes
             void resize(int w, int h) { windowWidth = w; windowHeight = h; }
 
+            //! The mouse state is read through the recorder, so that it
+            //! can be recorded and replayed. Called by Root
+            void setRecorder(InputRecorder* r) { recorder = r; }
+
             //! Initialize game controllers
             void initializeControllers();
 
@@ -95,6 +125,16 @@ namespace Arya
 
         private:
             int windowWidth, windowHeight;
+            InputRecorder* recorder;
+
+            bool coalesceMotion;
+            bool hasPendingMotion, hasPendingWheel;
+            SDL_Event pendingMotion, pendingWheel;
+
+            void dispatchEvent(const SDL_Event& event);
+
+            //! SDL_GetMouseState, or the recorded state during a replay
+            void getMouseState(int& x, int& y);
 
             //! Fix for duplicate handling of key that comes as keydown and as textinput
             //! User presses ~
@@ -0,0 +1,142 @@
+//Job system
+//
+//A pool of worker threads with one job queue (deque) per thread.
+//A thread takes jobs from the back of its own queue and, when that is empty,
+//steals from the front of the queues of other threads.
+//The thread that waits for jobs (parallelFor, wait) helps with the work
+//until it is done.
+//
+//Jobs can be tracked with a JobCounter: it counts the unfinished jobs that
+//were started with it. A job can depend on a counter, it is then only
+//queued when that counter reaches zero, so jobs can be chained without
+//any thread blocking in between.
+//
+//Jobs with JOB_MAIN_THREAD affinity, for example everything that calls
+//OpenGL, are only run by the thread that called init. Root runs them
+//once per frame, and they are run while the main thread waits for a counter.
+//
+//Root owns the JobSystem and it is available through Locator::getJobSystem.
+
+#pragma once
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace Arya
+{
+    using std::function;
+    using std::vector;
+    using std::deque;
+    using std::unique_ptr;
+
+    enum JobAffinity
+    {
+        JOB_ANY_THREAD,
+        JOB_MAIN_THREAD
+    };
+
+    class JobSystem;
+
+    //! Number of unfinished jobs that were started with this counter
+    //! It must stay alive until it is done
+    class JobCounter
+    {
+        public:
+            JobCounter() : count(0) {}
+
+            bool isDone() const { return count == 0; }
+            int getCount() const { return count; }
+
+        private:
+            friend class JobSystem;
+            std::atomic<int> count;
+            std::mutex mutex; //for the dependents
+            vector<unsigned int> dependents; //indices into JobSystem::waitingJobs
+    };
+
+    class JobSystem
+    {
+        public:
+            JobSystem();
+            ~JobSystem();
+
+            //! Starts the worker threads
+            //! threadCount is the number of workers besides the main thread,
+            //! -1 means one less than the number of cores.
+            //! The calling thread becomes the main thread
+            bool init(int threadCount = -1);
+            //! Finishes the queued jobs and stops the worker threads
+            void shutdown();
+
+            //! Number of threads that run jobs, including the main thread
+            unsigned int getThreadCount() const { return threads.size() + 1; }
+
+            //! Queues a job. When counter is given it is incremented now and
+            //! decremented when the job has finished.
+            //! When dependency is given the job only starts after it is done.
+            void run(function<void()> func, JobCounter* counter = 0,
+                    JobCounter* dependency = 0, JobAffinity affinity = JOB_ANY_THREAD);
+
+            //! Runs other jobs until the counter is done
+            //! On the main thread this includes JOB_MAIN_THREAD jobs, on other
+            //! threads it does not, so those must never wait for a main thread
+            //! job that the main thread is waiting behind.
+            void wait(JobCounter& counter);
+
+            //! Runs the JOB_MAIN_THREAD jobs that are queued now
+            //! Must be called on the main thread, Root does this every frame
+            void runMainThreadJobs();
+
+            //! Calls func(begin, end) for consecutive ranges of at most grainSize
+            //! elements that together cover [0, count).
+            //! The ranges only depend on count and grainSize, not on the
+            //! number of threads, so results can be made deterministic.
+            //! Returns when all ranges are done.
+            void parallelFor(unsigned int count, unsigned int grainSize, const function<void(unsigned int, unsigned int)>& func);
+
+            //! Index of the calling thread: 0 for the main thread, 1..n for workers
+            static int getThreadIndex();
+            bool isMainThread() const { return std::this_thread::get_id() == mainThreadId; }
+
+        private:
+            struct Job
+            {
+                function<void()> func;
+                JobCounter* counter;
+                JobAffinity affinity;
+            };
+
+            struct JobQueue
+            {
+                std::mutex mutex;
+                deque<Job> jobs;
+            };
+
+            vector<unique_ptr<JobQueue>> queues; //one per thread, 0 is the main thread
+            JobQueue mainQueue; //JOB_MAIN_THREAD jobs
+            vector<std::thread> threads;
+            std::thread::id mainThreadId;
+
+            //Jobs whose dependency is not done yet
+            std::mutex waitingMutex;
+            vector<Job> waitingJobs;
+            vector<unsigned int> freeWaitingJobs;
+
+            std::mutex wakeMutex;
+            std::condition_variable wakeCondition;
+            std::atomic<int> pendingJobs;
+            std::atomic<bool> running;
+
+            void push(Job job);
+            bool runOneJob(unsigned int threadIndex);
+            bool runMainThreadJob();
+            bool popJob(unsigned int threadIndex, Job& job);
+            void finishJob(JobCounter* counter);
+            void workerLoop(unsigned int threadIndex);
+    };
+}
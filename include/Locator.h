@@ -12,6 +12,8 @@ namespace Arya
     class MaterialManager;
     class TextureManager;
     class Audio;
+    class Preloader;
+    class JobSystem;
 
     class Locator
     {
@@ -26,6 +28,8 @@ namespace Arya
             static MaterialManager& getMaterialManager() { return *materialManager; }
             static TextureManager& getTextureManager() { return *textureManager; }
             static Audio& getAudio() { return *audio; }
+            static Preloader& getPreloader() { return *preloader; }
+            static JobSystem& getJobSystem() { return *jobSystem; }
 
             static void provide(Root* r) { root = r; }
             static void provide(World* r) { world = r; }
@@ -37,6 +41,8 @@ namespace Arya
             static void provide(MaterialManager* m) { materialManager = m; }
             static void provide(TextureManager* t) { textureManager = t; }
             static void provide(Audio* a) { audio = a; }
+            static void provide(Preloader* p) { preloader = p; }
+            static void provide(JobSystem* j) { jobSystem = j; }
         private:
             static Root* root;
             static World* world;
@@ -48,5 +54,7 @@ namespace Arya
             static MaterialManager* materialManager;
             static TextureManager* textureManager;
             static Audio* audio;
+            static Preloader* preloader;
+            static JobSystem* jobSystem;
     };
 }
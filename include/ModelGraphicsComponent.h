@@ -1,6 +1,7 @@
 #pragma once
 #include "AnimationBase.h"
 #include "GraphicsComponent.h"
+#include "Pool.h"
 
 namespace Arya
 {
@@ -8,7 +9,7 @@ namespace Arya
 
     class Model;
 
-    class ModelGraphicsComponent : public GraphicsComponent
+    class ModelGraphicsComponent : public GraphicsComponent, public PoolAllocated<ModelGraphicsComponent>
     {
         public:
             ModelGraphicsComponent();
@@ -16,19 +17,31 @@ namespace Arya
             RenderType getRenderType() const override { return TYPE_MODEL; }
 
 
-            void setScale(const vec3& _scale) override { scale = _scale; }
+            void setScale(const vec3& _scale) override { scale = _scale; scaleChanged(); }
             vec3 getScale() const override { return scale; }
+            bool getLocalBounds(vec3& boxMin, vec3& boxMax) const override;
 
             void setAnimation(const char* name) override;
             void updateAnimation(float elapsedTime) override;
             void setAnimationTime(float time) override;
 
-            //! setModel releases the old model and animationstate.
-            //! If the new model is nonzero,
-            //! it creates a new AnimationState object
+            //! Resolves an animation name to an id once, so that
+            //! setAnimation(int) does not have to look it up.
+            //! Returns -1 if the model has no such animation
+            int getAnimationId(const char* name) const;
+            void setAnimation(int animationId);
+            //! Plays the animation in phase with all other entities that
+            //! play it shared, these are advanced together as one
+            void setSharedAnimation(int animationId);
+
+            //! setModel releases the old model.
+            //! The animation state is kept when the new model has the same
+            //! animation data (for example a clone with another material),
+            //! otherwise a new AnimationState object is created
             void setModel(shared_ptr<Model> model);
 
             Model* getModel() const { return model.get(); }
+            const shared_ptr<Model>& getSharedModel() const { return model; }
             AnimationState* getAnimationState() const { return animState.get(); }
         private:
             shared_ptr<Model> model;
@@ -30,6 +30,7 @@ namespace Arya
     class Material;
     class AnimationState;
     class ShaderProgram;
+    class ShaderVariants;
 
     class Mesh
     {
@@ -71,13 +72,24 @@ namespace Arya
             shared_ptr<ShaderProgram> getShaderProgram() const { return shaderProgram; }
 
             //! Set a different ShaderProgram
-            void setShaderProgram(shared_ptr<ShaderProgram> shader) { shaderProgram = shader; }
+            //! This disables instanced rendering of the model
+            void setShaderProgram(shared_ptr<ShaderProgram> shader) { shaderProgram = shader; instancedShaderProgram = nullptr; }
+
+            //! Shader that draws all entities with this model in one call
+            //! with per instance move matrix and animation frames.
+            //! Zero when the model can not be instanced
+            shared_ptr<ShaderProgram> getInstancedShaderProgram() const { return instancedShaderProgram; }
 
             //! Entity::setModel will call this function
             //! to create the appropriate subclass of AnimationState
             unique_ptr<AnimationState> createAnimationState();
 
+            //! Can be zero for models without animations
+            AnimationData* getAnimationData() const { return animationData.get(); }
+
             vec3 getBoundingBoxVertex(int vertexNumber);
+            const vec3& getBoundingMin() const { return boundingMin; }
+            const vec3& getBoundingMax() const { return boundingMax; }
 
             //! Sets the material on all Meshes
             void setMaterial(shared_ptr<Material> mat);
@@ -87,6 +99,7 @@ namespace Arya
 
             vector<Mesh*> meshes;
             shared_ptr<ShaderProgram> shaderProgram;
+            shared_ptr<ShaderProgram> instancedShaderProgram;
             shared_ptr<AnimationData> animationData;
 
             vec3 boundingMin;
@@ -111,5 +124,11 @@ namespace Arya
             shared_ptr<ShaderProgram> staticShader;
             shared_ptr<ShaderProgram> animatedShader;
             shared_ptr<ShaderProgram> primitiveShader;
+            //All variants of the animated model shader, see model.vert
+            shared_ptr<ShaderVariants> modelShaders;
+            //Animated models with all frames in a texture
+            shared_ptr<ShaderProgram> textureAnimatedShader;
+            shared_ptr<ShaderProgram> instancedShader;
+            int maxFrameTexels;
     };
 }
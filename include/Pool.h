@@ -0,0 +1,106 @@
+//Pool allocation
+//
+//FixedPool hands out memory for objects of one size from large blocks
+//and keeps released objects in a free list, so allocating and releasing
+//objects that are created and destroyed often does not go through
+//the general purpose allocator.
+//
+//PoolAllocated<T> is a base class that makes new and delete of T use the pool for T.
+//PoolAllocator<T> is a standard allocator, for example for std::allocate_shared
+//or the control block of a shared_ptr.
+//
+//The pools are never destroyed, so objects can still be released during
+//static destruction at exit.
+
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <new>
+
+namespace Arya
+{
+    using std::vector;
+
+    class FixedPool
+    {
+        public:
+            //! objectSize and alignment in bytes, alignment is at most that of std::max_align_t
+            FixedPool(size_t objectSize, size_t alignment, size_t objectsPerBlock = 256);
+            ~FixedPool();
+
+            void* allocate();
+            void deallocate(void* p);
+
+            size_t getObjectSize() const { return objectSize; }
+
+        private:
+            FixedPool(const FixedPool&) = delete;
+            FixedPool& operator=(const FixedPool&) = delete;
+
+            struct FreeObject { FreeObject* next; };
+
+            size_t objectSize;
+            size_t objectsPerBlock;
+            FreeObject* freeList;
+            vector<char*> blocks;
+            std::mutex mutex;
+
+            void addBlock();
+    };
+
+    //! The pool for objects of type T
+    template<typename T>
+    FixedPool& getPool()
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types can not be pooled");
+        static FixedPool* pool = new FixedPool(sizeof(T), alignof(T));
+        return *pool;
+    }
+
+    template<typename T>
+    class PoolAllocated
+    {
+        public:
+            //Subclasses of T have a different size and use the normal allocator
+            static void* operator new(size_t size)
+            {
+                if (size != sizeof(T)) return ::operator new(size);
+                return getPool<T>().allocate();
+            }
+
+            static void operator delete(void* p, size_t size)
+            {
+                if (!p) return;
+                if (size != sizeof(T)) ::operator delete(p);
+                else getPool<T>().deallocate(p);
+            }
+    };
+
+    template<typename T>
+    class PoolAllocator
+    {
+        public:
+            typedef T value_type;
+
+            PoolAllocator() {}
+            template<typename U> PoolAllocator(const PoolAllocator<U>&) {}
+
+            T* allocate(size_t n)
+            {
+                if (n != 1) return static_cast<T*>(::operator new(n * sizeof(T)));
+                return static_cast<T*>(getPool<T>().allocate());
+            }
+
+            void deallocate(T* p, size_t n)
+            {
+                if (n != 1) ::operator delete(p);
+                else getPool<T>().deallocate(p);
+            }
+    };
+
+    template<typename T, typename U>
+    bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+    template<typename T, typename U>
+    bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+}
@@ -0,0 +1,103 @@
+//Startup preloading
+//
+//During a session every file read from disk and every texture, material
+//and model that is loaded is recorded, in order of first use.
+//When the game loop stops, this list is written to a manifest file.
+//
+//On the next launch Root reads the manifest before the window is created
+//and starts reading the files (and decoding the images) as jobs on the JobSystem
+//while SDL and the OpenGL context initialize.
+//After the context exists, the file data is handed to the FileSystem
+//and the decoded textures and listed models are uploaded in one go,
+//so that the first frames do not stall on first use of a resource.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include "Jobs.h"
+
+namespace Arya
+{
+    using std::string;
+    using std::vector;
+    using std::set;
+
+    class File;
+
+    enum PreloadType
+    {
+        PRELOAD_FILE = 0,
+        PRELOAD_TEXTURE,
+        PRELOAD_MATERIAL,
+        PRELOAD_MODEL
+    };
+
+    class Preloader
+    {
+        public:
+            Preloader();
+            ~Preloader();
+
+            //! Records the first use of a file or resource
+            //! Can be called from any thread
+            void record(PreloadType type, const string& name);
+
+            //! Reads the manifest of the previous session and starts
+            //! reading and decoding its files as jobs.
+            //! Does not use OpenGL. Returns false if there is no manifest.
+            bool startPrefetch();
+
+            //! Waits for the jobs and gives the
+            //! file data to the FileSystem. Must be called before
+            //! any subsystem requests the files.
+            void finishPrefetch();
+
+            //! Uploads the decoded textures and loads the materials
+            //! and models of the manifest. Requires an OpenGL context
+            //! and initialized resource managers.
+            void uploadResources();
+
+            //! Writes the resources used in this session to the manifest
+            bool writeManifest();
+
+            void setEnabled(bool enable) { enabled = enable; }
+            bool isEnabled() const { return enabled; }
+
+        private:
+            struct Entry
+            {
+                PreloadType type;
+                string name;
+            };
+
+            //! A file read by one of the jobs
+            struct Prefetched
+            {
+                string filename;
+                char* data;
+                unsigned int size;
+                bool isImage;
+                //Only for images
+                int width;
+                int height;
+                unsigned char* pixels;
+            };
+
+            bool enabled;
+
+            std::mutex recordMutex;
+            vector<Entry> recorded;
+            set<string> recordedKeys;
+
+            vector<Entry> manifest;
+            vector<Prefetched> prefetched;
+            vector<File*> heldFiles;
+            JobCounter prefetchJobs;
+
+            void prefetch(Prefetched& p);
+            void clearPrefetched();
+            string getManifestPath() const;
+    };
+}
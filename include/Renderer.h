@@ -5,6 +5,7 @@ using std::shared_ptr;
 using std::make_shared;
 
 typedef unsigned int GLuint;
+typedef struct __GLsync* GLsync;
 
 namespace Arya {
 
@@ -12,6 +13,7 @@ class Mesh;
 class Geometry;
 class Material;
 class ShaderProgram;
+struct GeometryInstance;
 
 class RenderTarget
 {
@@ -24,6 +26,49 @@ class RenderTarget
         GLuint frameBuffer;
         GLuint texture; //0 if no color
         GLuint depthBuffer; //0 if no depth
+        bool integerColor; //texture holds one unsigned int per pixel
+};
+
+//! Reads back single pixels of an integer render target
+//! without waiting for the GPU: the copy goes into a pixel buffer object
+//! and the result is available one or more frames later
+class PixelReadback
+{
+    public:
+        PixelReadback();
+        ~PixelReadback();
+
+        //! Starts copying a pixel of the bound render target, origin bottom left
+        //! Returns false when all buffers are still in flight
+        bool request(int x, int y);
+
+        //! Returns true and sets value when the oldest copy has arrived
+        bool poll(unsigned int& value);
+
+    private:
+        static const int bufferCount = 3;
+        GLuint buffers[bufferCount];
+        GLsync fences[bufferCount];
+        int first; //oldest copy in flight
+        int count; //number of copies in flight
+};
+
+//! Uniform buffer for the blocks of many instances,
+//! see ShaderProgram::setInstanceBlock
+class UniformBuffer
+{
+    public:
+        UniformBuffer();
+        ~UniformBuffer();
+
+        //! Replaces the contents and binds the buffer to bindingPoint
+        //! New storage is allocated each time so the driver does not
+        //! wait for draws that still read the previous contents
+        //! size should be at least the size of the block in the shader
+        void upload(const void* data, unsigned int size, unsigned int bindingPoint);
+
+    private:
+        GLuint buffer;
 };
 
 class Renderer
@@ -49,7 +94,8 @@ class Renderer
 
         //! Create a render target:
         //! framebuffer and possible texture and depth buffer
-        shared_ptr<RenderTarget> createRenderTarget(int width, int height, bool color, bool depth);
+        //! integerColor gives a color texture with one unsigned int per pixel (for ids)
+        shared_ptr<RenderTarget> createRenderTarget(int width, int height, bool color, bool depth, bool integerColor = false);
 
         //! Set the render target
         //! Zero means screen
@@ -60,6 +106,13 @@ class Renderer
         //! Set viewport after rendertarget has been set to screen
         void setViewport(int width, int height);
 
+        //! Only render within a rectangle, origin bottom left
+        void setScissor(int x, int y, int width, int height);
+        void disableScissor();
+
+        //! Clear an integer render target to zero, and its depth
+        void clearIntegerTarget();
+
         //! Render a piece of geometry with texture
         //! Wrapper for lower-level renderGeometry
         //! Assumes mesh, shader are valid pointers
@@ -68,5 +121,12 @@ class Renderer
         //! Assumes that geom, mat, shader are valid pointers
         //! and mat has a valid texture handle
         void renderGeometry(Geometry* geom, Material* mat, ShaderProgram* shader, int frame = 0);
+
+        //! Render instanceCount copies of a mesh in one draw call
+        //! Only for geometry with a frame texture, see Geometry::createFrameTexture
+        void renderMeshInstanced(Mesh* mesh, ShaderProgram* shader, const GeometryInstance* instances, int instanceCount);
+
+    private:
+        void bindFrameTexture(Geometry* geom, ShaderProgram* shader);
 };
 }
@@ -10,6 +10,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include "common/Trace.h"
 
 namespace Arya
 {
@@ -36,7 +37,9 @@ namespace Arya
                 if (iter != resources.end())
                     return iter->second;
 
+                TraceScope trace(TRACE_RESOURCE_LOAD, tracer.intern(filename));
                 shared_ptr<T> ret = loadResource(filename);
+                trace.setArg(1, ret ? 1 : 0);
                 if (ret) return ret;
                 return defaultResource;
             }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <functional>
+#include <string>
+#include <cstdint>
+#include <atomic>
 
 namespace Arya
 {
@@ -15,6 +18,10 @@ namespace Arya
     class MaterialManager;
     class TextureManager;
     class AudioManager;
+    class Preloader;
+    class JobSystem;
+    class FramePacer;
+    class InputRecorder;
 
     struct SDLValues; //This prevents including SDL headers here
 
@@ -31,6 +38,41 @@ namespace Arya
             void gameLoop( std::function<void(float)> callback );
             void stopGameLoop();
 
+            //! Simulate in steps of fixed length: the game callback and World::update
+            //! are called zero or more times per frame with elapsedTime = step,
+            //! so the simulation does not depend on the frame rate.
+            //! At most maxSteps are taken per frame, when the simulation falls
+            //! further behind the remaining time is dropped.
+            //! step = 0 (default) runs one update per frame with the measured time
+            void setFixedTimestep(float step, int maxSteps = 5);
+            float getFixedTimestep() const { return fixedStep; }
+
+            //! Time since the last simulation step as a fraction of the step,
+            //! used by Graphics to draw entities between the last two steps.
+            //! Always 1 without a fixed timestep
+            float getInterpolationAlpha() const { return interpolationAlpha; }
+
+            //! Run the game callback and World::update on a separate thread.
+            //! The main thread draws the snapshot of the previous simulation
+            //! step (see FrameSnapshot) while the next step is simulated.
+            //! Input events, the interface and the camera are handled on the
+            //! main thread while the simulation thread is paused, so input
+            //! bindings can still change the world.
+            //! The callback must not call OpenGL and the custom uniform
+            //! callbacks of shaders are not used, use UniformBlocks instead.
+            //! Must be set before gameLoop is called
+            void setThreadedSimulation(bool threaded) { threadedSimulation = threaded; }
+            bool getThreadedSimulation() const { return threadedSimulation; }
+
+            //! Records the input of the game loop to a file, see InputRecorder
+            //! Start it before gameLoop to be able to replay the session
+            bool startRecording(const std::string& filename);
+            //! Plays a recording back instead of the live input, from the
+            //! next frame on. The game loop stops at the end of the recording.
+            //! fast: no vsync and frame limit, hidden: hides the window
+            //! Must be called before gameLoop, on the state the recording started from
+            bool startReplay(const std::string& filename, bool fast = false, bool hidden = false);
+
             bool getFullscreen() const { return fullscreen; }
             void setFullscreen(bool fullscreen = true);
 
@@ -45,6 +87,11 @@ namespace Arya
             ModelManager* getModelManager() const { return modelManager; }
             MaterialManager* getMaterialManager() const { return materialManager; }
             TextureManager* getTextureManager() const { return textureManager; }
+            Preloader*   getPreloader() const { return preloader; }
+            JobSystem*   getJobSystem() const { return jobSystem; }
+            //! Vsync, frame rate limit and frame time statistics
+            FramePacer*  getFramePacer() const { return framePacer; }
+            InputRecorder* getInputRecorder() const { return inputRecorder; }
 
         private:
             World*       world;
@@ -58,11 +105,27 @@ namespace Arya
             MaterialManager* materialManager;
             TextureManager* textureManager;
             AudioManager* audioManager;
+            Preloader*   preloader;
+            JobSystem*   jobSystem;
+            FramePacer*  framePacer;
+            InputRecorder* inputRecorder;
 
-            bool loopRunning;
+            std::atomic<bool> loopRunning; //stopGameLoop can be called by the simulation thread
 
             void render();
             void handleEvents();
+            void swapBuffers();
+            void gameLoopStopped();
+            void bindFrameCommands();
+
+            //! One frame of simulation: zero or more fixed steps or one variable step
+            void simulate(const std::function<void(float)>& callback, float elapsed);
+
+            bool threadedSimulation;
+            struct SimulationThread;
+            SimulationThread* simulation;
+            void threadedGameLoop(const std::function<void(float)>& callback);
+            void simulationLoop(const std::function<void(float)>& callback);
 
             int windowWidth;
             int windowHeight;
@@ -72,7 +135,13 @@ namespace Arya
 
             SDLValues* sdlValues;
 
-            int timer;
+            uint64_t timer; //performance counter
+            uint64_t frameTraceStart; //tracer time of the last swap
+            int32_t frameNumber;
+            float fixedStep;
+            int maxSteps;
+            double accumulator;
+            float interpolationAlpha;
     };
 }
 
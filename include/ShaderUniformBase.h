@@ -2,11 +2,17 @@
 
 namespace Arya
 {
+    class UniformBlock;
+
     // This is castable to both Entity and View (they subclassed it)
     // because a shader can be used to draw either an Entity or View
     // It is polymorphic to make sure that std typeinfo and dynamic_cast can be used
     class ShaderUniformBase {
         public:
             virtual ~ShaderUniformBase(){};
+
+            //! Typed per instance uniforms, see UniformBlock.h
+            //! Zero when the defaults of the shader should be used
+            virtual const UniformBlock* getUniformBlock() const { return 0; }
     };
 }
@@ -14,12 +14,14 @@
 #include <vector>
 #include <map>
 #include <functional>
+#include <memory>
 #include <cstdint>
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 
 #include "ShaderUniformBase.h"
+#include "UniformBlock.h"
 
 //Prevents having to include full OpenGL header
 typedef int	            GLint;
@@ -29,6 +31,7 @@ using std::function;
 using std::string;
 using std::vector;
 using std::map;
+using std::shared_ptr;
 
 using glm::mat4;
 using glm::vec2;
@@ -37,8 +40,6 @@ using glm::vec4;
 
 namespace Arya
 {
-    class File;
-
     enum ShaderType
     {
         VERTEX,
@@ -53,8 +54,14 @@ namespace Arya
             ~Shader();
 
             // Adds a source file to the shader
+            // A line #include "file" is replaced by that file, relative to the
+            // directory of the including file. Every file is included only once
             bool addSourceFile(string f);
 
+            // Adds #define name before the sources, to compile in a feature
+            // Should be called before compile
+            void addDefine(const string& name);
+
             // Compiles the Shader and sets its handle
             bool compile();
 
@@ -68,8 +75,12 @@ namespace Arya
 
             friend class ShaderProgram;
 
-            vector<File*> sources;
+            vector<string> sources; //with the includes
+            vector<string> sourceNames; //all files, also the included ones
+            vector<string> defines;
             ShaderType type;
+
+            bool preprocess(const string& filename, string& out, bool numbered);
     };
 
     // Built-in uniforms, using flags
@@ -85,7 +96,9 @@ namespace Arya
         UNIFORM_MATERIALPARAMS  = 16,   //vec4 material
         UNIFORM_ANIM_INTERPOL   = 32,   //float interpolation
         UNIFORM_LIGHTMATRIX     = 64,   //mat4 lightMatrix
-        UNIFORM_SHADOWTEXTURE   = 128   //sampler2D shadowMap
+        UNIFORM_SHADOWTEXTURE   = 128,  //sampler2D shadowMap
+        UNIFORM_FRAMEDATA       = 256,  //samplerBuffer frameData, int vertexCount
+        UNIFORM_ANIM_FRAMES     = 512   //ivec2 animFrames (current, next)
     };
     //bit operators because it is not a primitive type
     using UnderType = std::underlying_type_t<UNIFORM_FLAG>;
@@ -94,7 +107,28 @@ namespace Arya
         return (UNIFORM_FLAG)(static_cast<UnderType>(lhs) | static_cast<UnderType>(rhs));
     }
 
+    // Optional features of a shader, see ShaderVariants
+    // Each feature is compiled in with the #define shown after the enum
+    enum SHADER_FEATURE : std::uint32_t
+    {
+        FEATURE_NONE            = 0,
+        FEATURE_ANIMATED        = 1,    //ANIMATED
+        FEATURE_FRAMETEXTURE    = 2,    //FRAME_TEXTURE
+        FEATURE_INSTANCED       = 4,    //INSTANCED
+        FEATURE_SHADOW_ONLY     = 8,    //SHADOW_ONLY
+        FEATURE_FOG             = 16,   //FOG
+        FEATURE_TINT            = 32    //TINT
+    };
+    inline SHADER_FEATURE operator| (SHADER_FEATURE lhs, SHADER_FEATURE rhs)
+    {
+        return (SHADER_FEATURE)(static_cast<std::uint32_t>(lhs) | static_cast<std::uint32_t>(rhs));
+    }
+
+    class ShaderVariants;
+
     // Custom uniforms using callbacks
+    // These are convenient for prototyping, but cost a call per uniform
+    // per draw. Per instance data that is used often should go in a UniformBlock
     template <typename T>
         class ShaderUniform
         {
@@ -109,6 +143,8 @@ namespace Arya
         public:
             ShaderProgram();
 			ShaderProgram(string vertexFile, string fragmentFile);
+            //! Both shaders are compiled with #define for every name in defines
+            ShaderProgram(string vertexFile, string fragmentFile, const vector<string>& defines);
             ~ShaderProgram();
 
             void attach(Shader* shader);
@@ -121,6 +157,7 @@ namespace Arya
             // -- Manual way of setting uniforms
             GLint getUniformLocation(const char* name);
             void setUniform1i(const char* name, int val);
+            void setUniform1ui(const char* name, unsigned int val);
             void setUniform1f(const char* name, float val);
             void setUniform2fv(const char* name, const vec2& values);
             void setUniform3fv(const char* name, const vec3& values);
@@ -142,6 +179,9 @@ namespace Arya
             void setShadowTexture(int t);
             void setMaterialParams(vec4 par);
             void setAnimInterpolation(float t);
+            //! Frame texture of the Geometry, see Geometry::createFrameTexture
+            void setFrameData(int t, int vertexCount);
+            void setAnimFrames(int frame, int nextFrame);
 
             // -- Custom uniforms
 
@@ -159,8 +199,52 @@ namespace Arya
             //! Called by Graphics. Will perform all callbacks and set the uniforms
             void doUniforms(ShaderUniformBase* e);
 
+            // -- Per instance uniform blocks
+
+            //! The fields of the layout of defaults are bound to the uniforms with
+            //! the same names. Fields that the shader does not use are skipped.
+            //! Instances that have no block with this layout use the defaults
+            void setUniformDefaults(shared_ptr<const UniformBlock> defaults);
+            shared_ptr<const UniformBlock> getUniformDefaults() const { return uniformDefaults; }
+
+            //! Called by Graphics. Sets the bound uniforms from the block,
+            //! or from the defaults when block is zero or has another layout
+            void applyUniformBlock(const UniformBlock* block);
+            //! Same for a copy of the data of a block with this layout
+            void applyUniformData(const UniformLayout* layout, const char* data);
+
+            //! For instanced rendering: the shader reads the blocks of all instances
+            //! as an array of structs in the std140 uniform block blockName,
+            //! indexed by gl_InstanceID. See UniformBuffer in Renderer.h
+            //! Returns false if the shader has no such block
+            bool setInstanceBlock(const char* blockName, unsigned int bindingPoint);
+            bool hasInstanceBlock() const { return instanceBlockCapacity > 0; }
+            //! Number of instances that fit in the array of the shader
+            unsigned int getInstanceBlockCapacity() const { return instanceBlockCapacity; }
+            unsigned int getInstanceBlockBinding() const { return instanceBlockBinding; }
+
+            // -- Variants
+
+            //! Creates a program with the same vertex (and geometry) shader
+            //! but a different fragment shader, for example to render ids instead of colors.
+            //! Built-in and custom uniforms are copied when the new program still uses them.
+            //! Returns nullptr on failure
+            shared_ptr<ShaderProgram> createVariant(string fragmentFile);
+
+            //! Features this program was compiled with, when it was created by ShaderVariants
+            std::uint32_t getFeatures() const { return features; }
+            //! Returns the program of the same ShaderVariants with other features,
+            //! compiling it on first request. nullptr when this program does not come
+            //! from ShaderVariants or the variant does not compile
+            ShaderProgram* getFeatureVariant(std::uint32_t features);
+
         private:
             bool init();
+            void load(const string& vertexFile, const string& fragmentFile, const vector<string>& defines);
+
+            friend class ShaderVariants;
+            std::weak_ptr<ShaderVariants> family;
+            std::uint32_t features;
 
             GLuint handle;
             bool linked;
@@ -176,7 +260,44 @@ namespace Arya
             vector<ShaderUniform<vec4> >    uniforms4fv;
             vector<ShaderUniform<mat4> >    uniformsMat4fv;
 
-            // Caching for glGetUniformLocation
-            map<string,GLint> uniforms;
+            struct BlockBinding
+            {
+                GLint handle;
+                UniformType type;
+                unsigned int offset;
+            };
+            shared_ptr<const UniformBlock> uniformDefaults;
+            vector<BlockBinding> blockBindings;
+            string instanceBlockName;
+            unsigned int instanceBlockBinding;
+            unsigned int instanceBlockCapacity;
+
+            // Caching for glGetUniformLocation, including the names that
+            // were not found (-1) so they are only looked up and reported once.
+            // std::less<> so that find does not construct a string
+            map<string,GLint,std::less<>> uniforms;
+    };
+
+    //! Compiles a vertex and fragment shader with different sets of features
+    //! (see SHADER_FEATURE) into separate programs, so that a draw can use a
+    //! specialised program instead of branching in one large shader.
+    //! A variant is compiled on its first request and then cached.
+    //! Should be created with make_shared
+    class ShaderVariants : public std::enable_shared_from_this<ShaderVariants>
+    {
+        public:
+            ShaderVariants(string vertexFile, string fragmentFile);
+
+            //! Called once for every new variant, to enable its uniforms
+            void setSetup(function<void(ShaderProgram*, std::uint32_t features)> f) { setup = f; }
+
+            //! Returns nullptr if the variant does not compile, the failure is cached as well
+            shared_ptr<ShaderProgram> get(std::uint32_t features);
+
+        private:
+            string vertexFile;
+            string fragmentFile;
+            function<void(ShaderProgram*, std::uint32_t)> setup;
+            map<std::uint32_t, shared_ptr<ShaderProgram> > variants;
     };
 }
@@ -0,0 +1,85 @@
+//Spatial index
+//
+//A dynamic AABB tree: a binary tree of axis aligned bounding boxes
+//with one leaf (proxy) per object. The tree is kept balanced by
+//rotations, as in the broadphase of Box2D.
+//
+//Leaves store a box that is enlarged by a margin. An object that moves
+//within its enlarged box does not change the tree, so moving objects
+//are cheap to update incrementally.
+//
+//Queries descend only into nodes that overlap the query, so a query
+//only touches a small part of a large tree. The results are appended
+//to a vector given by the caller so that it can be reused every frame.
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace Arya
+{
+    using std::vector;
+    using glm::vec3;
+    using glm::vec4;
+    using glm::mat4;
+
+    class SpatialIndex
+    {
+        public:
+            //! margin is added to all sides of the boxes in the tree
+            SpatialIndex(float margin = 1.0f);
+            ~SpatialIndex();
+
+            static const uint32_t none = ~0u;
+
+            //! Returns the id of the new proxy
+            uint32_t insert(const vec3& boxMin, const vec3& boxMax, uint32_t userData);
+            void remove(uint32_t proxy);
+            //! Sets the box of the proxy
+            //! Returns true if the tree changed
+            bool move(uint32_t proxy, const vec3& boxMin, const vec3& boxMax);
+
+            uint32_t getUserData(uint32_t proxy) const { return nodes[proxy].userData; }
+            unsigned int getCount() const { return proxyCount; }
+
+            //Queries, these append the userData of the matching proxies to result
+
+            void queryBox(const vec3& boxMin, const vec3& boxMax, vector<uint32_t>& result) const;
+            void querySphere(const vec3& center, float radius, vector<uint32_t>& result) const;
+            //! All proxies (partially) inside the view frustum of a view-projection matrix
+            void queryFrustum(const mat4& viewProjection, vector<uint32_t>& result) const;
+
+            //! Returns the userData of the nearest proxy hit by the ray, or none.
+            //! direction does not have to be normalized, distance is in
+            //! units of its length. The ray ends at maxDistance
+            uint32_t raycast(const vec3& origin, const vec3& direction, float maxDistance, float* distance = 0) const;
+
+        private:
+            struct Node
+            {
+                vec3 boxMin, boxMax; //enlarged for leaves
+                vec3 exactMin, exactMax; //only for leaves
+                uint32_t parent; //next free node when in the free list
+                uint32_t child1, child2; //none for leaves
+                int32_t height; //0 for leaves, -1 for free nodes
+                uint32_t userData;
+
+                bool isLeaf() const { return child1 == none; }
+            };
+
+            vector<Node> nodes;
+            uint32_t root;
+            uint32_t freeList;
+            unsigned int proxyCount;
+            float margin;
+
+            uint32_t allocateNode();
+            void freeNode(uint32_t node);
+            void insertLeaf(uint32_t leaf);
+            void removeLeaf(uint32_t leaf);
+            uint32_t balance(uint32_t node);
+            void collectLeaves(uint32_t node, vector<uint32_t>& result) const;
+    };
+}
@@ -11,6 +11,16 @@ namespace Arya
 {
     using glm::vec4;
 
+    //! Decoded image data, 4 bytes (RGBA) per pixel
+    struct ImageData
+    {
+        int width;
+        int height;
+        unsigned char* pixels;
+
+        ImageData() : width(0), height(0), pixels(0) {}
+    };
+
     class Texture
     {
         public:
@@ -44,6 +54,15 @@ namespace Arya
             //so make sure to keep the shared_ptr
             shared_ptr<Texture> createTexture(const vec4& color);
 
+            //! Uploads decoded image data and stores the texture under name
+            shared_ptr<Texture> createTexture(string name, const ImageData& image);
+
+            //! Decodes an image file from memory. Does not use OpenGL
+            //! so this can be called from any thread.
+            //! The pixels must be freed with freeImage
+            static bool decodeImage(const char* data, unsigned int size, ImageData& image);
+            static void freeImage(ImageData& image);
+
         private:
             shared_ptr<Texture> loadResource( string filename );
 
@@ -0,0 +1,93 @@
+//Transform system
+//
+//Stores the position, rotation and scale of all entities in separate arrays
+//(structure of arrays), ordered such that a parent always comes before its children.
+//update() propagates the dirty flags from parents to children in a single pass
+//and then computes all dirty world matrices, four at a time using SSE when available.
+//
+//Transforms are referred to by a stable id that does not change when
+//the arrays are reordered. Entity holds such an id.
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace Arya
+{
+    using std::vector;
+    using glm::vec3;
+    using glm::mat4;
+
+    class TransformSystem
+    {
+        public:
+            TransformSystem();
+            ~TransformSystem();
+
+            static const uint32_t none = ~0u;
+
+            //! Returns the id of a new transform with identity matrix
+            uint32_t create();
+            //! Children of the transform lose their parent
+            void destroy(uint32_t id);
+
+            void setPosition(uint32_t id, const vec3& pos);
+            //! Rotation around the z-axis (yaw) followed by the x-axis (pitch)
+            void setRotation(uint32_t id, float yaw, float pitch);
+            void setScale(uint32_t id, const vec3& scale);
+            //! Use none to remove the parent
+            void setParent(uint32_t id, uint32_t parentId);
+
+            //! Recomputes all dirty world matrices
+            //! Does nothing when no transform changed since the last call
+            void update();
+
+            //! The world matrix as computed by the last update
+            const mat4& getWorldMatrix(uint32_t id) const { return worldMatrices[internalIndex[id]]; }
+
+            unsigned int getCount() const { return worldMatrices.size(); }
+
+            //! Keeps a copy of all world matrices, for interpolation between
+            //! this update and the next one. See getInterpolatedMatrix
+            void storePrevious();
+            //! Blends the matrix stored by storePrevious (alpha = 0) with the current
+            //! one (alpha = 1). Transforms created since then give the current matrix
+            mat4 getInterpolatedMatrix(uint32_t id, float alpha) const;
+
+            //! Ids of the transforms whose world matrix was recomputed
+            //! since the last clearChanged, can contain duplicates
+            //! and ids of transforms that were destroyed since
+            const vector<uint32_t>& getChanged() const { return changed; }
+            void clearChanged() { changed.clear(); }
+
+        private:
+            //Indexed by internal index, parents before children
+            vector<float> posX, posY, posZ;
+            vector<float> cosYaw, sinYaw, cosPitch, sinPitch;
+            vector<float> scaleX, scaleY, scaleZ;
+            vector<uint32_t> parents; //internal index of parent or none
+            vector<uint32_t> childCount;
+            vector<uint8_t> dirty;
+            vector<uint32_t> ids; //internal index to id
+            vector<mat4> worldMatrices;
+
+            //Indexed by id
+            vector<uint32_t> internalIndex;
+            vector<uint32_t> freeIds;
+            vector<uint32_t> changed;
+            vector<mat4> previousMatrices;
+            vector<uint8_t> hasPrevious;
+
+            //Set by entities that update in parallel, World::update
+            //waits for them before the transforms are updated
+            std::atomic<bool> anyDirty;
+            bool needsSort;
+
+            void sortHierarchy();
+            void computeLocalMatrices();
+            void moveTransform(uint32_t from, uint32_t to);
+    };
+}
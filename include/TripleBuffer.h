@@ -0,0 +1,53 @@
+//Triple buffer
+//
+//Passes values from one producer thread to one consumer thread without locks.
+//The producer fills the write buffer and publishes it, the consumer takes
+//the newest published buffer. Neither side ever waits for the other:
+//the third buffer is the one in between. When the producer is faster,
+//values that were never taken are overwritten.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace Arya
+{
+    template <typename T>
+    class TripleBuffer
+    {
+        public:
+            TripleBuffer() : writeIndex(0), middle(1), readIndex(2) {}
+
+            //! Producer: the buffer to fill
+            T& getWriteBuffer() { return buffers[writeIndex]; }
+            //! Producer: makes the write buffer the newest one
+            void publish()
+            {
+                uint8_t old = middle.exchange(writeIndex | newBit, std::memory_order_acq_rel);
+                writeIndex = old & indexMask;
+            }
+
+            //! Consumer: true when a buffer was published since the last acquire
+            bool hasNew() const { return (middle.load(std::memory_order_acquire) & newBit) != 0; }
+            //! Consumer: makes the newest published buffer the read buffer
+            //! Returns false, and keeps the read buffer, when there is nothing new
+            bool acquire()
+            {
+                if (!hasNew()) return false;
+                uint8_t old = middle.exchange(readIndex, std::memory_order_acq_rel);
+                readIndex = old & indexMask;
+                return true;
+            }
+            //! Consumer: the buffer taken by the last acquire
+            T& getReadBuffer() { return buffers[readIndex]; }
+
+        private:
+            static const uint8_t indexMask = 3;
+            static const uint8_t newBit = 4;
+
+            T buffers[3];
+            uint8_t writeIndex; //only used by the producer
+            std::atomic<uint8_t> middle; //index and newBit
+            uint8_t readIndex; //only used by the consumer
+    };
+}
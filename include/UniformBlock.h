@@ -0,0 +1,103 @@
+//Per instance uniform data
+//
+//A UniformLayout is a list of named, typed fields at fixed offsets.
+//A UniformBlock holds the values of these fields for one instance
+//(for example an Entity) as plain bytes.
+//
+//A ShaderProgram binds the fields of a layout to its uniforms once
+//(see ShaderProgram::setUniformDefaults) and can then set all of them
+//from a block with one loop over a table of locations and offsets,
+//without callbacks.
+//
+//The offsets follow the std140 rules and the size of a block is a multiple
+//of 16 bytes, so the blocks of many instances can be copied after each other
+//into one uniform buffer and read in a shader as an array of structs
+//with the same fields in the same order.
+
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstring>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace Arya
+{
+    using std::vector;
+    using std::string;
+    using std::shared_ptr;
+    using glm::vec2;
+    using glm::vec3;
+    using glm::vec4;
+    using glm::mat4;
+
+    enum UniformType
+    {
+        UNIFORMTYPE_INT,
+        UNIFORMTYPE_FLOAT,
+        UNIFORMTYPE_VEC2,
+        UNIFORMTYPE_VEC3,
+        UNIFORMTYPE_VEC4,
+        UNIFORMTYPE_MAT4
+    };
+
+    class UniformLayout
+    {
+        public:
+            struct Field
+            {
+                string name;
+                UniformType type;
+                unsigned int offset; //in bytes
+            };
+
+            UniformLayout() : size(0) {}
+
+            //! Adds a field after the previous ones and returns its offset
+            unsigned int add(const string& name, UniformType type);
+
+            //! Returns -1 if there is no field with this name
+            int getOffset(const string& name) const;
+
+            //! Size of a block in bytes
+            unsigned int getSize() const { return size; }
+            const vector<Field>& getFields() const { return fields; }
+
+        private:
+            vector<Field> fields;
+            unsigned int size;
+    };
+
+    class UniformBlock
+    {
+        public:
+            //! All values start at zero
+            UniformBlock(shared_ptr<const UniformLayout> layout)
+                : layout(layout), data(layout->getSize(), 0) {}
+
+            const UniformLayout* getLayout() const { return layout.get(); }
+            shared_ptr<const UniformLayout> getLayoutPtr() const { return layout; }
+
+            //! offset as returned by UniformLayout::add
+            void setInt(unsigned int offset, int value) { write(offset, &value, sizeof(value)); }
+            void setFloat(unsigned int offset, float value) { write(offset, &value, sizeof(value)); }
+            void setVec2(unsigned int offset, const vec2& value) { write(offset, &value[0], sizeof(vec2)); }
+            void setVec3(unsigned int offset, const vec3& value) { write(offset, &value[0], sizeof(vec3)); }
+            void setVec4(unsigned int offset, const vec4& value) { write(offset, &value[0], sizeof(vec4)); }
+            void setMat4(unsigned int offset, const mat4& value) { write(offset, &value[0][0], sizeof(mat4)); }
+
+            const char* getData() const { return data.data(); }
+            unsigned int getSize() const { return data.size(); }
+
+        private:
+            shared_ptr<const UniformLayout> layout;
+            vector<char> data;
+
+            void write(unsigned int offset, const void* value, unsigned int bytes)
+            {
+                if (offset + bytes <= data.size())
+                    std::memcpy(&data[offset], value, bytes);
+            }
+    };
+}
@@ -1,18 +1,24 @@
 #pragma once
 
-#include <list>
+#include <vector>
 #include <memory>
+#include <functional>
+#include <mutex>
+#include "Entity.h"
+#include "Transforms.h"
+#include "SpatialIndex.h"
 
 namespace Arya
 {
-    using std::list;
+    using std::vector;
     using std::shared_ptr;
     using std::weak_ptr;
     using std::make_shared;
+    using std::function;
 
-    class Entity;
     class Terrain;
     class Skybox;
+    class VertexAnimationSystem;
 
     class World
     {
@@ -20,22 +26,134 @@ namespace Arya
             World();
             ~World();
 
-            // World holds a list of weak pointers to entities
-            // The user is responsible for maintaining the shared_ptr objects
-            // The user can delete an entity by simply resetting the shared_ptr
-            typedef list< weak_ptr<Entity> > EntityList;
+            // World keeps all entities in a packed array, in no particular order.
+            // Entities created with Entity::create are owned by the user:
+            // the user can delete such an entity by simply resetting the shared_ptr.
+            // Entities created with createEntity are owned by World
+            // and are deleted with destroyEntity.
+            typedef vector<Entity*> EntityList;
 
             const EntityList& getEntities() const { return entities; }
             Terrain*      getTerrain() const { return terrain; }
             Skybox*       getSkybox() const { return skybox; }
 
+            //! Positions, orientations and move matrices of all entities
+            TransformSystem& getTransforms() { return transforms; }
+            const TransformSystem& getTransforms() const { return transforms; }
+
+            //! Bounding boxes of all entities, kept up to date by updateBounds
+            const SpatialIndex& getSpatialIndex() const { return spatialIndex; }
+
+            //! Updates the bounds of the entities that moved or changed graphics
+            //! Called by update and by the queries below
+            void updateBounds();
+
+            //Spatial queries over the bounds of all entities
+            //The entities are appended to result
+            //These can not be called from within update
+
+            void queryBox(const vec3& boxMin, const vec3& boxMax, EntityList& result);
+            void querySphere(const vec3& center, float radius, EntityList& result);
+            //! Entities that are (partially) visible for a view-projection matrix
+            void queryFrustum(const mat4& viewProjection, EntityList& result);
+            //! The nearest entity hit by a ray, or nullptr
+            //! The distance is in units of the length of direction
+            Entity* raycast(const vec3& origin, const vec3& direction, float maxDistance, float* distance = 0);
+
+            //! State of all vertex animations, advanced in update
+            shared_ptr<VertexAnimationSystem> getAnimations() const { return animations; }
+
+            //! Creates an entity that is owned by World
+            //! Can not be called from within update
+            EntityHandle createEntity();
+            //! Deletes an entity created with createEntity
+            //! Does nothing for stale handles or entities owned by a shared_ptr
+            //! Deferred when called during update
+            void destroyEntity(EntityHandle handle);
+
+            //! Applies a change to the structure of the world, such as
+            //! deleting an entity or changing a parent.
+            //! During update, entities are updated in parallel and the change
+            //! is deferred until all entities are updated. Deferred changes are
+            //! applied in the order of the entities that made them, so the
+            //! result does not depend on the number of threads.
+            void applyChange(function<void()> change);
+            bool isUpdating() const { return updating; }
+
+            //! Returns nullptr if the entity no longer exists
+            Entity* getEntity(EntityHandle handle) const
+            {
+                if (handle.index >= slots.size()) return nullptr;
+                const EntitySlot& slot = slots[handle.index];
+                if (slot.generation != handle.generation) return nullptr;
+                return entities[slot.denseIndex];
+            }
+
+            //! The entity that currently has this handle index, or nullptr
+            //! Use this when only the index is known, for example from an id buffer
+            Entity* getEntityByIndex(uint32_t index) const
+            {
+                if (index >= slots.size()) return nullptr;
+                const EntitySlot& slot = slots[index];
+                if (slot.denseIndex >= entities.size()) return nullptr;
+                Entity* e = entities[slot.denseIndex];
+                return (e->getHandle().index == index ? e : nullptr);
+            }
+
+            //! Updates all entities, in parallel on the job system of Root
+            //! Entities owned by a shared_ptr must not be released during update
             void update(float elapsedTime);
+
+            //! With a fixed timestep, rendering happens between two updates.
+            //! When enabled, update keeps the matrices of the previous update and
+            //! entities are drawn at a blend of the two, given by the alpha
+            //! of the loop: 0 is the previous update and 1 the last one
+            void setInterpolation(bool enabled);
+            void setInterpolationAlpha(float alpha) { interpolationAlpha = alpha; }
+            float getInterpolationAlpha() const { return interpolationAlpha; }
+            mat4 getRenderMatrix(uint32_t transform) const
+            {
+                if (!interpolating) return transforms.getWorldMatrix(transform);
+                return transforms.getInterpolatedMatrix(transform, interpolationAlpha);
+            }
         private:
+            struct EntitySlot
+            {
+                uint32_t generation;
+                uint32_t denseIndex;
+                bool ownedByWorld;
+            };
+
             EntityList  entities;
+            vector<EntitySlot> slots;
+            vector<uint32_t> freeSlots;
+
+            TransformSystem transforms;
+
+            SpatialIndex spatialIndex;
+            vector<uint32_t> transformSlots; //slot index by transform id
+            vector<uint32_t> dirtyBounds; //slot indices
+            vector<uint32_t> queryResult;
+            void setBounds(Entity* e);
+            void collectQueryResult(EntityList& result);
+            // Animation states can outlive World
+            shared_ptr<VertexAnimationSystem> animations;
+
+            bool updating;
+            bool interpolating;
+            float interpolationAlpha;
+            //Deferred changes per chunk of entities
+            vector<vector<function<void()>>> chunkChanges;
+            //Deferred changes from threads that are not updating a chunk
+            vector<function<void()>> otherChanges;
+            std::mutex otherChangesMutex;
+
             Terrain*    terrain;
             Skybox*     skybox;
 
             friend class Entity;
-            void addEntity(weak_ptr<Entity> e);
+            void addEntity(Entity* e, bool ownedByWorld);
+            void removeEntity(Entity* e);
+            void markBoundsDirty(Entity* e);
     };
 }
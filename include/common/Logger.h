@@ -2,23 +2,55 @@
 // Usage:
 // LogError << "Message. Info: " << myvariable << " more info" << endl;
 //
+// Messages are formatted into a buffer of the thread that logs them.
+// endLog only copies the message into a ring buffer, a background thread
+// writes it to stdout and the log file. All loggers share the ring buffer
+// and the thread, so their messages are written in the order they were
+// logged. Messages for the callback (the console) are collected and passed
+// on by dispatchCallback on the main thread. Logging can be done from any
+// thread.
+//
+// The macros skip the whole statement, including the formatting of the
+// arguments, when no output wants the level. Levels below
+// ARYA_LOG_MIN_LEVEL are removed at compile time, by default this is
+// L_INFO when NDEBUG is defined (Release builds) and L_DEBUG otherwise.
+//
+// The macros also record the file and line of the statement. When the same
+// message comes from the same line again within the repeat interval, the
+// writer thread only counts it, and writes one "(repeated N times)" line per
+// interval. So a warning that is logged every frame does not flood the log
+// and the console. Critical errors are always written.
+//
 
 #pragma once
 
 #include <functional>
 #include <string>
-#include <sstream>
-#include <fstream>
+#include <ostream>
+#include <memory>
 #include <glm/glm.hpp>
 
 using glm::vec2;
 using glm::vec3;
 using glm::vec4;
 
-#define LogError    (Arya::logger << Arya::L_ERROR)
-#define LogWarning  (Arya::logger << Arya::L_WARNING)
-#define LogInfo     (Arya::logger << Arya::L_INFO)
-#define LogDebug    (Arya::logger << Arya::L_DEBUG)
+#ifndef ARYA_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define ARYA_LOG_MIN_LEVEL Arya::L_INFO
+#else
+#define ARYA_LOG_MIN_LEVEL Arya::L_DEBUG
+#endif
+#endif
+
+//An expression and not an if statement, so that it can not take the else of
+//an if around it. & binds weaker than << so the whole message is on the right
+#define ARYA_LOG(lg, level) \
+    ((level) < ARYA_LOG_MIN_LEVEL || !(lg).isEnabled(level)) ? (void)0 : Arya::LogVoidify() & (lg).begin((level), __FILE__, __LINE__)
+
+#define LogError    ARYA_LOG(Arya::logger, Arya::L_ERROR)
+#define LogWarning  ARYA_LOG(Arya::logger, Arya::L_WARNING)
+#define LogInfo     ARYA_LOG(Arya::logger, Arya::L_INFO)
+#define LogDebug    ARYA_LOG(Arya::logger, Arya::L_DEBUG)
 
 namespace Arya
 {
@@ -32,6 +64,37 @@ namespace Arya
         L_CRITICALERROR = 16
     };
 
+    //Grows a string that keeps its capacity, so building
+    //a message does not allocate once the thread has logged a few
+    class LogBuffer : public std::streambuf
+    {
+        public:
+            std::string text;
+
+        protected:
+            int_type overflow(int_type c)
+            {
+                if (c != traits_type::eof()) text.push_back((char)c);
+                return c;
+            }
+            std::streamsize xsputn(const char* s, std::streamsize n)
+            {
+                text.append(s, n);
+                return n;
+            }
+    };
+
+    //The message a thread is building
+    struct LogRecord
+    {
+        LogRecord() : level(L_NONE), file(0), line(0), stream(&buffer) {}
+        LOGLEVEL level;
+        const char* file; //where the message is logged, 0 when unknown
+        int line;
+        LogBuffer buffer;
+        std::ostream stream;
+    };
+
     class Logger
     {
         public:
@@ -47,28 +110,63 @@ namespace Arya
             int fileLogLevel;
             int callbackLogLevel;
 
-            void setLoggerCallback(std::function<void(const std::string&)> func){ callbackFunc = func; return; }
+            void setLoggerCallback(std::function<void(const std::string&)> func);
+
+            //! True when an output wants messages of this level
+            bool isEnabled(LOGLEVEL level) const {
+                return ((stdoutLogLevel | fileLogLevel | (hasCallback ? callbackLogLevel : 0)) & level) != 0;
+            }
+
+            //! Calls the callback for the messages logged since the last call.
+            //! The callback runs on the thread that calls this, Root calls it
+            //! on the main thread every frame
+            void dispatchCallback();
+
+            //! Waits until all messages logged so far are written
+            void sync();
+
+            //! Identical messages from the same line within this many seconds
+            //! are collapsed into one "(repeated N times)" line, 0 turns it off.
+            //! Default is 5 seconds
+            void setRepeatInterval(float seconds);
+
+            //! Starts a message, used by the macros
+            Logger& begin(LOGLEVEL level, const char* file, int line);
 
             //TODO: If this does not compile, revert to old method
             //This might not compile on MSVC++
             template<class T>
             inline Logger& operator<<(const T& t) {
-                streambuff << t;
+                record().stream << t;
                 return *this;
             }
 
         private:
             std::function<void(const std::string&)> callbackFunc;
-            std::ofstream filestream;
+            bool hasCallback;
+
+            //Every logger has its own record on every thread
+            static const int maxLoggers = 8;
+            int index;
+            LogRecord& record();
 
-            //TODO: THIS SHOULD BE THREAD-LOCAL
-            std::stringstream streambuff;
-            LOGLEVEL currentLogLevel; //log level of the message in the streambuff
+            //pimpl: the outputs of this logger
+            struct Writer;
+            std::unique_ptr<Writer> writer;
+
+            //The ring buffer and the writer thread, shared by all loggers
+            struct Queue;
+            static Queue& queue();
 
             void flush();
 
             friend Logger& endLog(Logger& logger);
-            friend Logger& operator<<(Logger& logger, LOGLEVEL lvl);
+    };
+
+    //Turns a log statement into a void expression, see ARYA_LOG
+    struct LogVoidify
+    {
+        void operator&(Logger&) {}
     };
 
     //So you can do logger << endLog;
@@ -79,37 +177,42 @@ namespace Arya
     };
 
     inline Logger& operator<<(Logger& logger, LOGLEVEL lvl){
+        return logger.begin(lvl, 0, 0);
+    }
+
+    inline Logger& Logger::begin(LOGLEVEL lvl, const char* file, int line){
         //This construction allows the following:
         //LogWarning << "test1";
         //LogWarning << "test2" << endLog;
         //so that Warning is only displayed once
-        if( logger.currentLogLevel == L_NONE ) {
-            logger.currentLogLevel = lvl;
-            //Reset the stringstream
-            logger.streambuff.str(std::string());
-            logger.streambuff.seekp(0);
-            logger.streambuff.clear();
+        LogRecord& record = this->record();
+        record.file = file;
+        record.line = line;
+        if( record.level == L_NONE ) {
+            record.level = lvl;
+            record.buffer.text.clear();
+            record.stream.clear();
             switch(lvl){
                 case L_CRITICALERROR:
-                    logger.streambuff << "Critical ERROR: ";
+                    record.buffer.text.append("Critical ERROR: ");
                     break;
                 case L_ERROR:
-                    logger.streambuff << "ERROR: ";
+                    record.buffer.text.append("ERROR: ");
                     break;
                 case L_WARNING:
-                    logger.streambuff << "Warning: ";
+                    record.buffer.text.append("Warning: ");
                     break;
                 case L_INFO:
-                    logger.streambuff << "Info: ";
+                    record.buffer.text.append("Info: ");
                     break;
                 case L_DEBUG:
-                    logger.streambuff << "Debug: ";
+                    record.buffer.text.append("Debug: ");
                     break;
                 default:
                     break;
             };
         }
-        return logger;
+        return *this;
     }
 
     inline Logger& operator<<(Logger& logger, const vec2& v)
@@ -0,0 +1,173 @@
+//
+// Binary trace
+//
+// For events that happen too often to log as text: frames, resource loads,
+// and in the game unit moves, ability checks and tile hover changes.
+//
+// Usage:
+// traceEvent(TRACE_MY_EVENT, unitId, x, y);
+// { TraceScope scope(TRACE_MY_SPAN, arg); ... } //records the duration
+//
+// An event is a fixed size TraceRecord: time, duration, event id and four
+// integers. It goes into a ring buffer of the calling thread, which does
+// not lock or allocate after the first event of that thread and costs a
+// few tens of nanoseconds, so the trace is on by default. The rings keep
+// the last recordsPerThread events of every thread, and after an incident
+// they can be written to a file with dump (console command "tracedump").
+//
+// startStream writes the records to a file as well, from a background
+// thread every 100 ms. Records that were overwritten before the stream got
+// to them are counted in a TRACE_DROPPED record.
+//
+// Event ids below TRACE_USER are used by Arya. The names of the events and
+// their arguments are stored in the file, so tools/tracedump can print the
+// records or convert them to Chrome trace (chrome://tracing) or CSV.
+// A string can be passed as argument by interning it, an argument whose
+// name starts with $ is printed as the interned string.
+//
+// File format: a TraceFileHeader followed by chunks. Every chunk is a
+// TraceChunk and size bytes of data: names (uint32 id, uint32 length and
+// the characters) or TraceRecords. Names of events are "name|arg0,arg1".
+//
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <memory>
+
+namespace Arya
+{
+    using std::string;
+
+    enum TraceEvent
+    {
+        TRACE_DROPPED = 0, //thread, count
+        TRACE_FRAME = 1, //frame
+        TRACE_SIMULATE = 2, //steps
+        TRACE_RESOURCE_LOAD = 3, //$file, loaded
+        TRACE_USER = 256 //first id for the game
+    };
+
+    struct TraceRecord
+    {
+        uint64_t time; //nanoseconds since the tracer was created
+        uint32_t duration; //nanoseconds, 0 for an instant event
+        uint16_t event;
+        uint16_t thread;
+        int32_t args[4];
+    };
+    static_assert(sizeof(TraceRecord) == 32, "TraceRecord is stored in files");
+
+    enum TraceChunkType
+    {
+        TRACE_CHUNK_EVENTS = 1,
+        TRACE_CHUNK_STRINGS = 2,
+        TRACE_CHUNK_RECORDS = 3
+    };
+
+    static const uint32_t traceMagic = ('A' << 0) | ('r' << 8) | ('T' << 16) | ('r' << 24);
+    static const uint32_t traceVersion = 1;
+
+    struct TraceFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t reserved;
+    };
+
+    struct TraceChunk
+    {
+        uint32_t type;
+        uint32_t size; //bytes of data after this header
+    };
+
+    //! There is one tracer, the global object tracer
+    class Tracer
+    {
+        public:
+            Tracer();
+            ~Tracer();
+
+            //! Records per thread that are kept, 16384 is about 8 seconds
+            //! at 2000 events per second
+            static const unsigned int recordsPerThread = 16384; //power of two
+
+            void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+            bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+            //! argNames separated by commas
+            void registerEvent(uint16_t id, const string& name, const string& argNames = "");
+            //! Returns the same id for the same string
+            int32_t intern(const string& text);
+
+            //! Nanoseconds since the tracer was created
+            uint64_t now() const;
+
+            //! Use traceEvent, traceSpan or TraceScope
+            void record(uint16_t event, uint64_t time, uint64_t duration,
+                    int32_t a, int32_t b, int32_t c, int32_t d);
+
+            //! Writes the records that are in the ring buffers now
+            bool dump(const string& filename);
+
+            //! Writes all records to a file, until stopStream
+            bool startStream(const string& filename);
+            void stopStream();
+            bool isStreaming() const;
+
+        private:
+            std::atomic<bool> enabled;
+
+            //pimpl: the ring buffers of the threads, the names and the stream
+            struct Buffer;
+            struct Data;
+            std::unique_ptr<Data> data;
+
+            Buffer* acquireBuffer();
+            void releaseBuffer(Buffer* buffer);
+            friend struct TraceThread;
+    };
+
+    extern Tracer tracer;
+
+    inline void traceEvent(uint16_t event, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0)
+    {
+        if (tracer.isEnabled())
+            tracer.record(event, tracer.now(), 0, a, b, c, d);
+    }
+
+    //! An event from start (as given by tracer.now()) until now
+    inline void traceSpan(uint16_t event, uint64_t start, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0)
+    {
+        if (tracer.isEnabled())
+        {
+            uint64_t end = tracer.now();
+            tracer.record(event, start, end - start, a, b, c, d);
+        }
+    }
+
+    //! Records an event with the lifetime of the scope as duration
+    class TraceScope
+    {
+        public:
+            TraceScope(uint16_t event, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0)
+                : event(event), active(tracer.isEnabled()), start(active ? tracer.now() : 0), args{a, b, c, d} {}
+            ~TraceScope()
+            {
+                if (active)
+                    traceSpan(event, start, args[0], args[1], args[2], args[3]);
+            }
+
+            //! For results that are known at the end
+            void setArg(unsigned int index, int32_t value) { if (index < 4) args[index] = value; }
+
+        private:
+            uint16_t event;
+            bool active;
+            uint64_t start;
+            int32_t args[4];
+    };
+}
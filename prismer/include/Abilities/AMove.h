@@ -7,6 +7,8 @@ namespace Prismer {
 
 using std::vector;
 
+class Grid;
+
 class AMove : public Ability
 {
     public:
@@ -21,6 +23,13 @@ class AMove : public Ability
 
     private:
         vector<Arya::InputBinding> keyBindings;
+
+        // the tiles that are marked reachable while the unit is active
+        Grid* _grid = nullptr;
+        vector<int> _reachable;
+
+        void showMoves();
+        void hideMoves();
 };
 
 } // namespace Prismer
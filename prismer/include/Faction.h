@@ -19,6 +19,10 @@ class Faction
         Faction(int id, weak_ptr<GameSession> session);
         ~Faction();
 
+        int getId() const {
+            return _id;
+        }
+
         void setInput(shared_ptr<FactionInput> input) {
             _input = input;
         }
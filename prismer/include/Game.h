@@ -14,7 +14,7 @@ class Game
         Game();
         ~Game();
 
-        bool init();
+        bool init(int boardWidth, int boardHeight);
         void run();
 
     private:
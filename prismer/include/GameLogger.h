@@ -1,10 +1,10 @@
 #pragma once
 #include "common/Logger.h"
 
-#define GameLogError    (gameLogger << Arya::L_ERROR << __func__ << "():" << __LINE__ << "  ")
-#define GameLogWarning  (gameLogger << Arya::L_WARNING << __func__ << "():" << __LINE__ << "  ")
-#define GameLogInfo     (gameLogger << Arya::L_INFO << __func__ << "():" << __LINE__ << "  ")
-#define GameLogDebug    (gameLogger << Arya::L_DEBUG << __func__ << "():" << __LINE__ << "  ")
+#define GameLogError    ARYA_LOG(gameLogger, Arya::L_ERROR) << __func__ << "():" << __LINE__ << "  "
+#define GameLogWarning  ARYA_LOG(gameLogger, Arya::L_WARNING) << __func__ << "():" << __LINE__ << "  "
+#define GameLogInfo     ARYA_LOG(gameLogger, Arya::L_INFO) << __func__ << "():" << __LINE__ << "  "
+#define GameLogDebug    ARYA_LOG(gameLogger, Arya::L_DEBUG) << __func__ << "():" << __LINE__ << "  "
 
 using Arya::endLog;
 
@@ -27,7 +27,8 @@ class GameSession
         GameSession();
         virtual ~GameSession();
 
-        void init();
+        //! Creates a board of width by height tiles
+        void init(int width, int height);
 
         //! Check if this session is running on a server
         //! If a Unit performs an action on
@@ -32,7 +32,7 @@ class GameSessionClient : public GameSession
 
         //! Initialize the session
         //! Registers keybindings and event handlers
-        bool init();
+        bool init(int width, int height);
 
         //! Update all game engine related things like camera movement
         void update(float elapsedTime); //in seconds
@@ -48,6 +48,9 @@ class GameSessionClient : public GameSession
         void toggleFPS();
 
      private:
+        //! Marks the tiles that the current faction sees as visible
+        void updateFog();
+
         unique_ptr<GameSessionInput> _input;
 
         shared_ptr<GridEntity> _grid_entity;
@@ -57,6 +60,9 @@ class GameSessionClient : public GameSession
         unique_ptr<GameInterface> _interface;
 
         float total_time = 0.0f;
+
+        int _fogFaction = -1;
+        vector<int> _fogChanges;
 };
 
 } // namespace Prismer
@@ -0,0 +1,19 @@
+#pragma once
+#include "common/Trace.h"
+
+namespace Prismer {
+
+// events of the game in the binary trace of Arya,
+// see common/Trace.h and tools/tracedump
+enum GameTraceEvent {
+    TRACE_UNIT_MOVE = Arya::TRACE_USER, // unit, x, y
+    TRACE_TILE_HOVER, // x, y
+    TRACE_MOVE_CHECK, // unit, x, y, valid
+    TRACE_GATHER_CHECK, // unit, x, y, valid
+    TRACE_VISION_UPDATE // unit, x, y, tiles
+};
+
+// gives the events their names in trace files
+void registerGameTraceEvents();
+
+} // namespace Prismer
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <memory>
+#include <cstdlib>
 
 #include "Tile.h"
+#include "Pathfinder.h"
+#include "Vision.h"
 
 namespace Prismer {
 
@@ -11,6 +14,12 @@ using std::shared_ptr;
 class GridEntity;
 class GridInput;
 
+// The state of the tiles is kept in arrays with an entry per tile,
+// at index x * height + y. Units are referenced by a slot in _units,
+// the graphics of a tile by the same index in the grid entity.
+// Use getTile for a TileRef, or the functions that take an index
+// in loops over many tiles. Movement is in getPathfinder, what the
+// factions see in getVision.
 class Grid
     : public std::enable_shared_from_this<Grid>
 {
@@ -19,6 +28,13 @@ class Grid
 
         void init();
 
+        // offsets of the neighbors in the order of TileDirection
+        static const int neighborOffsets[6][2];
+
+        // move cost of a tile that can not be entered
+        static const int impassable = 0;
+        static const int maxMoveCost = 15;
+
         int getWidth() const {
             return _width;
         }
@@ -27,20 +43,98 @@ class Grid
             return _height;
         }
 
-        vector<shared_ptr<Tile>>& getTiles() {
-            return _tiles;
+        int getTileCount() const {
+            return _width * _height;
+        }
+
+        bool contains(int x, int y) const {
+            return x >= 0 && y >= 0 && x < _width && y < _height;
         }
 
-        shared_ptr<Tile> getTile(int x, int y);
+        // -1 for coordinates outside the grid
+        int getIndex(int x, int y) const {
+            return contains(x, y) ? x * _height + y : -1;
+        }
 
-        shared_ptr<Tile> getNeighbor(int x, int y, TileDirection dir);
+        int getX(int index) const {
+            return index / _height;
+        }
+
+        int getY(int index) const {
+            return index % _height;
+        }
+
+        TileRef getTile(int x, int y);
+
+        TileRef getTile(int index) {
+            return getTile(getX(index), getY(index));
+        }
 
-        int distance(int x1, int y1, int x2, int y2) {
+        TileRef getNeighbor(int x, int y, TileDirection dir);
+
+        // index of the neighbor, -1 if it is outside the grid
+        int getNeighborIndex(int x, int y, TileDirection dir) const;
+
+        static int distance(int x1, int y1, int x2, int y2) {
             int z1 = -x1 - y1;
             int z2 = -x2 - y2;
             return (abs(x1 - x2) + abs(y2 - y1) + abs(z2 - z1)) / 2;
         }
 
+        bool hasFlag(int index, TileFlag flag) const {
+            return (_flags[index] & flag) != 0;
+        }
+
+        // updates the graphics of the tile
+        void setFlag(int index, TileFlag flag, bool set);
+
+        const TileResources& getResources(int index) const {
+            return _resources[index];
+        }
+
+        ColorID popResource(int index) {
+            return _resources[index].pop();
+        }
+
+        bool hasUnit(int index) const {
+            return _unitSlots[index] >= 0;
+        }
+
+        shared_ptr<Unit> getUnit(int index) const {
+            int slot = _unitSlots[index];
+            return slot >= 0 ? _units[slot] : nullptr;
+        }
+
+        // nullptr removes the unit from the tile
+        void setUnit(int index, shared_ptr<Unit> unit);
+
+        // move points it takes to enter the tile, 1 by default
+        int getMoveCost(int index) const {
+            return _moveCosts[index];
+        }
+
+        void setMoveCost(int index, int cost);
+
+        // a bit per TileDirection with a wall on that edge
+        int getWalls(int index) const {
+            return _walls[index];
+        }
+
+        bool hasWall(int index, TileDirection dir) const {
+            return (_walls[index] & (1 << dir)) != 0;
+        }
+
+        // also sets the wall of the neighbor on the other side
+        void setWall(int index, TileDirection dir, bool wall);
+
+        Pathfinder& getPathfinder() {
+            return *_pathfinder;
+        }
+
+        Vision& getVision() {
+            return *_vision;
+        }
+
         void setEntity(shared_ptr<GridEntity> entity) {
             _entity = entity;
         }
@@ -53,15 +147,21 @@ class Grid
             _input = input;
         }
 
-        vector<float> getVision(shared_ptr<Tile>) const {
-            return vector<float>();
-        }
-
     private:
         int _width;
         int _height;
 
-        vector<shared_ptr<Tile>> _tiles;
+        vector<uint8_t> _flags;
+        vector<TileResources> _resources;
+        vector<int32_t> _unitSlots; // -1 for no unit
+        vector<uint8_t> _moveCosts;
+        vector<uint8_t> _walls;
+
+        vector<shared_ptr<Unit>> _units;
+        vector<int32_t> _freeUnitSlots;
+
+        std::unique_ptr<Pathfinder> _pathfinder;
+        std::unique_ptr<Vision> _vision;
 
         shared_ptr<GridEntity> _entity;
         shared_ptr<GridInput> _input;
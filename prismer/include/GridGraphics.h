@@ -3,8 +3,11 @@
 #include <memory>
 #include <map>
 
+#include "Tile.h"
+
 namespace Arya {
     class Model;
+    class UniformLayout;
 }
 
 namespace Prismer {
@@ -13,7 +16,6 @@ using std::weak_ptr;
 using std::shared_ptr;
 
 class Grid;
-class Tile;
 class TileEntity;
 
 class GridEntity
@@ -23,12 +25,15 @@ class GridEntity
         GridEntity(weak_ptr<Grid> grid);
         
         vec2 boardToWorld(int row, int col);
-        shared_ptr<Tile> worldToBoard(float x, float y);
+        TileRef worldToBoard(float x, float y);
 
         void update();
 
         void init();
 
+        // the state of the tile at this index of the grid changed
+        void updateTile(int index);
+
         float getScale() const {
             return _scale;
         }
@@ -41,13 +46,21 @@ class GridEntity
             return activeTile;
         }
 
+        // layout of the uniforms of a tile entity, contains
+        // vec4 customUniform, nullptr if the shader failed to load
+        shared_ptr<const Arya::UniformLayout> getTileUniforms() const {
+            return _tileUniforms;
+        }
+
     private:
         weak_ptr<Grid> _grid;
         float _scale = 0.0f;
 
+        // at the index of their tile
         vector<shared_ptr<TileEntity>> tile_entities;
         shared_ptr<Arya::Model> baseTile;
         shared_ptr<Arya::Model> activeTile;
+        shared_ptr<const Arya::UniformLayout> _tileUniforms;
 };
 
 } // namespace Prismer
@@ -7,6 +7,10 @@
 // FIXME: move TileDireftion to separate file
 #include "Tile.h"
 
+namespace Arya {
+    struct MousePos;
+}
+
 namespace Prismer {
 
 using std::vector;
@@ -14,7 +18,6 @@ using std::weak_ptr;
 using std::shared_ptr;
 
 class Grid;
-class Tile;
 
 class GridInput 
     : public std::enable_shared_from_this<GridInput> {
@@ -25,26 +28,28 @@ class GridInput
         void activate();
         void deactivate();
 
-        shared_ptr<Tile> getActive() const {
+        TileRef getActive() const {
             return _active;
         }
 
-        shared_ptr<Tile> getHovered() const {
+        TileRef getHovered() const {
             return _hovered;
         }
         
-        void setActive(shared_ptr<Tile> tile);
-        void toggleVisible(shared_ptr<Tile> tile);
+        void setActive(TileRef tile);
+        void toggleWalls(TileRef tile);
 
     private:
         weak_ptr<Grid> _grid;
         
-        void setHovered(shared_ptr<Tile> tile);
+        void setHovered(TileRef tile);
         void setHovered(TileDirection dir);
+        void hoverAt(const Arya::MousePos& position);
 
 
-        shared_ptr<Tile> _active = nullptr;
-        shared_ptr<Tile> _hovered = nullptr;
+        TileRef _active;
+        TileRef _hovered;
+        TileRef _under_cursor;
 
         vector<Arya::InputBinding> keyBindings;
 };
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <climits>
+#include <cstdint>
+
+namespace Prismer {
+
+using std::vector;
+
+class Grid;
+
+// the tiles that a unit can move to from origin
+struct MoveRange {
+    int origin = -1;
+    int movePoints = 0;
+    bool valid = false;
+
+    // reachable tiles and the move points to get there, sorted by index
+    vector<int> tiles;
+    vector<int> costs;
+
+    // the reachable tiles and the tiles next to them that could not be
+    // entered, sorted by index. Only a change to one of these tiles can
+    // change the range.
+    vector<int> explored;
+
+    // -1 if the tile can not be reached
+    int getCost(int index) const;
+};
+
+// Movement over the grid. Entering a tile costs its move cost (see
+// Grid::setMoveCost), a tile with cost 0 or with a unit on it can not
+// be entered, and a wall between two tiles can not be crossed. getMoves
+// is a Dijkstra flood for the move range of a unit, findPath is an A*
+// search with the hex distance as heuristic.
+//
+// The costs are small integers, so both use a bucket queue instead of a
+// heap, and the costs of the tiles are kept in buffers of the size of the
+// grid that are reused by every query. Move ranges are cached per unit
+// until one of the tiles they explored changes, or the turn ends.
+// Tiles are given by their index in the grid.
+class Pathfinder
+{
+    public:
+        Pathfinder(Grid& grid);
+
+        //! The move range of the unit with id key, standing on origin
+        //! Cached, valid until the next call for the same key
+        const MoveRange& getMoves(int key, int origin, int movePoints);
+
+        //! Path from start to goal, without start and with goal
+        //! Returns the cost of the path, or -1 and an empty path when
+        //! the goal can not be reached for at most maxCost
+        int findPath(int start, int goal, vector<int>& path, int maxCost = INT_MAX);
+
+        //! Called by the grid when a unit or the move cost of a tile changes
+        void tileChanged(int index);
+
+        //! Called at the start of a turn
+        void clearCache();
+
+        //! Forgets the move range of a unit that is destroyed
+        void removeUnit(int key);
+
+    private:
+        // The priorities in the queue are always less than bucketCount
+        // apart: at most the largest move cost plus one for A*
+        class BucketQueue
+        {
+            public:
+                static const int bucketCount = 32; // power of two
+
+                //! Nothing can be pushed below lowest
+                void clear(int lowest);
+
+                bool empty() const {
+                    return _size == 0;
+                }
+
+                void push(int index, int priority) {
+                    _buckets[priority & (bucketCount - 1)].push_back(index);
+                    _size++;
+                }
+
+                int pop(int& priority);
+
+            private:
+                vector<int> _buckets[bucketCount];
+                int _current = 0;
+                int _size = 0;
+        };
+
+        Grid& _grid;
+
+        // index offset of the neighbors, in the order of TileDirection
+        int _neighborDelta[6];
+
+        // per tile, the entries are only valid when the stamp of the
+        // tile is the one of the current query
+        vector<uint32_t> _stamp;
+        vector<uint32_t> _exploredStamp;
+        vector<int32_t> _cost;
+        vector<int32_t> _from;
+        uint32_t _query = 0;
+
+        BucketQueue _queue;
+
+        std::unordered_map<int, MoveRange> _ranges;
+
+        void beginQuery();
+        bool canEnter(int index) const;
+
+        bool seen(int index) const {
+            return _stamp[index] == _query;
+        }
+
+        void setCost(int index, int cost, int from) {
+            _stamp[index] = _query;
+            _cost[index] = cost;
+            _from[index] = from;
+        }
+
+        void flood(MoveRange& range);
+};
+
+} // namespace Prismer
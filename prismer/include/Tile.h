@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <memory>
+#include <cstdint>
 
 #include "GameLogger.h"
 #include "Colors.h"
@@ -18,77 +19,79 @@ enum TileDirection {
     bottom_left
 };
 
+// state of a tile, bits of the flag array of the grid
+enum TileFlag {
+    tile_active = 1 << 0,
+    tile_hovered = 1 << 1,
+    tile_visible = 1 << 2,
+    tile_reachable = 1 << 3 // in the move range of the active unit
+};
+
 using std::vector;
 using std::shared_ptr;
-using std::weak_ptr; 
+using std::weak_ptr;
 
 class Grid;
 class Unit;
-class Tile;
-class TileEntity;
-
-class TileInfo {
-    public:
-        TileInfo() {
-            _resources.push_back(ColorID::red);
-        }
 
-        bool hasResource() {
-            return !_resources.empty();
-        }
+// the resources on a tile, stored inline in the resource array
+// of the grid so that a tile does not need its own allocation
+struct TileResources {
+    static const int capacity = 3;
 
-        bool hasUnit() {
-            if(_unit)
-                return true;
-            return false;
-        }
+    uint8_t count = 0;
+    uint8_t colors[capacity] = {};
 
-        void setUnit(shared_ptr<Unit> unit) {
-            if(unit && hasUnit()) {
-                GameLogError << "Tile " << this << " already has unit." << endLog;
-                return;
-            }
-            _unit = unit;
-        }
+    bool empty() const {
+        return count == 0;
+    }
 
-        shared_ptr<Unit> getUnit() const {
-            return _unit;
-        }
+    bool push(ColorID color) {
+        if (count == capacity)
+            return false;
+        colors[count++] = (uint8_t)color;
+        return true;
+    }
+
+    ColorID pop() {
+        if (count == 0)
+            return ColorID::na;
+        return (ColorID)colors[--count];
+    }
+};
 
-        ColorID popResource() {
-            if (_resources.empty())
-                return ColorID::na;
+// A tile of a grid. The state of the tiles is kept in arrays
+// of the grid, this is only the grid, the coordinates and the
+// index in those arrays, so it is cheap to copy and to compare.
+// A TileRef is valid as long as its grid is, the default one
+// refers to no tile.
+class TileRef {
+    public:
+        TileRef() { }
 
-            auto color = _resources.back();
-            _resources.pop_back();
+        TileRef(Grid* grid, int x, int y, int index)
+            : _grid(grid), _index(index), _x(x), _y(y)
+        { }
 
-            return color;
+        explicit operator bool() const {
+            return _grid != nullptr;
         }
 
-        bool isActive() const {
-            return _active;
+        bool operator==(const TileRef& rhs) const {
+            return _grid == rhs._grid && _index == rhs._index;
         }
 
-        bool isHovered() const {
-            return _hovered;
+        bool operator!=(const TileRef& rhs) const {
+            return !(*this == rhs);
         }
 
-        bool isVisible() const {
-            return _visible;
+        Grid* getGrid() const {
+            return _grid;
         }
 
-    friend class Tile;
-    protected:
-        bool _active = false;
-        bool _hovered = false;
-        bool _visible = false;
-        shared_ptr<Unit> _unit = nullptr;
-        vector<ColorID> _resources;
-};
-
-class Tile {
-    public:
-        Tile(int x, int y, weak_ptr<Grid> grid);
+        int getIndex() const {
+            return _index;
+        }
 
         int getX() const {
             return _x;
@@ -102,33 +105,36 @@ class Tile {
             return - (_x + _y);
         }
 
-        shared_ptr<TileInfo> getInfo() const {
-            return _info;
-        }
+        TileRef getNeighbor(TileDirection dir) const;
 
-        shared_ptr<Tile> getNeighbor(TileDirection dir);
+        int distance(const TileRef& rhs) const;
 
-        int distance(shared_ptr<Tile> rhs);
-
-        void setEntity(shared_ptr<TileEntity> entity) {
-            _entity = entity;
-        }
+        bool isActive() const;
+        bool isHovered() const;
+        bool isVisible() const;
+        bool isReachable() const;
 
         // FIXME: Technically this is stuff for graphics, options:
         // 1. make tile larger than necessary (and info)
         // 2. couple input and graphics..
         // not sure which is better
-        void setActive(bool active);
-        void setHovered(bool hovered);
-        void setVisible(bool visible);
+        void setActive(bool active) const;
+        void setHovered(bool hovered) const;
+        void setVisible(bool visible) const;
+        void setReachable(bool reachable) const;
 
-    private:
-        int _x;
-        int _y;
+        bool hasResource() const;
+        ColorID popResource() const;
 
-        shared_ptr<TileInfo> _info;
-        shared_ptr<TileEntity> _entity;
-        weak_ptr<Grid> _grid;
+        bool hasUnit() const;
+        shared_ptr<Unit> getUnit() const;
+        void setUnit(shared_ptr<Unit> unit) const;
+
+    private:
+        Grid* _grid = nullptr;
+        int _index = -1;
+        int _x = 0;
+        int _y = 0;
 };
 
 } // namespace Prismer
@@ -2,6 +2,8 @@
 
 #include <memory>
 
+#include "Tile.h"
+
 namespace Arya {
     class Entity;
     class EntityUserData;
@@ -12,24 +14,25 @@ namespace Prismer {
 using std::weak_ptr;
 
 class GridEntity;
-class Tile;
 
 class TileEntity
     : public Arya::EntityUserData {
     public:
-        TileEntity(weak_ptr<Tile> tile,
+        TileEntity(TileRef tile,
                 weak_ptr<GridEntity> grid_entity);
         
         void update();
 
-        weak_ptr<Tile> getTile() const {
+        TileRef getTile() const {
             return _tile;
         };
 
     private:
-        weak_ptr<Tile> _tile;
+        TileRef _tile;
         weak_ptr<GridEntity> _grid_entity;
         shared_ptr<Arya::Entity> _entity;
+        bool _highlighted = false;
+        unsigned int _colorField = 0;
 };
 
 } // namespace Prismer
@@ -3,6 +3,7 @@
 #include <Arya.h>
 
 #include "GameLogger.h"
+#include "Tile.h"
 
 #include <memory>
 
@@ -14,7 +15,6 @@ using std::weak_ptr;
 class GridInput;
 class GameSession;
 class UnitEntity;
-class Tile;
 class Faction;
 
 class Unit
@@ -55,12 +55,16 @@ class Unit
             return _speed;
         }
 
+        int getVisionRange() const {
+            return _visionRange;
+        }
+
         virtual void activate(shared_ptr<GridInput> grid_input);
         virtual void deactivate();
 
-        void setTile(shared_ptr<Tile> tile);
+        void setTile(TileRef tile);
 
-        weak_ptr<Tile> getTile() {
+        TileRef getTile() const {
             return _tile;
         }
 
@@ -74,6 +78,7 @@ class Unit
     protected:
         int _mp = 2;
         float _speed = 2.0f;
+        int _visionRange = 3;
 
     private:
         int _id;
@@ -82,7 +87,7 @@ class Unit
 
         weak_ptr<Faction> _faction;
         shared_ptr<UnitEntity> _entity;
-        weak_ptr<Tile> _tile;
+        TileRef _tile;
 };
 
 } // namespace Prismer
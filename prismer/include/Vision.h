@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace Prismer {
+
+using std::vector;
+
+class Grid;
+
+// What the factions can see of the grid.
+//
+// Every unit is an observer with a vision range. What an observer sees is
+// found by shadowcasting: the rings around its tile are walked outwards,
+// and a tile is visible when the line from the center of the observer to
+// its center does not pass through a wall (see Grid::setWall) of a closer
+// ring. Walls are stored as the angles they cover, so a ring costs a
+// lookup per tile instead of a line walk.
+//
+// Every faction has a count per tile of its observers that see it, and a
+// bitset with the tiles it sees. When a unit moves, only that unit is
+// recomputed; when a wall changes, only the observers that have it in
+// range. Tiles are given by their index in the grid.
+class Vision
+{
+    public:
+        Vision(Grid& grid);
+
+        //! Sets the unit with this id as observer at origin, and
+        //! recomputes what it sees
+        void setObserver(int id, int faction, int origin, int range);
+        void removeObserver(int id);
+
+        bool isVisible(int faction, int index) const;
+
+        //! A bit per tile index, empty for a faction without observers
+        const vector<uint64_t>& getVisibleBits(int faction) const;
+
+        //! The tiles of which the visibility for the faction changed since
+        //! the last call, can have duplicates
+        void takeChanges(int faction, vector<int>& changed);
+
+        //! Called by the grid when the wall between two tiles changes
+        void wallChanged(int index, int neighbor);
+
+        //! The tiles that can be seen from origin within range
+        void computeVisible(int origin, int range, vector<int>& visible);
+
+    private:
+        struct Observer {
+            int faction = 0;
+            int origin = -1;
+            int range = 0;
+            vector<int> visible;
+        };
+
+        struct FactionVision {
+            vector<uint16_t> counts;
+            vector<uint64_t> bits;
+            vector<int> changed;
+        };
+
+        // an angle range that is blocked by walls, in radians
+        struct Shadow {
+            float begin;
+            float end;
+        };
+
+        Grid& _grid;
+
+        std::unordered_map<int, Observer> _observers;
+        std::unordered_map<int, FactionVision> _factions;
+
+        // reused by every computation
+        vector<Shadow> _shadows;
+        vector<int> _ring;
+        vector<int> _visible;
+
+        FactionVision& getFaction(int faction);
+        void update(Observer& observer, int id);
+        void see(FactionVision& faction, int index, int amount);
+
+        void addWallShadows(int index, int dx, int dy);
+        void addShadow(float begin, float end);
+        void mergeShadows();
+        bool inShadow(float angle) const;
+};
+
+} // namespace Prismer
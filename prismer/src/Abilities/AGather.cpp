@@ -4,6 +4,7 @@
 #include "Unit.h"
 
 #include "GameLogger.h"
+#include "GameTrace.h"
 
 namespace Prismer {
 
@@ -19,11 +20,15 @@ void AGather::perform()
 bool AGather::isValid()
 {
     auto hover = _grid_input->getHovered();
+    Arya::TraceScope trace(TRACE_GATHER_CHECK, _actor ? _actor->getId() : -1,
+            hover ? hover.getX() : -1, hover ? hover.getY() : -1);
     if (!hover)
         return false;
 
     // FIXME: unit next to it?
-    return hover->getInfo()->hasResource();
+    bool valid = hover.hasResource();
+    trace.setArg(3, valid ? 1 : 0);
+    return valid;
 }
 
 void AGather::activate(shared_ptr<Unit> actor,
@@ -1,41 +1,49 @@
 #include "Abilities/AMove.h"
+#include "Grid.h"
 #include "Tile.h"
 #include "GridInput.h"
 #include "Unit.h"
 
 #include "GameLogger.h"
+#include "GameTrace.h"
 
 namespace Prismer {
 
 void AMove::perform()
 {
-    _grid_input->setActive(nullptr);
+    _grid_input->setActive(TileRef());
     _actor->setTile(_grid_input->getHovered());
 }
 
 bool AMove::isValid()
 {
     auto hover= _grid_input->getHovered();
+    // valid stays 0 unless the check passes
+    Arya::TraceScope trace(TRACE_MOVE_CHECK, _actor ? _actor->getId() : -1,
+            hover ? hover.getX() : -1, hover ? hover.getY() : -1);
     if (!hover) {
         GameLogInfo << "No hovered tile" << endLog;
         return false;
     }
 
-    if(auto origin = _actor->getTile().lock()) {
-        if (!(_actor->getMovePoints() >= origin->distance(hover))) {
-            GameLogInfo << "Not enough MP" << endLog;
+    if(auto origin = _actor->getTile()) {
+        if (hover.hasUnit()) {
+            GameLogInfo << "Unit at target" << endLog;
             return false;
         }
 
-        if (hover->getInfo()->hasUnit()) {
-            GameLogInfo << "Unit at target" << endLog;
+        auto& moves = origin.getGrid()->getPathfinder().getMoves(
+                _actor->getId(), origin.getIndex(), _actor->getMovePoints());
+        if (hover.getGrid() != origin.getGrid() || moves.getCost(hover.getIndex()) < 0) {
+            GameLogInfo << "Tile is out of move range" << endLog;
             return false;
         }
 
+        trace.setArg(3, 1);
         return true;
     }
 
-    GameLogInfo << "Could not lock tile" << endLog;
+    GameLogInfo << "Unit is not on a tile" << endLog;
     return false;
 }
 
@@ -44,6 +52,8 @@ void AMove::activate(shared_ptr<Unit> actor,
 {
     Ability::activate(actor, grid_input);
 
+    showMoves();
+
     auto input = Arya::Locator::getRoot().getInputSystem();
 
     keyBindings.push_back(input->bind("g", [this](bool down, const Arya::MousePos&) {
@@ -69,6 +79,33 @@ void AMove::activate(shared_ptr<Unit> actor,
 void AMove::deactivate()
 {
     keyBindings.clear();
+    hideMoves();
+}
+
+void AMove::showMoves()
+{
+    hideMoves();
+
+    auto origin = _actor->getTile();
+    if (!origin)
+        return;
+
+    _grid = origin.getGrid();
+    auto& moves = _grid->getPathfinder().getMoves(
+            _actor->getId(), origin.getIndex(), _actor->getMovePoints());
+    for (auto index : moves.tiles) {
+        if (index == origin.getIndex())
+            continue;
+        _grid->setFlag(index, tile_reachable, true);
+        _reachable.push_back(index);
+    }
+}
+
+void AMove::hideMoves()
+{
+    for (auto index : _reachable)
+        _grid->setFlag(index, tile_reachable, false);
+    _reachable.clear();
 }
 
 } // namespace Prismer
@@ -2,6 +2,7 @@
 
 #include "Game.h"
 #include "GameLogger.h"
+#include "GameTrace.h"
 #include "GameSessionClient.h"
 
 using namespace Arya;
@@ -17,15 +18,18 @@ Game::~Game()
 {
 }
 
-bool Game::init()
+bool Game::init(int boardWidth, int boardHeight)
 {
     root = new Arya::Root();
+    registerGameTraceEvents();
 
     if (!root->init("Prismer", 1024, 768, false)) {
         return false;
     }
 
     Arya::InputSystem* input = root->getInputSystem();
+    // hover and camera only need the motion once per frame
+    input->setCoalesceMotion(true);
 
     keyBinding = input->bind("shift+q", [this](bool down, const MousePos&) {
         if (down)
@@ -44,7 +48,7 @@ bool Game::init()
 
     session = make_shared<GameSessionClient>();
 
-    if (!session->init())
+    if (!session->init(boardWidth, boardHeight))
         return false;
 
     return true;
@@ -24,9 +24,9 @@ GameSession::~GameSession()
 {
 }
 
-void GameSession::init()
+void GameSession::init(int width, int height)
 {
-    _grid = make_shared<Grid>(10, 10);
+    _grid = make_shared<Grid>(width, height);
     _grid->init();
 
     // make factions
@@ -47,7 +47,8 @@ int GameSession::generateId() const
 
 shared_ptr<Unit> GameSession::createUnit(int x, int y)
 {
-    if (_grid->getTile(x, y)->getInfo()->hasUnit())
+    auto tile = _grid->getTile(x, y);
+    if (!tile || tile.hasUnit())
         return nullptr;
 
     auto id = generateId();
@@ -55,7 +56,7 @@ shared_ptr<Unit> GameSession::createUnit(int x, int y)
     shared_ptr<Unit> unit = make_shared<Triangle>(id,
             weak_ptr<Faction>(*_currentFactionIter),
             colors);
-    unit->setTile(_grid->getTile(x, y));
+    unit->setTile(tile);
     unitMap.insert(std::pair<int, shared_ptr<Unit>>(unit->getId(), unit));
 
     (*_currentFactionIter)->addUnit(unit);
@@ -68,6 +69,7 @@ void GameSession::startMatch()
     _turn = 1;
 
     _currentFactionIter = _factions.begin();
+    _grid->getPathfinder().clearCache();
     (*_currentFactionIter)->beginTurn();
 }
 
@@ -80,6 +82,8 @@ void GameSession::nextFaction()
         _currentFactionIter = _factions.begin();
     }
 
+    // move points are restored, cached move ranges are not valid anymore
+    _grid->getPathfinder().clearCache();
     (*_currentFactionIter)->beginTurn();
 }
 
@@ -91,6 +95,8 @@ void GameSession::destroyUnit(int id)
         GameLogWarning << "Trying to destroy non-existing unit id" << endLog;
         return;
     }
+    _grid->getVision().removeObserver(id);
+    _grid->getPathfinder().removeUnit(id);
     unitMap.erase(iter);
 }
 
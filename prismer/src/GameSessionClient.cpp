@@ -30,9 +30,9 @@ GameSessionClient::~GameSessionClient()
     GameLogInfo << "Game session ended" << endLog;
 }
 
-bool GameSessionClient::init()
+bool GameSessionClient::init(int width, int height)
 {
-    GameSession::init();
+    GameSession::init(width, height);
 
     _input = make_unique<GameSessionInput>(
             std::dynamic_pointer_cast<GameSessionClient>(
@@ -71,6 +71,8 @@ void GameSessionClient::update(float elapsedTime)
 
     _camera->update(elapsedTime);
 
+    updateFog();
+
     for(auto unitIter : getUnitMap())
     {
         auto unit = unitIter.second;
@@ -91,7 +93,7 @@ shared_ptr<Unit> GameSessionClient::createUnit(int x, int y)
     if (!unit)
         return unit;
 
-    GameLogInfo << "GameSessionClient::createUnit()" << endLog;
+    GameLogDebug << "GameSessionClient::createUnit()" << endLog;
     // also create a unit entity
     auto unitEntity = make_shared<TriangleEntity>(unit, _grid_entity);
     unit->setEntity(unitEntity);
@@ -101,6 +103,31 @@ shared_ptr<Unit> GameSessionClient::createUnit(int x, int y)
     return unit;
 }
 
+void GameSessionClient::updateFog()
+{
+    if (_currentFactionIter == _factions.end())
+        return;
+
+    auto& vision = _grid->getVision();
+    int faction = (*_currentFactionIter)->getId();
+
+    // all tiles when the turn goes to another faction,
+    // otherwise only those that changed
+    vision.takeChanges(faction, _fogChanges);
+    if (faction != _fogFaction) {
+        _fogFaction = faction;
+        _fogChanges.clear();
+        for (int index = 0; index < _grid->getTileCount(); ++index)
+            _fogChanges.push_back(index);
+    }
+
+    for (auto index : _fogChanges) {
+        bool visible = vision.isVisible(faction, index);
+        if (visible != _grid->hasFlag(index, tile_visible))
+            _grid->setFlag(index, tile_visible, visible);
+    }
+}
+
 void GameSessionClient::toggleFPS()
 {
     _interface->toggleFPS();
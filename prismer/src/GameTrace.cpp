@@ -0,0 +1,14 @@
+#include "GameTrace.h"
+
+namespace Prismer {
+
+void registerGameTraceEvents()
+{
+    Arya::tracer.registerEvent(TRACE_UNIT_MOVE, "unit move", "unit,x,y");
+    Arya::tracer.registerEvent(TRACE_TILE_HOVER, "tile hover", "x,y");
+    Arya::tracer.registerEvent(TRACE_MOVE_CHECK, "move check", "unit,x,y,valid");
+    Arya::tracer.registerEvent(TRACE_GATHER_CHECK, "gather check", "unit,x,y,valid");
+    Arya::tracer.registerEvent(TRACE_VISION_UPDATE, "vision update", "unit,x,y,tiles");
+}
+
+} // namespace Prismer
@@ -34,31 +34,13 @@ GridEntity::GridEntity(weak_ptr<Grid> grid)
     else
     {
         myShader->enableUniform(Arya::UNIFORM_MOVEMATRIX | Arya::UNIFORM_VPMATRIX | Arya::UNIFORM_TEXTURE);
-        myShader->addUniform4fv("customUniform", [this](Arya::ShaderUniformBase* b){
-                Arya::Entity* ent = dynamic_cast<Arya::Entity*>(b);
-                if (!ent)
-                    return vec4(1.0f, 0.0f, 0.0f, 1.0f);
-
-                TileEntity* t = static_cast<TileEntity*>(ent->getUserData());
-                if (!t)
-                    return vec4(1.0f, 0.0f, 0.0f, 1.0f);
-
-                shared_ptr<Tile> tile = t->getTile().lock();
-
-                if (!tile)
-                    return vec4(1.0f, 0.0f, 0.0f, 1.0f);
-
-                auto ans = vec4(0.0);
-                if (tile->getInfo()->isActive())
-                    ans += vec4(0.0f, 1.0f, 0.0f, 1.0f);
-                if (tile->getInfo()->isHovered())
-                    ans += vec4(0.5f, 0.5f, 0.5f, 1.0f);
-                if (tile->getInfo()->isVisible())
-                    ans += vec4(0.0f, 0.0f, 1.0f, 1.0f);
-
-                return ans;
-
-                });
+        // the color is written by TileEntity when the state of its tile changes
+        auto layout = make_shared<Arya::UniformLayout>();
+        layout->add("customUniform", Arya::UNIFORMTYPE_VEC4);
+        auto defaults = make_shared<Arya::UniformBlock>(layout);
+        defaults->setVec4(layout->getOffset("customUniform"), vec4(1.0f, 0.0f, 0.0f, 1.0f));
+        myShader->setUniformDefaults(defaults);
+        _tileUniforms = layout;
         activeTile->setShaderProgram(myShader);
     }
 }
@@ -67,20 +49,24 @@ void GridEntity::init()
 {
     shared_ptr<Grid> gridl = _grid.lock();
     if (gridl) {
-        for (auto& tile : gridl->getTiles())
+        tile_entities.reserve(gridl->getTileCount());
+        for (int index = 0; index < gridl->getTileCount(); ++index)
         {
-            // create tile graphic
-            auto t_ent = make_shared<TileEntity>(weak_ptr<Tile>(tile), 
+            // create tile graphic, linked to the tile by its index
+            auto t_ent = make_shared<TileEntity>(gridl->getTile(index),
                     weak_ptr<GridEntity>(shared_from_this()));
             tile_entities.push_back(t_ent);
-
-            // link tile graphic to tile
-            tile->setEntity(t_ent);
         }
     }
 }
 
-shared_ptr<Tile> GridEntity::worldToBoard(float x, float y)
+void GridEntity::updateTile(int index)
+{
+    if (index >= 0 && (unsigned int)index < tile_entities.size())
+        tile_entities[index]->update();
+}
+
+TileRef GridEntity::worldToBoard(float x, float y)
 {
     shared_ptr<Grid> l_grid = _grid.lock();
     if (l_grid) {
@@ -98,7 +84,7 @@ shared_ptr<Tile> GridEntity::worldToBoard(float x, float y)
 
         return l_grid->getTile((int)(xt + 0.5), (int)(yt + 0.5));
     }
-    return nullptr;
+    return TileRef();
 }
 
 vec2 GridEntity::boardToWorld(int x, int y)
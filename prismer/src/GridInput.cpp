@@ -3,6 +3,7 @@
 #include "Grid.h"
 #include "GridGraphics.h"
 #include "GameLogger.h"
+#include "GameTrace.h"
 #include "Tile.h"
 #include "Unit.h"
 
@@ -13,7 +14,7 @@ GridInput::GridInput(weak_ptr<Grid> grid)
 {
     auto l_grid = _grid.lock();
 
-    if (l_grid->getTiles().empty()) {
+    if (l_grid->getTileCount() == 0) {
         GameLogError << "GridInput() called with empty grid" << endLog;
     }
     else {
@@ -51,7 +52,7 @@ void GridInput::activate()
     keyBindings.push_back(input->bind("enter", [this](bool down, const Arya::MousePos&) {
             if (down) setActive(_hovered); return down; }));
     keyBindings.push_back(input->bind("v", [this](bool down, const Arya::MousePos&) {
-                if (down) toggleVisible(_hovered); return down; }));
+                if (down) toggleWalls(_hovered); return down; }));
 
     if (input->controllerEnabled()) {
         keyBindings.push_back(input->bindControllerButton("a", [this](bool down) {
@@ -64,15 +65,16 @@ void GridInput::activate()
     // mouse movement
     keyBindings.push_back(input->bindMouseMove(
             [this](const Arya::MousePos& position, int, int) { 
-                if(auto l_grid = _grid.lock()) {
-                    // which tile is hovered over:
-                    // world_x, world_y
-                    auto gr = Arya::Locator::getRoot().getGraphics();
-                    auto cam = gr->getCamera();
-                    vec3 worldpos = cam->intersectViewRay(vec2(position.nX, position.nY), vec4(0.0f, 0.0f, 1.0f, 0.0f));
-
-                    setHovered(l_grid->getEntity()->worldToBoard(worldpos.x, worldpos.y));
-                }
+                hoverAt(position);
+                return false;
+            }, Arya::CHAIN_LAST
+            ));
+
+    // the camera may have moved after the mouse events were handled,
+    // so look again right before drawing
+    keyBindings.push_back(input->bindMouseLatch(
+            [this](const Arya::MousePos& position) {
+                hoverAt(position);
                 return false;
             }, Arya::CHAIN_LAST
             ));
@@ -94,14 +96,14 @@ void GridInput::deactivate()
     keyBindings.clear();
 }
 
-void GridInput::setActive(shared_ptr<Tile> tile) {
+void GridInput::setActive(TileRef tile) {
     if (tile) {
-        if (!tile->getInfo()->hasUnit()) {
+        if (!tile.hasUnit()) {
             GameLogInfo << "Trying to select tile without a unit." << endLog;
             return;
         }
 
-        auto unit = tile->getInfo()->getUnit();
+        auto unit = tile.getUnit();
 
         if (!unit->isActivatable()) {
             // FIXME: if the current faction is not a human player then this may not be sufficient
@@ -111,45 +113,70 @@ void GridInput::setActive(shared_ptr<Tile> tile) {
     }
 
     if (_active) {
-        _active->setActive(false);
-        if (_active->getInfo()->hasUnit()) {
-            _active->getInfo()->getUnit()->deactivate();
+        _active.setActive(false);
+        if (_active.hasUnit()) {
+            _active.getUnit()->deactivate();
         }
     }
 
     _active = tile;
 
     if (tile) {
-        _active->setActive(true);
-        tile->getInfo()->getUnit()->activate(shared_from_this());
+        _active.setActive(true);
+        tile.getUnit()->activate(shared_from_this());
     }
 }
 
-void GridInput::toggleVisible(shared_ptr<Tile> tile)
+void GridInput::toggleWalls(TileRef tile)
 {
     if (!tile)
     {
         return;
     }
-    tile->setVisible(!tile->getInfo()->isVisible());
+    // walls all around, or none when there were any
+    auto grid = tile.getGrid();
+    bool wall = grid->getWalls(tile.getIndex()) == 0;
+    for (int dir = 0; dir < 6; ++dir)
+        grid->setWall(tile.getIndex(), (TileDirection)dir, wall);
+}
+
+void GridInput::hoverAt(const Arya::MousePos& position) {
+    auto l_grid = _grid.lock();
+    if (!l_grid)
+        return;
+
+    // which tile is hovered over:
+    // world_x, world_y
+    auto gr = Arya::Locator::getRoot().getGraphics();
+    auto cam = gr->getCamera();
+    vec3 worldpos = cam->intersectViewRay(vec2(position.nX, position.nY), vec4(0.0f, 0.0f, 1.0f, 0.0f));
+
+    // only when the tile under the cursor changes, so that the
+    // keyboard can move the hover while the mouse stands still
+    auto tile = l_grid->getEntity()->worldToBoard(worldpos.x, worldpos.y);
+    if (tile == _under_cursor)
+        return;
+    _under_cursor = tile;
+    setHovered(tile);
 }
 
-void GridInput::setHovered(shared_ptr<Tile> tile) {
+void GridInput::setHovered(TileRef tile) {
     if (!tile)
         return;
 
     if (_hovered)
-        _hovered->setHovered(false);
+        _hovered.setHovered(false);
 
+    Arya::traceEvent(TRACE_TILE_HOVER, tile.getX(), tile.getY());
     _hovered = tile;
-    _hovered->setHovered(true);
+    _hovered.setHovered(true);
 }
 
 void GridInput::setHovered(TileDirection dir) {
     if (!_hovered)
         return;
 
-    auto nb = _hovered->getNeighbor(dir);
+    auto nb = _hovered.getNeighbor(dir);
     if (nb)
         setHovered(nb);
 }
@@ -0,0 +1,237 @@
+#include <algorithm>
+
+#include "Pathfinder.h"
+#include "Grid.h"
+
+namespace Prismer {
+
+int MoveRange::getCost(int index) const
+{
+    auto it = std::lower_bound(tiles.begin(), tiles.end(), index);
+    if (it == tiles.end() || *it != index)
+        return -1;
+    return costs[it - tiles.begin()];
+}
+
+void Pathfinder::BucketQueue::clear(int lowest)
+{
+    for (auto& bucket : _buckets)
+        bucket.clear();
+    _current = lowest;
+    _size = 0;
+}
+
+int Pathfinder::BucketQueue::pop(int& priority)
+{
+    while (_buckets[_current & (bucketCount - 1)].empty())
+        _current++;
+
+    auto& bucket = _buckets[_current & (bucketCount - 1)];
+    int index = bucket.back();
+    bucket.pop_back();
+    _size--;
+
+    priority = _current;
+    return index;
+}
+
+Pathfinder::Pathfinder(Grid& grid)
+    : _grid(grid)
+{
+    static_assert(Grid::maxMoveCost + 2 <= BucketQueue::bucketCount,
+            "move costs must fit in the bucket queue");
+
+    for (int dir = 0; dir < 6; ++dir) {
+        _neighborDelta[dir] = Grid::neighborOffsets[dir][0] * _grid.getHeight()
+            + Grid::neighborOffsets[dir][1];
+    }
+}
+
+void Pathfinder::beginQuery()
+{
+    // the buffers grow once, to the size of the grid
+    size_t count = _grid.getTileCount();
+    if (_stamp.size() != count) {
+        _stamp.assign(count, 0);
+        _exploredStamp.assign(count, 0);
+        _cost.assign(count, 0);
+        _from.assign(count, -1);
+        _query = 0;
+    }
+
+    if (++_query == 0) {
+        std::fill(_stamp.begin(), _stamp.end(), 0);
+        std::fill(_exploredStamp.begin(), _exploredStamp.end(), 0);
+        _query = 1;
+    }
+}
+
+bool Pathfinder::canEnter(int index) const
+{
+    return _grid.getMoveCost(index) != 0 && !_grid.hasUnit(index);
+}
+
+const MoveRange& Pathfinder::getMoves(int key, int origin, int movePoints)
+{
+    // the vectors of an old range are reused
+    auto& range = _ranges[key];
+    if (range.valid && range.origin == origin && range.movePoints == movePoints)
+        return range;
+
+    range.origin = origin;
+    range.movePoints = movePoints;
+    flood(range);
+    range.valid = true;
+    return range;
+}
+
+void Pathfinder::flood(MoveRange& range)
+{
+    range.tiles.clear();
+    range.costs.clear();
+    range.explored.clear();
+
+    if (range.origin < 0 || range.origin >= _grid.getTileCount())
+        return;
+
+    beginQuery();
+
+    setCost(range.origin, 0, -1);
+    _exploredStamp[range.origin] = _query;
+    _queue.clear(0);
+    _queue.push(range.origin, 0);
+
+    while (!_queue.empty()) {
+        int cost;
+        int index = _queue.pop(cost);
+        if (cost != _cost[index])
+            continue;
+
+        range.tiles.push_back(index);
+        range.explored.push_back(index);
+
+        int x = _grid.getX(index);
+        int y = _grid.getY(index);
+        int walls = _grid.getWalls(index);
+        for (int dir = 0; dir < 6; ++dir) {
+            if (!_grid.contains(x + Grid::neighborOffsets[dir][0],
+                        y + Grid::neighborOffsets[dir][1]))
+                continue;
+            int neighbor = index + _neighborDelta[dir];
+
+            // tiles that can not be entered now are in explored as well,
+            // they change the range when they become free or cheaper
+            bool open = !(walls & (1 << dir)) && canEnter(neighbor);
+            int next = open ? cost + _grid.getMoveCost(neighbor) : INT_MAX;
+            if (next > range.movePoints) {
+                if (_exploredStamp[neighbor] != _query) {
+                    _exploredStamp[neighbor] = _query;
+                    range.explored.push_back(neighbor);
+                }
+                continue;
+            }
+
+            if (!seen(neighbor) || next < _cost[neighbor]) {
+                setCost(neighbor, next, index);
+                _queue.push(neighbor, next);
+            }
+        }
+    }
+
+    // reachable tiles were added to explored when they were reached
+    // and once more if they were also seen out of range before
+    std::sort(range.explored.begin(), range.explored.end());
+    range.explored.erase(std::unique(range.explored.begin(), range.explored.end()),
+            range.explored.end());
+
+    std::sort(range.tiles.begin(), range.tiles.end());
+    for (auto index : range.tiles)
+        range.costs.push_back(_cost[index]);
+}
+
+int Pathfinder::findPath(int start, int goal, vector<int>& path, int maxCost)
+{
+    path.clear();
+
+    int count = _grid.getTileCount();
+    if (start < 0 || goal < 0 || start >= count || goal >= count)
+        return -1;
+    if (start == goal)
+        return 0;
+    if (!canEnter(goal))
+        return -1;
+
+    beginQuery();
+
+    int goalX = _grid.getX(goal);
+    int goalY = _grid.getY(goal);
+
+    // the cheapest tile costs 1, so the hex distance is a consistent
+    // heuristic and a tile is final when it is popped
+    int estimate = Grid::distance(_grid.getX(start), _grid.getY(start), goalX, goalY);
+    setCost(start, 0, -1);
+    _queue.clear(estimate);
+    _queue.push(start, estimate);
+
+    while (!_queue.empty()) {
+        int priority;
+        int index = _queue.pop(priority);
+
+        int x = _grid.getX(index);
+        int y = _grid.getY(index);
+        int cost = _cost[index];
+        if (priority != cost + Grid::distance(x, y, goalX, goalY))
+            continue;
+
+        if (index == goal) {
+            for (int tile = goal; tile != start; tile = _from[tile])
+                path.push_back(tile);
+            std::reverse(path.begin(), path.end());
+            return cost;
+        }
+
+        int walls = _grid.getWalls(index);
+        for (int dir = 0; dir < 6; ++dir) {
+            int nx = x + Grid::neighborOffsets[dir][0];
+            int ny = y + Grid::neighborOffsets[dir][1];
+            if (!_grid.contains(nx, ny) || (walls & (1 << dir)))
+                continue;
+            int neighbor = index + _neighborDelta[dir];
+            if (!canEnter(neighbor))
+                continue;
+
+            int next = cost + _grid.getMoveCost(neighbor);
+            if (next > maxCost)
+                continue;
+
+            if (!seen(neighbor) || next < _cost[neighbor]) {
+                setCost(neighbor, next, index);
+                _queue.push(neighbor, next + Grid::distance(nx, ny, goalX, goalY));
+            }
+        }
+    }
+
+    return -1;
+}
+
+void Pathfinder::tileChanged(int index)
+{
+    for (auto& entry : _ranges) {
+        auto& range = entry.second;
+        if (range.valid && std::binary_search(range.explored.begin(), range.explored.end(), index))
+            range.valid = false;
+    }
+}
+
+void Pathfinder::clearCache()
+{
+    for (auto& entry : _ranges)
+        entry.second.valid = false;
+}
+
+void Pathfinder::removeUnit(int key)
+{
+    _ranges.erase(key);
+}
+
+} // namespace Prismer
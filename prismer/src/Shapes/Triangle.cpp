@@ -19,9 +19,9 @@ Triangle::Triangle(int id,
 
     _mp = 5;
 
-    GameLogInfo << "Triangle() -- colors:" << endLog;
+    GameLogDebug << "Triangle() -- colors:" << endLog;
     for (auto& color_bag : colors) {
-        GameLogInfo << "(" << color_bag << ")" << endLog;
+        GameLogDebug << "(" << color_bag << ")" << endLog;
     }
 }
 
@@ -1,50 +1,73 @@
 #include "Tile.h"
-#include "TileGraphics.h"
 #include "Grid.h"
 #include "Unit.h"
 
 namespace Prismer
 {
 
-Tile::Tile(int x, int y, weak_ptr<Grid> grid)
-    : _x(x), _y(y), _grid(grid)
+TileRef TileRef::getNeighbor(TileDirection dir) const
 {
-    _info = make_shared<TileInfo>();
+    if (!_grid)
+        return TileRef();
+
+    return _grid->getNeighbor(_x, _y, dir);
 }
 
-void Tile::setActive(bool active) {
-    _info->_active = active;
+int TileRef::distance(const TileRef& tile) const
+{
+    return Grid::distance(_x, _y, tile.getX(), tile.getY());
+}
 
-    _entity->update();
+bool TileRef::isActive() const {
+    return _grid->hasFlag(_index, tile_active);
 }
 
-void Tile::setHovered(bool hovered) {
-    _info->_hovered = hovered;
-    _entity->update();
+bool TileRef::isHovered() const {
+    return _grid->hasFlag(_index, tile_hovered);
 }
 
-void Tile::setVisible(bool visible) {
-    _info->_visible = visible;
-    _entity->update();
+bool TileRef::isVisible() const {
+    return _grid->hasFlag(_index, tile_visible);
 }
 
-shared_ptr<Tile> Tile::getNeighbor(TileDirection dir)
-{
-    if (_grid.expired())
-        return nullptr;
+bool TileRef::isReachable() const {
+    return _grid->hasFlag(_index, tile_reachable);
+}
 
-    auto l_grid = _grid.lock();
-    return l_grid->getNeighbor(_x, _y, dir);
+void TileRef::setActive(bool active) const {
+    _grid->setFlag(_index, tile_active, active);
 }
 
-int Tile::distance(shared_ptr<Tile> tile)
-{
-    if(auto l_grid = _grid.lock())  {
-        return l_grid->distance(_x, _y, tile->getX(), tile->getY());
-    } else {
-        return 0;
-    }
+void TileRef::setHovered(bool hovered) const {
+    _grid->setFlag(_index, tile_hovered, hovered);
+}
+
+void TileRef::setVisible(bool visible) const {
+    _grid->setFlag(_index, tile_visible, visible);
+}
+
+void TileRef::setReachable(bool reachable) const {
+    _grid->setFlag(_index, tile_reachable, reachable);
 }
 
+bool TileRef::hasResource() const {
+    return !_grid->getResources(_index).empty();
+}
+
+ColorID TileRef::popResource() const {
+    return _grid->popResource(_index);
+}
+
+bool TileRef::hasUnit() const {
+    return _grid->hasUnit(_index);
+}
+
+shared_ptr<Unit> TileRef::getUnit() const {
+    return _grid->getUnit(_index);
+}
+
+void TileRef::setUnit(shared_ptr<Unit> unit) const {
+    _grid->setUnit(_index, unit);
+}
 
 } // namespace Prismer
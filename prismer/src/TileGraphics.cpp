@@ -7,39 +7,60 @@
 
 namespace Prismer {
 
-TileEntity::TileEntity(weak_ptr<Tile> tile,
+TileEntity::TileEntity(TileRef tile,
         weak_ptr<GridEntity> grid_entity)
     : _tile(tile), _grid_entity(grid_entity)
 {
     auto l_grid = _grid_entity.lock();
-    auto l_tile = _tile.lock();
 
     _entity = Arya::Entity::create();
-    _entity->setPosition(vec3(l_grid->boardToWorld(l_tile->getX(), l_tile->getY()), 0.0f));
+    _entity->setPosition(vec3(l_grid->boardToWorld(_tile.getX(), _tile.getY()), 0.0f));
     _entity->setYaw(M_PI / 6);
     _entity->setGraphics(l_grid->getBaseTile());
     _entity->getGraphics()->setScale(0.95f * l_grid->getScale());
     _entity->setUserData(this);
+
+    if (auto layout = l_grid->getTileUniforms()) {
+        _entity->setUniformBlock(std::unique_ptr<Arya::UniformBlock>(new Arya::UniformBlock(layout)));
+        _colorField = layout->getOffset("customUniform");
+    }
 }
 
 void TileEntity::update()
 {
     // FIXME: error
-    if (_tile.expired() || _grid_entity.expired())
+    if (!_tile || _grid_entity.expired())
         return;
 
-    auto l_tile = _tile.lock();
     auto l_grid = _grid_entity.lock();
 
-    // depending on state setGraphics:
-    if (l_tile->getInfo()->isActive() ||
-            l_tile->getInfo()->isHovered()) {
+    // color of the active tile shader
+    if (Arya::UniformBlock* block = _entity->getUniformBlock()) {
+        auto color = vec4(0.0);
+        if (_tile.isActive())
+            color += vec4(0.0f, 1.0f, 0.0f, 1.0f);
+        if (_tile.isHovered())
+            color += vec4(0.5f, 0.5f, 0.5f, 1.0f);
+        if (_tile.isVisible())
+            color += vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        if (_tile.isReachable())
+            color += vec4(0.0f, 0.3f, 0.3f, 1.0f);
+        block->setVec4(_colorField, color);
+    }
+
+    // depending on state setGraphics, only when the state changed
+    bool highlighted = _tile.isActive() ||
+            _tile.isHovered() || _tile.isReachable();
+    if (highlighted == _highlighted)
+        return;
+    _highlighted = highlighted;
+
+    // this reuses the graphics component of the entity
+    if (highlighted)
         _entity->setGraphics(l_grid->getActiveTile());
-        _entity->getGraphics()->setScale(0.95f * l_grid->getScale());
-    } else {
+    else
         _entity->setGraphics(l_grid->getBaseTile());
-        _entity->getGraphics()->setScale(0.95f * l_grid->getScale());
-    }
+    _entity->getGraphics()->setScale(0.95f * l_grid->getScale());
 }
 
 } // namespace Prismer
@@ -1,5 +1,7 @@
 #include "Colors.h"
 #include "Faction.h"
+#include "GameTrace.h"
+#include "Grid.h"
 #include "Tile.h"
 #include "Unit.h"
 #include "UnitGraphics.h"
@@ -18,17 +20,23 @@ void Unit::update(float dt, float t)
         _entity->update(dt, t);
 }
 
-void Unit::setTile(shared_ptr<Tile> tile)
+void Unit::setTile(TileRef tile)
 {
-    _x = tile->getX();
-    _y = tile->getY();
+    _x = tile.getX();
+    _y = tile.getY();
+    Arya::traceEvent(TRACE_UNIT_MOVE, _id, _x, _y);
 
-    if (auto l_tile = _tile.lock())
-        l_tile->getInfo()->setUnit(nullptr);
+    if (_tile)
+        _tile.setUnit(nullptr);
 
     _tile = tile;
 
-    tile->getInfo()->setUnit(shared_from_this());
+    tile.setUnit(shared_from_this());
+
+    if (auto faction = _faction.lock()) {
+        tile.getGrid()->getVision().setObserver(_id, faction->getId(),
+                tile.getIndex(), _visionRange);
+    }
 
     if (_entity) 
         _entity->updateState();
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Vision.h"
+#include "Grid.h"
+#include "GameTrace.h"
+
+namespace Prismer {
+
+static const float pi = 3.14159265f;
+
+// angles of a shadow that are this close to its ends are not in it, so
+// that a line along a wall or past the end of a wall is not blocked. A
+// line between two walls whose ends line up exactly is blocked.
+static const float shadowMargin = 1e-4f;
+
+// Positions on the board as in GridEntity::boardToWorld, with a distance
+// of sqrt(3) between neighbors and corners at a distance of 1.
+static void tileCenter(int dx, int dy, float& x, float& y)
+{
+    x = 0.5f * std::sqrt(3.0f) * (dx - dy);
+    y = 1.5f * (dx + dy);
+}
+
+// direction of the edge to the neighbor, in the order of TileDirection
+static const float edgeAngles[6] = {
+    pi,                 // left
+    2.0f * pi / 3.0f,   // top_left
+    pi / 3.0f,          // top_right
+    0.0f,               // right
+    -pi / 3.0f,         // bottom_right
+    -2.0f * pi / 3.0f   // bottom_left
+};
+
+Vision::Vision(Grid& grid)
+    : _grid(grid)
+{ }
+
+Vision::FactionVision& Vision::getFaction(int faction)
+{
+    auto& vision = _factions[faction];
+    size_t count = _grid.getTileCount();
+    if (vision.counts.size() != count) {
+        vision.counts.assign(count, 0);
+        vision.bits.assign((count + 63) / 64, 0);
+    }
+    return vision;
+}
+
+void Vision::setObserver(int id, int faction, int origin, int range)
+{
+    auto& observer = _observers[id];
+    if (observer.faction == faction && observer.origin == origin
+            && observer.range == range && observer.origin >= 0)
+        return;
+
+    // a unit that changes sides stops seeing for the old faction
+    if (observer.faction != faction && !observer.visible.empty()) {
+        auto& old = getFaction(observer.faction);
+        for (auto index : observer.visible)
+            see(old, index, -1);
+        observer.visible.clear();
+    }
+
+    observer.faction = faction;
+    observer.origin = origin;
+    observer.range = range;
+    update(observer, id);
+}
+
+void Vision::removeObserver(int id)
+{
+    auto it = _observers.find(id);
+    if (it == _observers.end())
+        return;
+
+    auto& faction = getFaction(it->second.faction);
+    for (auto index : it->second.visible)
+        see(faction, index, -1);
+    _observers.erase(it);
+}
+
+bool Vision::isVisible(int faction, int index) const
+{
+    auto it = _factions.find(faction);
+    if (it == _factions.end() || it->second.bits.empty())
+        return false;
+    return (it->second.bits[index >> 6] >> (index & 63)) & 1;
+}
+
+const vector<uint64_t>& Vision::getVisibleBits(int faction) const
+{
+    static const vector<uint64_t> none;
+    auto it = _factions.find(faction);
+    return it == _factions.end() ? none : it->second.bits;
+}
+
+void Vision::takeChanges(int faction, vector<int>& changed)
+{
+    changed.clear();
+    auto it = _factions.find(faction);
+    if (it != _factions.end())
+        changed.swap(it->second.changed);
+}
+
+void Vision::wallChanged(int index, int neighbor)
+{
+    int x = _grid.getX(index);
+    int y = _grid.getY(index);
+    int nx = neighbor >= 0 ? _grid.getX(neighbor) : x;
+    int ny = neighbor >= 0 ? _grid.getY(neighbor) : y;
+
+    for (auto& entry : _observers) {
+        auto& observer = entry.second;
+        int ox = _grid.getX(observer.origin);
+        int oy = _grid.getY(observer.origin);
+        if (Grid::distance(ox, oy, x, y) <= observer.range
+                || Grid::distance(ox, oy, nx, ny) <= observer.range)
+            update(observer, entry.first);
+    }
+}
+
+void Vision::update(Observer& observer, int id)
+{
+    Arya::TraceScope trace(TRACE_VISION_UPDATE, id,
+            _grid.getX(observer.origin), _grid.getY(observer.origin));
+
+    computeVisible(observer.origin, observer.range, _visible);
+    trace.setArg(3, (int)_visible.size());
+
+    // new first, so that tiles that stay visible do not change
+    auto& faction = getFaction(observer.faction);
+    for (auto index : _visible)
+        see(faction, index, 1);
+    for (auto index : observer.visible)
+        see(faction, index, -1);
+
+    observer.visible.swap(_visible);
+}
+
+void Vision::see(FactionVision& faction, int index, int amount)
+{
+    auto& count = faction.counts[index];
+    count += amount;
+
+    if (amount > 0 && count == amount) {
+        faction.bits[index >> 6] |= (uint64_t)1 << (index & 63);
+        faction.changed.push_back(index);
+    } else if (amount < 0 && count == 0) {
+        faction.bits[index >> 6] &= ~((uint64_t)1 << (index & 63));
+        faction.changed.push_back(index);
+    }
+}
+
+void Vision::computeVisible(int origin, int range, vector<int>& visible)
+{
+    visible.clear();
+    _shadows.clear();
+    if (origin < 0 || origin >= _grid.getTileCount())
+        return;
+
+    visible.push_back(origin);
+
+    int ox = _grid.getX(origin);
+    int oy = _grid.getY(origin);
+    addWallShadows(origin, 0, 0);
+    mergeShadows();
+
+    for (int r = 1; r <= range; ++r) {
+        // everything is behind walls
+        if (!_shadows.empty() && _shadows.front().begin <= -pi
+                && _shadows.front().end >= pi)
+            break;
+
+        // walk the ring: start r tiles to the left, and go r tiles
+        // in each direction, starting with top_right
+        _ring.clear();
+        int x = ox + r * Grid::neighborOffsets[TileDirection::left][0];
+        int y = oy + r * Grid::neighborOffsets[TileDirection::left][1];
+        for (int side = 0; side < 6; ++side) {
+            int dir = (side + TileDirection::top_right) % 6;
+            for (int step = 0; step < r; ++step) {
+                if (_grid.contains(x, y)) {
+                    int index = _grid.getIndex(x, y);
+                    float cx, cy;
+                    tileCenter(x - ox, y - oy, cx, cy);
+                    if (!inShadow(std::atan2(cy, cx)))
+                        visible.push_back(index);
+                    _ring.push_back(index);
+                }
+                x += Grid::neighborOffsets[dir][0];
+                y += Grid::neighborOffsets[dir][1];
+            }
+        }
+
+        // the walls of this ring only block the rings after it
+        bool walls = false;
+        for (auto index : _ring) {
+            if (_grid.getWalls(index)) {
+                addWallShadows(index, _grid.getX(index) - ox, _grid.getY(index) - oy);
+                walls = true;
+            }
+        }
+        if (walls)
+            mergeShadows();
+    }
+}
+
+void Vision::addWallShadows(int index, int dx, int dy)
+{
+    int walls = _grid.getWalls(index);
+    if (!walls)
+        return;
+
+    float cx, cy;
+    tileCenter(dx, dy, cx, cy);
+    for (int dir = 0; dir < 6; ++dir) {
+        if (!(walls & (1 << dir)))
+            continue;
+        // the corners of the edge are 30 degrees to both sides
+        float a = edgeAngles[dir] - pi / 6.0f;
+        float b = edgeAngles[dir] + pi / 6.0f;
+        addShadow(std::atan2(cy + std::sin(a), cx + std::cos(a)),
+                std::atan2(cy + std::sin(b), cx + std::cos(b)));
+    }
+}
+
+void Vision::addShadow(float a, float b)
+{
+    // the smaller angle between the corners, the wall does
+    // not go around the observer
+    float d = b - a;
+    if (d > pi)
+        d -= 2.0f * pi;
+    else if (d < -pi)
+        d += 2.0f * pi;
+    if (d == 0.0f)
+        return;
+
+    float begin = d > 0.0f ? a : a + d;
+    float end = begin + std::fabs(d);
+
+    // a shadow over the angle pi is split in two, which go on past pi so
+    // that lines at exactly pi are not at the margin of either
+    if (begin < -pi) {
+        _shadows.push_back({ begin + 2.0f * pi, pi + 1.0f });
+        _shadows.push_back({ -pi - 1.0f, end });
+    } else if (end > pi) {
+        _shadows.push_back({ begin, pi + 1.0f });
+        _shadows.push_back({ -pi - 1.0f, end - 2.0f * pi });
+    } else {
+        _shadows.push_back({ begin, end });
+    }
+}
+
+void Vision::mergeShadows()
+{
+    if (_shadows.empty())
+        return;
+
+    std::sort(_shadows.begin(), _shadows.end(),
+            [](const Shadow& a, const Shadow& b) { return a.begin < b.begin; });
+
+    // walls that touch at a corner leave no gap between them
+    size_t last = 0;
+    for (size_t i = 1; i < _shadows.size(); ++i) {
+        if (_shadows[i].begin <= _shadows[last].end + shadowMargin)
+            _shadows[last].end = std::max(_shadows[last].end, _shadows[i].end);
+        else
+            _shadows[++last] = _shadows[i];
+    }
+    _shadows.resize(last + 1);
+}
+
+bool Vision::inShadow(float angle) const
+{
+    // the last shadow that begins before the angle
+    auto it = std::upper_bound(_shadows.begin(), _shadows.end(), angle,
+            [](float a, const Shadow& shadow) { return a < shadow.begin; });
+    if (it == _shadows.begin())
+        return false;
+    --it;
+    return angle > it->begin + shadowMargin && angle < it->end - shadowMargin;
+}
+
+} // namespace Prismer
@@ -1,12 +1,48 @@
 #include "Game.h"
+#include <string>
+#include <cstdio>
 
-int main()
+int main(int argc, char* argv[])
 {
     Prismer::Game game;
 
-    if(!game.init()) {
+    // --board WxH               size of the board, 10x10 by default
+    // --record file             records the input of this session
+    // --replay file [--fast] [--hidden]
+    //                           plays a recorded session back and quits
+    std::string record, replay;
+    bool fast = false, hidden = false;
+    int boardWidth = 10, boardHeight = 10;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--board" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &boardWidth, &boardHeight) != 2
+                    || boardWidth <= 0 || boardHeight <= 0) {
+                fprintf(stderr, "Invalid board size %s, expected WxH\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (arg == "--record" && i + 1 < argc)
+            record = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replay = argv[++i];
+        else if (arg == "--fast")
+            fast = true;
+        else if (arg == "--hidden")
+            hidden = true;
+    }
+
+    if(!game.init(boardWidth, boardHeight)) {
+        return -1;
+    }
+
+    Arya::Root& root = Arya::Locator::getRoot();
+    if (!replay.empty() && !root.startReplay(replay, fast, hidden)) {
         return -1;
     }
+    if (!record.empty()) {
+        root.startRecording(record);
+    }
 
     game.run();
 
@@ -0,0 +1,13 @@
+// Lighting shared by the model shaders
+
+const vec3 lightDirection = vec3(0.7, 0.7, 0.0);//MUST BE REPLACED
+
+//material: specAmp, specPow, ambient, diffuse
+float specular(vec3 norm, vec3 pos, vec4 material, mat4 viewMatrix)
+{
+	if(material[0] <= 0.001) return 0.0;
+	vec4 camNormal=normalize(viewMatrix*vec4(norm,0.0));
+	vec4 camLight=normalize(viewMatrix*vec4(lightDirection,0.0));
+	vec4 camReflection=2.0*camNormal*dot(camLight,camNormal)-camLight;
+	return max(dot(camReflection,-1.0*normalize(viewMatrix*vec4(pos,0.0))),0);
+}
@@ -1,9 +1,36 @@
 #version 330
 #extension GL_ARB_explicit_attrib_location : require
 
+// Features, see model.vert:
+// TINT     replace magenta texels by tintColor
+// FOG      blend to fogColor between the view depths in fogRange
+
+#ifdef SHADOW_ONLY
+
+void main()
+{
+}
+
+#else
+
+#include "common/lighting.glsl"
+
 uniform sampler2D tex;
 uniform vec4 material;//specAmp, specPow, ambient, diffuse
+
+#ifdef TINT
+#ifdef INSTANCED
+flat in vec3 tintColor;
+#else
 uniform vec3 tintColor;
+#endif
+#endif
+
+#ifdef FOG
+uniform vec3 fogColor;
+uniform vec2 fogRange;//start, end
+in float viewDepth;
+#endif
 
 in vec2 texCoo;
 in vec3 normal;
@@ -13,14 +40,19 @@ layout (location = 0) out vec4 fragColor;
 
 void main()
 {
-	vec3 lightDirection=vec3(0.7,0.7,0.0);//MUST BE REPLACED
-
 	float lightFraction = max(0.0,dot(normalize(normal), lightDirection));
 	fragColor = texture(tex, texCoo);
+#ifdef TINT
 	if(fragColor.xyz == vec3(1.0, 0.0, 1.0))
         fragColor.xyz = tintColor;
+#endif
 	fragColor.xyz *= max(lightFraction*material.w, material.z);
 	fragColor.xyz += material.x*vec3(pow(spec,material.y));
 	fragColor.xyz += vec3(0.10);
+#ifdef FOG
+    fragColor.xyz = mix(fragColor.xyz, fogColor, smoothstep(fogRange.x, fogRange.y, viewDepth));
+#endif
 	fragColor.a=1.0;
 }
+
+#endif
@@ -0,0 +1,117 @@
+#version 330
+#extension GL_ARB_explicit_attrib_location : require
+
+// Animated models, with the features of ShaderVariants:
+// ANIMATED         interpolate between two frames
+// FRAME_TEXTURE    read the frames from frameData instead of vertex attributes
+// INSTANCED        matrix, frames and uniforms per instance, implies FRAME_TEXTURE
+// SHADOW_ONLY      only the position
+// TINT, FOG        see model.frag
+
+#if defined(INSTANCED) && !defined(FRAME_TEXTURE)
+#define FRAME_TEXTURE
+#endif
+#if defined(FRAME_TEXTURE) && !defined(ANIMATED)
+#define ANIMATED
+#endif
+
+#include "common/lighting.glsl"
+
+layout (location = 1) in vec2 texCooIn;
+
+#ifdef FRAME_TEXTURE
+uniform int vertexCount;
+uniform samplerBuffer frameData;//two texels per vertex per frame: position, normal
+#else
+layout (location = 0) in vec3 position;
+layout (location = 2) in vec3 normalIn;
+#ifdef ANIMATED
+layout (location = 3) in vec3 posNext;
+layout (location = 4) in vec3 normalNext;
+#endif
+#endif
+
+#ifdef INSTANCED
+layout (location = 5) in mat4 instanceMatrix;//locations 5 to 8
+layout (location = 9) in vec4 instanceAnim;//current frame, next frame, interpolation
+#else
+uniform mat4 mMatrix;
+#ifdef ANIMATED
+uniform float interpolation;
+#endif
+#ifdef FRAME_TEXTURE
+uniform ivec2 animFrames;//current frame, next frame
+#endif
+#endif
+
+uniform mat4 viewMatrix;
+uniform mat4 vpMatrix;
+uniform vec4 material;//specAmp, specPow, ambient, diffuse
+
+#ifndef SHADOW_ONLY
+out vec2 texCoo;
+out vec3 normal;
+out float spec;
+#ifdef FOG
+out float viewDepth;
+#endif
+#if defined(INSTANCED) && defined(TINT)
+flat out vec3 tintColor;
+
+//Must match the UniformLayout of the uniform defaults of the shader
+struct InstanceData
+{
+    vec3 tintColor;
+};
+layout (std140) uniform InstanceUniforms
+{
+    InstanceData instances[256];
+};
+#endif
+#endif
+
+void main()
+{
+#ifdef INSTANCED
+    mat4 modelMatrix = instanceMatrix;
+    int curFrame = int(instanceAnim.x + 0.5);
+    int nextFrame = int(instanceAnim.y + 0.5);
+    float t = instanceAnim.z;
+#else
+    mat4 modelMatrix = mMatrix;
+#ifdef FRAME_TEXTURE
+    int curFrame = animFrames.x;
+    int nextFrame = animFrames.y;
+#endif
+#ifdef ANIMATED
+    float t = interpolation;
+#endif
+#endif
+
+#if defined(FRAME_TEXTURE)
+    int cur = 2*(curFrame*vertexCount + gl_VertexID);
+    int next = 2*(nextFrame*vertexCount + gl_VertexID);
+    vec3 pos = mix(texelFetch(frameData, cur).xyz, texelFetch(frameData, next).xyz, t);
+    vec3 norm = mix(texelFetch(frameData, cur+1).xyz, texelFetch(frameData, next+1).xyz, t);
+#elif defined(ANIMATED)
+    vec3 pos = mix(position, posNext, t);
+    vec3 norm = mix(normalIn, normalNext, t);
+#else
+    vec3 pos = position;
+    vec3 norm = normalIn;
+#endif
+
+    gl_Position = vpMatrix * modelMatrix * vec4(pos,1.0);
+
+#ifndef SHADOW_ONLY
+    texCoo = texCooIn;
+	normal = normalize((modelMatrix*vec4(norm, 0.0)).xyz);
+    spec = specular(normal, pos, material, viewMatrix);
+#ifdef FOG
+    viewDepth = -(viewMatrix * modelMatrix * vec4(pos,1.0)).z;
+#endif
+#if defined(INSTANCED) && defined(TINT)
+    tintColor = instances[gl_InstanceID].tintColor;
+#endif
+#endif
+}
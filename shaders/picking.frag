@@ -0,0 +1,11 @@
+#version 330
+#extension GL_ARB_explicit_attrib_location : require
+
+uniform uint entityId;
+
+layout (location = 0) out uint fragId;
+
+void main()
+{
+    fragId = entityId;
+}
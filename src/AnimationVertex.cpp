@@ -1,86 +1,271 @@
 #include "AnimationVertex.h"
+#include "Jobs.h"
+#include "Locator.h"
+#include "World.h"
 #include "common/Logger.h"
 
 namespace Arya
 {
     using std::make_unique;
-    
+    using std::make_pair;
+
+    //Number of slots per job in VertexAnimationSystem::update
+    static const unsigned int animationGrainSize = 1024;
+
     unique_ptr<AnimationState> VertexAnimationData::createAnimationState() const
     {
-        return make_unique<VertexAnimationState>(this);
+        return make_unique<VertexAnimationState>(this, Locator::getWorld().getAnimations());
+    }
+
+    int VertexAnimationData::addClip(const string& name, const VertexAnim& anim)
+    {
+        auto iter = clipIds.find(name);
+        if (iter != clipIds.end())
+            return iter->second;
+        clips.push_back(anim);
+        clipIds.insert(make_pair(name, (int)clips.size() - 1));
+        return clips.size() - 1;
     }
 
-    VertexAnimationState::VertexAnimationState(const VertexAnimationData* data)
+    int VertexAnimationData::getClipId(const string& name) const
+    {
+        auto iter = clipIds.find(name);
+        if (iter == clipIds.end()) return -1;
+        return iter->second;
+    }
+
+    //
+    // VertexAnimationSystem
+    //
+
+    VertexAnimationSystem::VertexAnimationSystem()
+    {
+    }
+
+    VertexAnimationSystem::~VertexAnimationSystem()
+    {
+    }
+
+    int VertexAnimationSystem::getClipIndex(const VertexAnimationData* data, int clipId)
+    {
+        //The clips of a VertexAnimationData are copied into the tables
+        //the first time any of them is used
+        if (data->system != this)
+        {
+            data->system = this;
+            data->systemClipBase = clipStartFrame.size();
+            for (auto& anim : data->getClips())
+            {
+                clipStartFrame.push_back(anim.startFrame);
+                clipFrameCount.push_back(anim.frameTimes.size());
+                clipTimesOffset.push_back(frameTimes.size());
+                for (float t : anim.frameTimes)
+                    frameTimes.push_back(t > 0.0f ? t : 0.0001f);
+            }
+        }
+        return data->systemClipBase + clipId;
+    }
+
+    int VertexAnimationSystem::createSlot()
+    {
+        int s;
+        if (freeSlots.empty())
+        {
+            s = clip.size();
+            clip.push_back(-1);
+            frame.push_back(0);
+            timer.push_back(0.0f);
+            speed.push_back(0.0f);
+            frameTime.push_back(1.0f);
+            interpolation.push_back(0.0f);
+            refCount.push_back(0);
+            sharedKey.push_back(-1);
+        }
+        else
+        {
+            s = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        refCount[s] = 1;
+        return s;
+    }
+
+    int VertexAnimationSystem::acquireSharedSlot(const VertexAnimationData* data, int clipId)
+    {
+        int c = getClipIndex(data, clipId);
+        auto iter = sharedSlots.find(c);
+        if (iter != sharedSlots.end())
+        {
+            refCount[iter->second]++;
+            return iter->second;
+        }
+        int s = createSlot();
+        setClip(s, data, clipId);
+        sharedKey[s] = c;
+        sharedSlots.insert(make_pair(c, s));
+        return s;
+    }
+
+    int VertexAnimationSystem::cloneSlot(int s)
+    {
+        int copy = createSlot();
+        clip[copy] = clip[s];
+        frame[copy] = frame[s];
+        timer[copy] = timer[s];
+        speed[copy] = speed[s];
+        frameTime[copy] = frameTime[s];
+        interpolation[copy] = interpolation[s];
+        return copy;
+    }
+
+    void VertexAnimationSystem::releaseSlot(int s)
+    {
+        if (--refCount[s] > 0) return;
+        if (sharedKey[s] >= 0)
+            sharedSlots.erase(sharedKey[s]);
+
+        //A free slot has speed 0 so update leaves it alone
+        clip[s] = -1;
+        frame[s] = 0;
+        timer[s] = 0.0f;
+        speed[s] = 0.0f;
+        frameTime[s] = 1.0f;
+        interpolation[s] = 0.0f;
+        sharedKey[s] = -1;
+        freeSlots.push_back(s);
+    }
+
+    void VertexAnimationSystem::setClip(int s, const VertexAnimationData* data, int clipId)
+    {
+        int c = getClipIndex(data, clipId);
+        clip[s] = c;
+        frame[s] = 0;
+        timer[s] = 0.0f;
+        speed[s] = 1.0f;
+        frameTime[s] = frameTimes[clipTimesOffset[c]];
+        interpolation[s] = 0.0f;
+    }
+
+    float VertexAnimationSystem::getClipDuration(int s) const
+    {
+        int c = clip[s];
+        if (c < 0) return 0.0f;
+        float time = 0.0f;
+        for (int i = 0; i < clipFrameCount[c]; ++i)
+            time += frameTimes[clipTimesOffset[c] + i];
+        return time;
+    }
+
+    void VertexAnimationSystem::advance(unsigned int begin, unsigned int end, float elapsedTime)
+    {
+        //Plain loops over the arrays, the first and last one vectorize
+        for (unsigned int i = begin; i < end; ++i)
+            timer[i] += elapsedTime * speed[i];
+
+        //Only touches the clip tables when a frame ends
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            //It is a loop because it is possible to skip more
+            //frames if frametimes are short, or the update is
+            //over a large time
+            while (timer[i] > frameTime[i])
+            {
+                int c = clip[i];
+                timer[i] -= frameTime[i];
+                if (++frame[i] >= clipFrameCount[c]) frame[i] = 0;
+                frameTime[i] = frameTimes[clipTimesOffset[c] + frame[i]];
+            }
+        }
+
+        for (unsigned int i = begin; i < end; ++i)
+            interpolation[i] = timer[i] / frameTime[i];
+    }
+
+    void VertexAnimationSystem::update(float elapsedTime, JobSystem* jobs)
+    {
+        unsigned int count = clip.size();
+        if (jobs)
+            jobs->parallelFor(count, animationGrainSize, [this, elapsedTime](unsigned int begin, unsigned int end) {
+                    advance(begin, end, elapsedTime);
+                    });
+        else
+            advance(0, count, elapsedTime);
+    }
+
+    //
+    // VertexAnimationState
+    //
+
+    VertexAnimationState::VertexAnimationState(const VertexAnimationData* data, shared_ptr<VertexAnimationSystem> sys)
     {
         animData = data;
-        curAnim = 0;
-        startFrame = 0;
-        curFrame = 0;
-        timer = 0.0f;
-        interpolation = 0.0f;
-        speedFactor = 1.0f;
+        system = sys;
+        slot = system->createSlot();
+        curClip = -1;
     }
 
     VertexAnimationState::~VertexAnimationState()
     {
+        system->releaseSlot(slot);
     }
 
     //Base class overloads
     void VertexAnimationState::setAnimation(string name)
     {
         if(!animData) return;
-        auto anim = animData->animations.find(name);
-        if(anim == animData->animations.end())
+        int clipId = animData->getClipId(name);
+        if(clipId < 0)
         {
             LogWarning << "Animation not found: " << name << endLog;
             return;
         }
-        if(curAnim == &anim->second) return;
-        curAnim = &anim->second;
-        startFrame = curAnim->startFrame;
-        curFrame = 0;
-        timer = 0.0f;
-        interpolation = 0.0f;
-        speedFactor = 1.0f;
+        setAnimation(clipId);
     }
 
-    void VertexAnimationState::updateAnimation(float elapsedTime)
+    void VertexAnimationState::setAnimation(int clipId)
     {
-        if(!curAnim) return;
-
-        timer += elapsedTime * speedFactor;
+        if(!animData) return;
+        if(clipId < 0 || clipId >= (int)animData->getClips().size()) return;
+        if(curClip == clipId) return;
 
-        //Advance frames
-        //It is a loop because it is possible to skip more
-        //frames if frametimes are short, or the update is
-        //over a large time
-        while(timer > curAnim->frameTimes[curFrame])
+        if(system->isShared(slot))
         {
-            timer -= curAnim->frameTimes[curFrame];
-            curFrame++;
-            if(curFrame > (curAnim->endFrame - curAnim->startFrame)) curFrame = 0;
+            system->releaseSlot(slot);
+            slot = system->createSlot();
         }
-        interpolation = timer / curAnim->frameTimes[curFrame];
+        curClip = clipId;
+        system->setClip(slot, animData, clipId);
     }
 
+    void VertexAnimationState::setSharedAnimation(int clipId)
+    {
+        if(!animData) return;
+        if(clipId < 0 || clipId >= (int)animData->getClips().size()) return;
+        if(curClip == clipId && system->isShared(slot)) return;
+
+        system->releaseSlot(slot);
+        slot = system->acquireSharedSlot(animData, clipId);
+        curClip = clipId;
+    }
 
     float VertexAnimationState::getAnimationTime()
     {
-        if(!curAnim) return 0.0f;
-
-        float time = 0.0f;
-        for(int i = 0; i <= (curAnim->endFrame - curAnim->startFrame); ++i)
-        {
-            time += curAnim->frameTimes[i];
-        }
-        return time;
+        return system->getClipDuration(slot);
     }
 
     void VertexAnimationState::setAnimationTime(float newTime)
     {
         if(newTime > 0.0001)
-            speedFactor = getAnimationTime() / newTime;
+        {
+            //Changing the speed of a shared slot would change it
+            //for everyone, so continue on a copy of our own
+            if(system->isShared(slot))
+            {
+                int shared = slot;
+                slot = system->cloneSlot(shared);
+                system->releaseSlot(shared);
+            }
+            system->setSpeed(slot, getAnimationTime() / newTime);
+        }
     }
 };
-
-
@@ -13,16 +13,21 @@ namespace Arya
         pitch = 0;
         yaw = 0;
         userData = 0;
+        world = 0;
+        transform = TransformSystem::none;
+        bounds = SpatialIndex::none;
     }
 
     Entity::~Entity()
     {
+        if (world) world->removeEntity(this);
     }
 
     shared_ptr<Entity> Entity::create()
     {
-        shared_ptr<Entity> e = make_shared<Entity>(this_is_private{});
-        Locator::getWorld().addEntity(e);
+        //The control block of the shared_ptr comes from a pool as well
+        shared_ptr<Entity> e(new Entity(this_is_private{}), std::default_delete<Entity>(), PoolAllocator<Entity>());
+        Locator::getWorld().addEntity(e.get(), false);
         return e;
     }
 
@@ -35,15 +40,27 @@ namespace Arya
     {
         graphicsComponent = std::move(gr);
         graphicsComponent->setEntity(this);
+        updateScale();
+        updateBounds();
     }
 
     void Entity::setGraphics(shared_ptr<Model> model)
     {
+        if (graphicsComponent && graphicsComponent->getRenderType() == TYPE_MODEL)
+        {
+            ModelGraphicsComponent* comp = static_cast<ModelGraphicsComponent*>(graphicsComponent.get());
+            comp->setModel(model);
+            comp->setScale(vec3(1.0f));
+            return;
+        }
+
         //can not be done with make_unique because it is casted to its base class
         ModelGraphicsComponent* comp = new ModelGraphicsComponent;
         comp->setModel(model);
         comp->setEntity(this);
         graphicsComponent.reset(comp);
+        updateScale();
+        updateBounds();
     }
 
     void Entity::setGraphics(shared_ptr<Material> material)
@@ -53,11 +70,71 @@ namespace Arya
         comp->setMaterial(material);
         comp->setEntity(this);
         graphicsComponent.reset(comp);
+        updateScale();
+        updateBounds();
+    }
+
+    void Entity::setPosition(const vec3& pos)
+    {
+        position = pos;
+        if (world) world->getTransforms().setPosition(transform, position);
+    }
+
+    void Entity::setPitch(float p)
+    {
+        pitch = p;
+        if (world) world->getTransforms().setRotation(transform, yaw, pitch);
+    }
+
+    void Entity::setYaw(float y)
+    {
+        yaw = y;
+        if (world) world->getTransforms().setRotation(transform, yaw, pitch);
+    }
+
+    void Entity::setParent(shared_ptr<Entity> ent)
+    {
+        if (world && world->isUpdating())
+        {
+            World* w = world;
+            EntityHandle h = handle;
+            world->applyChange([w, h, ent]() {
+                if (Entity* e = w->getEntity(h))
+                    e->setParent(ent);
+            });
+            return;
+        }
+        parent = ent;
+        if (world)
+        {
+            if (ent && ent->world == world)
+                world->getTransforms().setParent(transform, ent->transform);
+            else
+                world->getTransforms().setParent(transform, TransformSystem::none);
+        }
+    }
+
+    const mat4& Entity::getMoveMatrix() const
+    {
+        static const mat4 identity(1.0f);
+        if (!world) return identity;
+        return world->getTransforms().getWorldMatrix(transform);
+    }
+
+    mat4 Entity::getRenderMatrix() const
+    {
+        if (!world) return getMoveMatrix();
+        return world->getRenderMatrix(transform);
+    }
+
+    void Entity::updateBounds()
+    {
+        if (world) world->markBoundsDirty(this);
     }
 
-    void Entity::updateMatrix()
+    void Entity::updateScale()
     {
-        if (graphicsComponent)
-            graphicsComponent->setDirty();
+        if (!world) return;
+        world->getTransforms().setScale(transform, graphicsComponent ? graphicsComponent->getScale() : vec3(1.0f));
     }
 }
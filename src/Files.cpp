@@ -1,5 +1,7 @@
 #include "common/Logger.h"
 #include "Files.h"
+#include "Locator.h"
+#include "Preload.h"
 #include <fstream>
 #include <algorithm>
 
@@ -82,29 +84,30 @@ namespace Arya
             return loadedFile->second;
         }
 
-        string path(applicationPath);
-        path.append(formattedFilename);
-        ifstream filestream;
-        filestream.open( path.c_str(), std::ios::binary );
-        if( filestream.is_open() == false ){
-            LogWarning << "File: " << path << " not found." << endLog;
+        char* data;
+        unsigned int size;
+        if( readFromDisk(formattedFilename, data, size) == false ){
+            LogWarning << "File: " << applicationPath << formattedFilename << " not found." << endLog;
             return 0;
         }
 
-        File* newFile = new File;
-
-        //Get file length
-        filestream.seekg(0, std::ios::end);
-        newFile->size = (unsigned int)filestream.tellg();
-        filestream.seekg(0, std::ios::beg);
+        Locator::getPreloader().record(PRELOAD_FILE, formattedFilename);
 
-        //allocate memory + 2 (unicode support) for terminating zero for text files
-        newFile->data = new char[newFile->size+2];
-        newFile->data[newFile->size] = 0;
-        newFile->data[newFile->size+1] = 0;
+        return addFile(formattedFilename, data, size);
+    }
 
-        filestream.read(newFile->data, newFile->size);
+    File* FileSystem::addFile(string filename, char* data, unsigned int size)
+    {
+        auto loadedFile = loadedFiles.find(filename);
+        if( loadedFile != loadedFiles.end() ){
+            delete[] data;
+            loadedFile->second->refcount++;
+            return loadedFile->second;
+        }
 
+        File* newFile = new File;
+        newFile->data = data;
+        newFile->size = size;
         newFile->refcount = 1;
 
         //Add to loadedFiles
@@ -112,6 +115,29 @@ namespace Arya
         return newFile;
     }
 
+    bool FileSystem::readFromDisk(const string& filename, char*& data, unsigned int& size) const
+    {
+        string path(applicationPath);
+        path.append(filename);
+        ifstream filestream;
+        filestream.open( path.c_str(), std::ios::binary );
+        if( filestream.is_open() == false )
+            return false;
+
+        //Get file length
+        filestream.seekg(0, std::ios::end);
+        size = (unsigned int)filestream.tellg();
+        filestream.seekg(0, std::ios::beg);
+
+        //allocate memory + 2 (unicode support) for terminating zero for text files
+        data = new char[size+2];
+        data[size] = 0;
+        data[size+1] = 0;
+
+        filestream.read(data, size);
+        return true;
+    }
+
     void FileSystem::releaseFile(File* file)
     {
         file->refcount--;
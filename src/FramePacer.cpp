@@ -0,0 +1,253 @@
+#include "FramePacer.h"
+#include "common/Logger.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace Arya
+{
+    //Bounds of the spin margin in seconds
+    static const double minSpinMargin = 0.0005;
+    static const double maxSpinMargin = 0.004;
+
+    FramePacer::FramePacer()
+    {
+        targetRate = 0.0f;
+        vsync = VSYNC_ON;
+        frequency = (double)SDL_GetPerformanceFrequency();
+        nextFrame = 0;
+        lastFrame = 0;
+        spinMargin = 0.001;
+        measureLatency = false;
+        resetStats();
+    }
+
+    void FramePacer::setTargetRate(float hz)
+    {
+        targetRate = (hz > 0.0f ? hz : 0.0f);
+        nextFrame = 0;
+    }
+
+    VsyncMode FramePacer::setVsync(VsyncMode mode)
+    {
+        int interval = (mode == VSYNC_OFF ? 0 : (mode == VSYNC_ON ? 1 : -1));
+        if (SDL_GL_SetSwapInterval(interval) != 0)
+        {
+            if (mode == VSYNC_ADAPTIVE)
+            {
+                LogWarning << "Adaptive vsync not supported, using vsync" << endLog;
+                return setVsync(VSYNC_ON);
+            }
+            LogWarning << "Could not set the swap interval: " << SDL_GetError() << endLog;
+            return vsync;
+        }
+        vsync = mode;
+        return vsync;
+    }
+
+    void FramePacer::limit()
+    {
+        if (targetRate <= 0.0f) return;
+
+        uint64_t period = uint64_t(frequency / targetRate);
+        uint64_t now = SDL_GetPerformanceCounter();
+        //First frame, or so late that catching up would only cause a burst of frames
+        if (nextFrame == 0 || now > nextFrame + period)
+        {
+            nextFrame = now + period;
+            return;
+        }
+
+        if (now < nextFrame)
+        {
+            double remaining = (nextFrame - now) / frequency;
+            if (remaining > spinMargin)
+            {
+                uint32_t sleepMs = uint32_t((remaining - spinMargin) * 1000.0);
+                if (sleepMs > 0)
+                {
+                    uint64_t sleepStart = SDL_GetPerformanceCounter();
+                    SDL_Delay(sleepMs);
+                    double slept = (SDL_GetPerformanceCounter() - sleepStart) / frequency;
+                    //Adapt the margin to how much the sleep overshoots, slowly shrinking it again
+                    double oversleep = slept - sleepMs * 0.001;
+                    spinMargin = std::max(spinMargin * 0.99, oversleep * 1.25);
+                    spinMargin = std::min(std::max(spinMargin, minSpinMargin), maxSpinMargin);
+                }
+            }
+            while (SDL_GetPerformanceCounter() < nextFrame) {}
+        }
+        //Fixed deadlines so that the rate does not drift
+        nextFrame += period;
+    }
+
+    void FramePacer::frameDone()
+    {
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (lastFrame == 0)
+        {
+            lastFrame = now;
+            return;
+        }
+        float frameTime = float((now - lastFrame) / frequency);
+        lastFrame = now;
+
+        if (measureLatency && !frameEvents.empty())
+        {
+            uint32_t swapTime = SDL_GetTicks();
+            for (uint32_t timestamp : frameEvents)
+            {
+                latencies[latencyPos % windowSize] = 0.001f * (swapTime - timestamp);
+                latencyPos++;
+            }
+            frameEvents.clear();
+        }
+
+        window[windowPos % windowSize] = frameTime;
+        windowPos++;
+
+        unsigned int bucket = (unsigned int)(frameTime * 10000.0f);
+        histogram[std::min(bucket, bucketCount - 1)]++;
+        sessionFrames++;
+        sessionTotal += frameTime;
+        sessionMax = std::max(sessionMax, frameTime);
+        if (targetRate > 0.0f && frameTime > 1.5f / targetRate)
+            sessionMissed++;
+    }
+
+    void FramePacer::setLatencyMeasurement(bool enable)
+    {
+        measureLatency = enable;
+        frameEvents.clear();
+        latencies.assign(windowSize, 0.0f);
+        latencyPos = 0;
+    }
+
+    void FramePacer::inputEvent(uint32_t timestamp)
+    {
+        if (measureLatency)
+            frameEvents.push_back(timestamp);
+    }
+
+    FrameStats FramePacer::getLatencyStats() const
+    {
+        unsigned int count = std::min(latencyPos, windowSize);
+        FrameStats stats = computeStats(vector<float>(latencies.begin(), latencies.begin() + count));
+        stats.missedFrames = 0;
+        return stats;
+    }
+
+    void FramePacer::resetStats()
+    {
+        window.assign(windowSize, 0.0f);
+        windowPos = 0;
+        histogram.assign(bucketCount, 0);
+        sessionFrames = 0;
+        sessionMissed = 0;
+        sessionTotal = 0.0;
+        sessionMax = 0.0f;
+        latencies.assign(windowSize, 0.0f);
+        latencyPos = 0;
+    }
+
+    FrameStats FramePacer::computeStats(vector<float> times) const
+    {
+        FrameStats stats;
+        stats.frameCount = times.size();
+        stats.p50 = stats.p95 = stats.p99 = stats.max = stats.average = 0.0f;
+        stats.missedFrames = 0;
+        if (times.empty()) return stats;
+
+        std::sort(times.begin(), times.end());
+        auto percentile = [&times](float p) {
+            return 1000.0f * times[(unsigned int)(p * (times.size() - 1) + 0.5f)];
+        };
+        stats.p50 = percentile(0.50f);
+        stats.p95 = percentile(0.95f);
+        stats.p99 = percentile(0.99f);
+        stats.max = 1000.0f * times.back();
+
+        double total = 0.0;
+        for (float t : times)
+        {
+            total += t;
+            if (targetRate > 0.0f && t > 1.5f / targetRate)
+                stats.missedFrames++;
+        }
+        stats.average = float(1000.0 * total / times.size());
+        return stats;
+    }
+
+    FrameStats FramePacer::getStats() const
+    {
+        unsigned int count = std::min(windowPos, windowSize);
+        return computeStats(vector<float>(window.begin(), window.begin() + count));
+    }
+
+    FrameStats FramePacer::getSessionStats() const
+    {
+        FrameStats stats;
+        stats.frameCount = sessionFrames;
+        stats.p50 = stats.p95 = stats.p99 = 0.0f;
+        stats.max = 1000.0f * sessionMax;
+        stats.average = (sessionFrames ? float(1000.0 * sessionTotal / sessionFrames) : 0.0f);
+        stats.missedFrames = sessionMissed;
+        if (sessionFrames == 0) return stats;
+
+        //Upper edge of the bucket that contains the percentile
+        float* targets[3] = { &stats.p50, &stats.p95, &stats.p99 };
+        float fractions[3] = { 0.50f, 0.95f, 0.99f };
+        unsigned int sum = 0, next = 0;
+        for (unsigned int i = 0; i < bucketCount && next < 3; ++i)
+        {
+            sum += histogram[i];
+            while (next < 3 && sum >= fractions[next] * sessionFrames)
+                *targets[next++] = std::min(0.1f * (i + 1), stats.max);
+        }
+        return stats;
+    }
+
+    static void printStats(std::ostream& out, const char* name, const FrameStats& stats, const char* unit = "frames")
+    {
+        out << name << ": " << stats.frameCount << " " << unit << ", ms"
+            << " avg " << stats.average
+            << " p50 " << stats.p50
+            << " p95 " << stats.p95
+            << " p99 " << stats.p99
+            << " max " << stats.max;
+        if (std::string(unit) == "frames")
+            out << ", " << stats.missedFrames << " missed";
+    }
+
+    string FramePacer::getStatsText() const
+    {
+        std::stringstream text;
+        text << std::fixed << std::setprecision(2);
+        text << "Target " << targetRate << " Hz, vsync "
+            << (vsync == VSYNC_OFF ? "off" : (vsync == VSYNC_ON ? "on" : "adaptive")) << "\n";
+        printStats(text, "Last frames", getStats());
+        text << "\n";
+        printStats(text, "Session", getSessionStats());
+        if (measureLatency)
+        {
+            text << "\n";
+            printStats(text, "Input to swap", getLatencyStats(), "events");
+        }
+        return text.str();
+    }
+
+    bool FramePacer::writeStats(const string& filename) const
+    {
+        std::ofstream file(filename.c_str(), std::ios::trunc);
+        if (!file.is_open())
+        {
+            LogWarning << "Could not write frame statistics to " << filename << endLog;
+            return false;
+        }
+        file << getStatsText() << "\n";
+        return true;
+    }
+}
@@ -1,4 +1,5 @@
 #include "Geometry.h"
+#include "common/Logger.h"
 
 namespace Arya
 {
@@ -6,24 +7,35 @@ namespace Arya
     {
         frameCount = 0;
         vaoHandles = 0;
+        vaoCount = 0;
         vertexBuffer = 0;
         vertexCount = 0;
         indexBuffer = 0;
         indexCount = 0;
         primitiveType = 0;
+        frameTexture = 0;
+        frameTextureBuffer = 0;
+        instanceBuffer = 0;
+        instanceBufferSize = 0;
     }
 
     Geometry::~Geometry()
     {
         if(vaoHandles)
         {
-            glDeleteVertexArrays(frameCount, vaoHandles);
+            glDeleteVertexArrays(vaoCount, vaoHandles);
             delete[] vaoHandles;
         }
         if(indexBuffer)
             glDeleteBuffers(1, &indexBuffer);
         if(vertexBuffer)
             glDeleteBuffers(1, &vertexBuffer);
+        if(frameTexture)
+            glDeleteTextures(1, &frameTexture);
+        if(frameTextureBuffer)
+            glDeleteBuffers(1, &frameTextureBuffer);
+        if(instanceBuffer)
+            glDeleteBuffers(1, &instanceBuffer);
     }
 
     void Geometry::createVertexBuffer()
@@ -55,13 +67,13 @@ namespace Arya
         //Delete old handles if they existed
         if(vaoHandles)
         {
-            glDeleteVertexArrays(frameCount, vaoHandles);
+            glDeleteVertexArrays(vaoCount, vaoHandles);
             delete[] vaoHandles;
         }
-        frameCount = count;
-        vaoHandles = new GLuint[frameCount];
+        vaoCount = count;
+        vaoHandles = new GLuint[vaoCount];
 
-        glGenVertexArrays(frameCount, vaoHandles);
+        glGenVertexArrays(vaoCount, vaoHandles);
     }
 
     void Geometry::bindVAO(int index)
@@ -81,13 +93,92 @@ namespace Arya
                 stride, reinterpret_cast<GLubyte*>(offset));
     }
 
+    bool Geometry::createFrameTexture(const GLfloat* data, int floatCount, const vector<int>& next)
+    {
+        //Two texels per vertex: position and normal
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        long long texelCount = 2LL * frameCount * vertexCount;
+        if(texelCount > maxTexels)
+        {
+            LogWarning << "Animation with " << frameCount << " frames of " << vertexCount
+                << " vertices does not fit in a texture buffer (max " << maxTexels << " texels)" << endLog;
+            return false;
+        }
+
+        vector<GLfloat> texels(texelCount * 4, 0.0f);
+        GLfloat* out = texels.data();
+        for(long long v = 0; v < frameCount * (long long)vertexCount; ++v)
+        {
+            const GLfloat* in = data + v * floatCount;
+            out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = 1.0f;
+            if(floatCount == 8)
+            {
+                out[4] = in[5]; out[5] = in[6]; out[6] = in[7];
+            }
+            out += 8;
+        }
+
+        if(!frameTextureBuffer)
+            glGenBuffers(1, &frameTextureBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, frameTextureBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(GLfloat), texels.data(), GL_STATIC_DRAW);
+
+        if(!frameTexture)
+            glGenTextures(1, &frameTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, frameTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, frameTextureBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        nextFrames = next;
+        return true;
+    }
+
+    void Geometry::createInstanceBuffer(int firstAttrib)
+    {
+        if(!instanceBuffer)
+            glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+        //A mat4 attribute takes four consecutive indices, one per column
+        int stride = sizeof(GeometryInstance);
+        for(int i = 0; i < 4; ++i)
+        {
+            setVAOdata(firstAttrib + i, 4, stride, i * sizeof(vec4));
+            glVertexAttribDivisor(firstAttrib + i, 1);
+        }
+        setVAOdata(firstAttrib + 4, 4, stride, sizeof(mat4));
+        glVertexAttribDivisor(firstAttrib + 4, 1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    }
+
     void Geometry::draw(int frame)
     {
-        glBindVertexArray(vaoHandles[frame]);
+        glBindVertexArray(vaoHandles[frameTexture ? 0 : frame]);
         if (indexCount)
             glDrawElements(primitiveType, indexCount, GL_UNSIGNED_INT, 0);
         else
             glDrawArrays(primitiveType, 0, vertexCount);
     }
 
+    void Geometry::drawInstanced(const GeometryInstance* instances, int instanceCount)
+    {
+        if (!instanceBuffer || instanceCount <= 0) return;
+
+        glBindVertexArray(vaoHandles[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        //Orphan the old storage so the driver does not wait for previous draws
+        if (instanceCount > instanceBufferSize)
+            instanceBufferSize = instanceCount;
+        glBufferData(GL_ARRAY_BUFFER, instanceBufferSize * sizeof(GeometryInstance), 0, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(GeometryInstance), instances);
+
+        if (indexCount)
+            glDrawElementsInstanced(primitiveType, indexCount, GL_UNSIGNED_INT, 0, instanceCount);
+        else
+            glDrawArraysInstanced(primitiveType, 0, vertexCount, instanceCount);
+    }
+
 }
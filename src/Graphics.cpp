@@ -3,6 +3,7 @@
 #include "Camera.h"
 #include "CommandHandler.h"
 #include "Entity.h"
+#include "FrameSnapshot.h"
 #include "Geometry.h"
 #include "Graphics.h"
 #include "Materials.h"
@@ -12,11 +13,14 @@
 #include "Renderer.h"
 #include "Shaders.h"
 #include "Textures.h"
+#include "UniformBlock.h"
 #include "World.h"
 #include "Interface.h"
 #include "Text.h"
 #include "Locator.h"
 #include <typeinfo>
+#include <map>
+#include <cstring>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 
@@ -24,14 +28,45 @@ namespace Arya {
 
 const float PI = 3.14159265358979323846264338327950288f;
 
+static const mat4 biasMatrix(
+        0.5f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.5f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.5f, 0.0f,
+        0.5f, 0.5f, 0.5f, 1.0f
+        );
+
+//All entities with the same instanced model are drawn with one call per mesh
+struct InstanceBatch
+{
+    vector<const DrawPacket*> packets; //for the uniform blocks and custom uniforms of the shader
+    vector<GeometryInstance> instances;
+};
+
+struct Graphics::InstanceBatches
+{
+    std::map<Model*, InstanceBatch> batches;
+    //The uniform blocks of a chunk of instances, uploaded at once
+    vector<char> blockData;
+    UniformBuffer blockBuffer;
+};
+
 Graphics::Graphics()
 {
     renderer = new Renderer;
     camera = new Camera;
+    instanceBatches = new InstanceBatches;
+    frameSnapshot = new FrameSnapshot;
+    pickingEnabled = false;
+    pickX = pickY = -1;
+    pickedId = 0;
+    pickReadback = 0;
 }
 
 Graphics::~Graphics()
 {
+    delete pickReadback;
+    delete frameSnapshot;
+    delete instanceBatches;
     delete camera;
     delete renderer;
 }
@@ -75,16 +110,12 @@ bool Graphics::init(int width, int height)
 
     billboardShader->enableUniform(UNIFORM_MOVEMATRIX | UNIFORM_VPMATRIX | UNIFORM_TEXTURE);
 
-    billboardShader->addUniform2fv("screenOffset",
-            [](ShaderUniformBase* b) {
-            Entity* e = dynamic_cast<Entity*>(b);
-            return e->getGraphics()->getScreenOffset();
-            } );
-    billboardShader->addUniform2fv("screenSize",
-            [](ShaderUniformBase* b) {
-            Entity* e = dynamic_cast<Entity*>(b);
-            return e->getGraphics()->getScreenSize();
-            } );
+    //Filled by renderBillboard for every billboard
+    auto billboardLayout = make_shared<UniformLayout>();
+    billboardOffsetField = billboardLayout->add("screenOffset", UNIFORMTYPE_VEC2);
+    billboardSizeField = billboardLayout->add("screenSize", UNIFORMTYPE_VEC2);
+    billboardUniforms = make_shared<UniformBlock>(billboardLayout);
+    billboardShader->setUniformDefaults(billboardUniforms);
 
     viewShader = make_shared<ShaderProgram>(
             "../shaders/view.vert",
@@ -135,9 +166,103 @@ void Graphics::clear(int width, int height)
 
 void Graphics::render(World* world)
 {
-    shared_ptr<Entity> ent;
-    auto entities = world->getEntities();
+    buildSnapshot(world, *frameSnapshot, false);
+    render(*frameSnapshot);
+}
+
+void Graphics::buildSnapshot(World* world, FrameSnapshot& snapshot, bool threaded)
+{
+    snapshot.clear();
+    snapshot.viewMatrix = camera->getVMatrix();
+    snapshot.vpMatrix = camera->getVPMatrix();
+    snapshot.lightMatrix = lightMatrix;
+
+    // Entities could have moved since World::update
+    world->updateBounds();
+
+    if (shadowRenderTarget)
+    {
+        // Only entities inside the box of the shadow map cast shadows
+        visibleEntities.clear();
+        world->queryFrustum(lightMatrix, visibleEntities);
+        for(Entity* ent : visibleEntities)
+            addPacket(ent, snapshot, true, threaded);
+    }
+
+    visibleEntities.clear();
+    world->queryFrustum(camera->getVPMatrix(), visibleEntities);
+    for(Entity* ent : visibleEntities)
+        addPacket(ent, snapshot, false, threaded);
+}
+
+void Graphics::addPacket(Entity* e, FrameSnapshot& snapshot, bool shadowPass, bool threaded)
+{
+    GraphicsComponent* gr = e->getGraphics();
+    if (!gr) return;
+
+    DrawPacket packet;
+    packet.type = gr->getRenderType();
+    packet.model = 0;
+    packet.material = 0;
+    packet.frame = 0;
+    packet.interpolation = 0.0f;
+    packet.screenOffset = packet.screenSize = vec2(0.0f);
+
+    if (packet.type == TYPE_MODEL)
+    {
+        ModelGraphicsComponent* modelGr = (ModelGraphicsComponent*)gr;
+        packet.model = modelGr->getModel();
+        if (!packet.model) return;
+        if (auto animState = modelGr->getAnimationState())
+        {
+            packet.frame = animState->getCurFrame();
+            packet.interpolation = animState->getInterpolation();
+        }
+        // Entities with the same model are often next to each other
+        if (threaded && (snapshot.models.empty() || snapshot.models.back().get() != packet.model))
+            snapshot.models.push_back(modelGr->getSharedModel());
+    }
+    else if (packet.type == TYPE_BILLBOARD && !shadowPass)
+    {
+        BillboardGraphicsComponent* billboardGr = (BillboardGraphicsComponent*)gr;
+        packet.material = billboardGr->getMaterial();
+        if (!packet.material) return;
+        packet.screenOffset = billboardGr->getScreenOffset();
+        packet.screenSize = billboardGr->getScreenSize();
+        if (threaded && (snapshot.materials.empty() || snapshot.materials.back().get() != packet.material))
+            snapshot.materials.push_back(billboardGr->getSharedMaterial());
+    }
+    else
+        return;
+
+    packet.moveMatrix = e->getRenderMatrix();
+    packet.entityIndex = e->getHandle().index;
+    packet.uniformSource = (threaded ? 0 : e);
+    packet.uniformLayout = 0;
+    packet.uniformOffset = 0;
+    if (const UniformBlock* block = e->getUniformBlock())
+    {
+        packet.uniformLayout = block->getLayout();
+        packet.uniformOffset = snapshot.uniformData.size();
+        if (threaded && (snapshot.layouts.empty() || snapshot.layouts.back().get() != packet.uniformLayout))
+            snapshot.layouts.push_back(block->getLayoutPtr());
+        snapshot.uniformData.insert(snapshot.uniformData.end(), block->getData(), block->getData() + block->getSize());
+    }
+
+    if (shadowPass)
+        snapshot.shadowPackets.push_back(packet);
+    else
+        snapshot.packets.push_back(packet);
+}
+
+//The copy of the uniform block of the entity, or nullptr
+static const char* packetUniforms(const DrawPacket& packet, const FrameSnapshot& snapshot)
+{
+    return (packet.uniformLayout ? &snapshot.uniformData[packet.uniformOffset] : 0);
+}
 
+void Graphics::render(const FrameSnapshot& snapshot)
+{
     //
     // Shadow pass
     //
@@ -145,17 +270,11 @@ void Graphics::render(World* world)
     {
         renderer->setRenderTarget(shadowRenderTarget.get());
         renderer->clear(2048, 2048);
-        for(auto weakEnt : entities) {
-            ent = weakEnt.lock();
-            if (!ent) continue;
-
-            GraphicsComponent* gr = ent->getGraphics();
-            if (!gr) continue;
 
-            if (gr->getRenderType() != TYPE_MODEL) continue;
-
-            renderModel((ModelGraphicsComponent*)gr, ent.get(), true);
-        }
+        for(auto& packet : snapshot.shadowPackets)
+            if (!addInstance(packet))
+                renderModel(packet, snapshot, true);
+        renderInstances(snapshot, true);
         //TODO: Move this somewhere it belongs
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, shadowRenderTarget->depthBuffer);
@@ -166,31 +285,122 @@ void Graphics::render(World* world)
     //
     renderer->setRenderTarget(0);
     renderer->setViewport(windowWidth, windowHeight);
-    for(auto weakEnt : entities) {
-        ent = weakEnt.lock();
-        if (!ent) continue;
 
-        GraphicsComponent* gr = ent->getGraphics();
-        if (!gr) continue;
-
-        RenderType type = gr->getRenderType();
-        switch(type) {
+    for(auto& packet : snapshot.packets) {
+        switch(packet.type) {
             case TYPE_MODEL:
-                renderModel((ModelGraphicsComponent*)gr, ent.get(), false);
-                break;
-            case TYPE_TERRAIN:
+                if (!addInstance(packet))
+                    renderModel(packet, snapshot, false);
                 break;
             case TYPE_BILLBOARD:
-                renderBillboard((BillboardGraphicsComponent*)gr, ent.get());
+                renderBillboard(packet, snapshot);
                 break;
             default:
                 break;
         }
     }
+    renderInstances(snapshot, false);
+
+    if (pickingEnabled)
+        renderPicking(snapshot);
 
     return;
 }
 
+void Graphics::setPickingEnabled(bool enable)
+{
+    pickingEnabled = enable;
+    if (!enable)
+    {
+        pickedId = 0;
+        pickRenderTarget = nullptr;
+        delete pickReadback;
+        pickReadback = 0;
+    }
+}
+
+Entity* Graphics::getPickedEntity() const
+{
+    if (!pickingEnabled || pickedId == 0) return nullptr;
+    return Locator::getWorld().getEntityByIndex(pickedId - 1);
+}
+
+ShaderProgram* Graphics::getPickShader(const shared_ptr<ShaderProgram>& shader)
+{
+    PickShader& entry = pickShaders[shader.get()];
+    // The address could have been reused by a new shader
+    if (entry.original.lock() != shader)
+    {
+        entry.original = shader;
+        entry.picking = shader->createVariant("../shaders/picking.frag");
+        if (!entry.picking)
+            LogError << "Could not create picking shader." << endLog;
+    }
+    return entry.picking.get();
+}
+
+void Graphics::renderPicking(const FrameSnapshot& snapshot)
+{
+    if (!pickReadback)
+        pickReadback = new PixelReadback;
+
+    // Results of earlier frames, keep the newest
+    unsigned int id;
+    while (pickReadback->poll(id))
+        pickedId = id;
+
+    if (pickX < 0 || pickY < 0 || pickX >= windowWidth || pickY >= windowHeight)
+    {
+        pickedId = 0;
+        return;
+    }
+
+    if (!pickRenderTarget || pickRenderTarget->width != windowWidth || pickRenderTarget->height != windowHeight)
+    {
+        pickRenderTarget = renderer->createRenderTarget(windowWidth, windowHeight, true, true, true);
+        if (!pickRenderTarget)
+        {
+            LogError << "Could not create picking render target. Picking disabled." << endLog;
+            setPickingEnabled(false);
+            return;
+        }
+    }
+
+    // Only the pixels around the cursor are rendered
+    int x = pickX;
+    int y = windowHeight - 1 - pickY;
+    renderer->setRenderTarget(pickRenderTarget.get());
+    renderer->setScissor(x - 1, y - 1, 3, 3);
+    renderer->clearIntegerTarget();
+
+    for (auto& packet : snapshot.packets)
+    {
+        if (packet.type == TYPE_MODEL)
+        {
+            if (!packet.model->getShaderProgram()) continue;
+            ShaderProgram* shader = getPickShader(packet.model->getShaderProgram());
+            if (!shader) continue;
+            shader->use();
+            shader->setUniform1ui("entityId", packet.entityIndex + 1);
+            renderModel(packet, snapshot, false, shader);
+        }
+        else if (packet.type == TYPE_BILLBOARD)
+        {
+            ShaderProgram* shader = getPickShader(billboardShader);
+            if (!shader) continue;
+            shader->use();
+            shader->setUniform1ui("entityId", packet.entityIndex + 1);
+            renderBillboard(packet, snapshot, shader);
+        }
+    }
+
+    renderer->disableScissor();
+    pickReadback->request(x, y);
+
+    renderer->setRenderTarget(0);
+    renderer->setViewport(windowWidth, windowHeight);
+}
+
 void Graphics::render(Interface* interface)
 {
     // Get the quad if we do not have it yet
@@ -257,26 +467,25 @@ vec2 Graphics::normalizeMouseCoordinates(int x, int y)
             -1.0f + 2.0f*float(y)/float(windowHeight) );
 }
 
-void Graphics::renderModel(ModelGraphicsComponent* gr, Entity* e, bool shadowPass)
+void Graphics::renderModel(const DrawPacket& packet, const FrameSnapshot& snapshot, bool shadowPass, ShaderProgram* shader)
 {
-    Model* model = gr->getModel();
-    if(!model) return;
-    ShaderProgram* shader = model->getShaderProgram().get();
+    Model* model = packet.model;
+    if(!shader)
+    {
+        shader = model->getShaderProgram().get();
+        if (shader && shadowPass)
+            shader = shadowVariant(shader);
+    }
     if(!shader) return;
 
-    static mat4 biasMatrix(
-            0.5f, 0.0f, 0.0f, 0.0f,
-            0.0f, 0.5f, 0.0f, 0.0f,
-            0.0f, 0.0f, 0.5f, 0.0f,
-            0.5f, 0.5f, 0.5f, 1.0f
-            );
-
     shader->use();
-    shader->setMoveMatrix(gr->getMoveMatrix());
-    shader->setViewMatrix(camera->getVMatrix());
-    shader->setViewProjectionMatrix(shadowPass ? lightMatrix : camera->getVPMatrix());
-    shader->setLightMatrix(biasMatrix * lightMatrix);
-    shader->doUniforms(e);
+    shader->setMoveMatrix(packet.moveMatrix);
+    shader->setViewMatrix(snapshot.viewMatrix);
+    shader->setViewProjectionMatrix(shadowPass ? snapshot.lightMatrix : snapshot.vpMatrix);
+    shader->setLightMatrix(biasMatrix * snapshot.lightMatrix);
+    shader->applyUniformData(packet.uniformLayout, packetUniforms(packet, snapshot));
+    if (packet.uniformSource)
+        shader->doUniforms(packet.uniformSource);
 
     //TODO: one of these
     // - different shader on shadow pass
@@ -285,7 +494,7 @@ void Graphics::renderModel(ModelGraphicsComponent* gr, Entity* e, bool shadowPas
         shader->setShadowTexture(1);
 
     //TODO: Investigate the bounding box and also check onScreen.z ?
-    //mat4 totalMatrix = camera->getVPMatrix() * ent->getMoveMatrix();
+    //mat4 totalMatrix = camera->getVPMatrix() * e->getMoveMatrix();
     //bool flag = false;
     //for(int j = 0; j < 8; j++)
     //{
@@ -304,20 +513,106 @@ void Graphics::renderModel(ModelGraphicsComponent* gr, Entity* e, bool shadowPas
     int frame = 0;
     if (shader->isEnabled(UNIFORM_ANIM_INTERPOL))
     {
-        float interpolation = 0.0f;
-        if (auto animState = gr->getAnimationState())
-        {
-            frame = animState->getCurFrame();
-            interpolation = animState->getInterpolation();
-        }
-        shader->setAnimInterpolation(interpolation);
+        frame = packet.frame;
+        shader->setAnimInterpolation(packet.interpolation);
     }
 
     for(auto mesh : model->getMeshes())
         renderer->renderMesh(mesh, shader, frame);
 }
 
-void Graphics::renderBillboard(BillboardGraphicsComponent* gr, Entity* e)
+ShaderProgram* Graphics::shadowVariant(ShaderProgram* shader)
+{
+    ShaderProgram* depthOnly = shader->getFeatureVariant(shader->getFeatures() | FEATURE_SHADOW_ONLY);
+    return (depthOnly ? depthOnly : shader);
+}
+
+bool Graphics::addInstance(const DrawPacket& packet)
+{
+    Model* model = packet.model;
+    if (!model->getInstancedShaderProgram()) return false;
+    if (model->getMeshes().empty()) return true;
+
+    int frame = packet.frame;
+    //All meshes of a model have the same frames
+    Geometry* geom = model->getMeshes().front()->geometry.get();
+    if (!geom || frame >= geom->frameCount) return true;
+
+    InstanceBatch& batch = instanceBatches->batches[model];
+    batch.packets.push_back(&packet);
+    batch.instances.push_back(GeometryInstance{packet.moveMatrix,
+            vec4(float(frame), float(geom->getNextFrame(frame)), packet.interpolation, 0.0f)});
+    return true;
+}
+
+void Graphics::renderInstances(const FrameSnapshot& snapshot, bool shadowPass)
+{
+    auto& batches = instanceBatches->batches;
+    for (auto iter = batches.begin(); iter != batches.end(); )
+    {
+        InstanceBatch& batch = iter->second;
+        //Models that were not drawn this pass could be deleted
+        if (batch.instances.empty())
+        {
+            iter = batches.erase(iter);
+            continue;
+        }
+
+        Model* model = iter->first;
+        ShaderProgram* shader = model->getInstancedShaderProgram().get();
+        if (shadowPass)
+            shader = shadowVariant(shader);
+
+        shader->use();
+        shader->setViewMatrix(snapshot.viewMatrix);
+        shader->setViewProjectionMatrix(shadowPass ? snapshot.lightMatrix : snapshot.vpMatrix);
+        shader->setLightMatrix(biasMatrix * snapshot.lightMatrix);
+        if (batch.packets.front()->uniformSource)
+            shader->doUniforms(batch.packets.front()->uniformSource);
+        if (!shadowPass && shadowRenderTarget)
+            shader->setShadowTexture(1);
+
+        //The uniform array of the shader limits the instances per draw
+        unsigned int count = batch.instances.size();
+        unsigned int chunkSize = count;
+        if (shader->hasInstanceBlock())
+            chunkSize = shader->getInstanceBlockCapacity();
+
+        for (unsigned int begin = 0; begin < count; begin += chunkSize)
+        {
+            unsigned int end = (begin + chunkSize < count ? begin + chunkSize : count);
+            if (shader->hasInstanceBlock())
+                uploadInstanceBlocks(shader, snapshot, batch.packets.data() + begin, end - begin);
+            for (auto mesh : model->getMeshes())
+                renderer->renderMeshInstanced(mesh, shader, batch.instances.data() + begin, end - begin);
+        }
+
+        batch.packets.clear();
+        batch.instances.clear();
+        ++iter;
+    }
+}
+
+void Graphics::uploadInstanceBlocks(ShaderProgram* shader, const FrameSnapshot& snapshot, const DrawPacket* const* packets, unsigned int count)
+{
+    const UniformBlock* defaults = shader->getUniformDefaults().get();
+    unsigned int stride = defaults->getSize();
+
+    //The whole array of the shader is uploaded, the driver requires the buffer
+    //to be as large as the block
+    vector<char>& data = instanceBatches->blockData;
+    data.resize(shader->getInstanceBlockCapacity() * stride);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const char* block = defaults->getData();
+        if (packets[i]->uniformLayout == defaults->getLayout())
+            block = packetUniforms(*packets[i], snapshot);
+        std::memcpy(&data[i * stride], block, stride);
+    }
+    instanceBatches->blockBuffer.upload(data.data(), data.size(), shader->getInstanceBlockBinding());
+}
+
+void Graphics::renderBillboard(const DrawPacket& packet, const FrameSnapshot& snapshot, ShaderProgram* shader)
 {
     // Get the quad if we do not have it yet
     if (!quad2dGeometry)
@@ -328,19 +623,26 @@ void Graphics::renderBillboard(BillboardGraphicsComponent* gr, Entity* e)
         if (!quad2dGeometry) return;
     }
 
-    Material* mat = gr->getMaterial();
-    if(!mat) return;
+    Material* mat = packet.material;
 
-    billboardShader->use();
+    // Picking has its own shader and does not blend
+    bool blend = !shader;
+    if(!shader) shader = billboardShader.get();
 
-    billboardShader->setMoveMatrix(gr->getMoveMatrix());
-    billboardShader->setViewMatrix(camera->getVMatrix());
-    billboardShader->setViewProjectionMatrix(camera->getVPMatrix());
-    billboardShader->doUniforms(e);
+    shader->use();
 
-    renderer->enableBlending(true);
-    renderer->renderGeometry(quad2dGeometry.get(), mat, billboardShader.get());
-    renderer->enableBlending(false);
+    shader->setMoveMatrix(packet.moveMatrix);
+    shader->setViewMatrix(snapshot.viewMatrix);
+    shader->setViewProjectionMatrix(snapshot.vpMatrix);
+    billboardUniforms->setVec2(billboardOffsetField, packet.screenOffset);
+    billboardUniforms->setVec2(billboardSizeField, packet.screenSize);
+    shader->applyUniformBlock(billboardUniforms.get());
+    if (packet.uniformSource)
+        shader->doUniforms(packet.uniformSource);
+
+    if (blend) renderer->enableBlending(true);
+    renderer->renderGeometry(quad2dGeometry.get(), mat, shader);
+    if (blend) renderer->enableBlending(false);
 
     return;
 }
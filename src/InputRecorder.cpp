@@ -0,0 +1,337 @@
+#include "InputRecorder.h"
+#include "common/Logger.h"
+
+#include <SDL2/SDL.h>
+#include <cstring>
+#include <algorithm>
+
+namespace Arya
+{
+    static const uint32_t recordingMagic = ('A' << 0) | ('r' << 8) | ('I' << 16) | ('n' << 24);
+    static const uint32_t recordingVersion = 1;
+
+    enum RecordType
+    {
+        RECORD_FRAME = 1,
+        RECORD_EVENT = 2,
+        RECORD_MOUSE = 3
+    };
+
+    InputRecorder::InputRecorder()
+    {
+        recording = false;
+        replaying = false;
+        readPos = 0;
+        replayWidth = replayHeight = 0;
+        frameCount = 0;
+        lastMouseX = lastMouseY = 0;
+    }
+
+    InputRecorder::~InputRecorder()
+    {
+        stopRecording();
+    }
+
+    bool InputRecorder::startRecording(const string& filename, int windowWidth, int windowHeight)
+    {
+        stopRecording();
+        if (replaying)
+        {
+            LogWarning << "Can not record input during a replay" << endLog;
+            return false;
+        }
+        file.open(filename.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            LogError << "Could not open input recording " << filename << endLog;
+            return false;
+        }
+        put<uint32_t>(recordingMagic);
+        put<uint32_t>(recordingVersion);
+        put<uint32_t>(windowWidth);
+        put<uint32_t>(windowHeight);
+        recording = true;
+        LogInfo << "Recording input to " << filename << endLog;
+        return true;
+    }
+
+    void InputRecorder::stopRecording()
+    {
+        if (!recording) return;
+        recording = false;
+        file.close();
+    }
+
+    bool InputRecorder::startReplay(const string& filename)
+    {
+        stopRecording();
+        std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+        if (!in.is_open())
+        {
+            LogError << "Could not open input recording " << filename << endLog;
+            return false;
+        }
+        data.resize((size_t)in.tellg());
+        in.seekg(0);
+        in.read(data.data(), data.size());
+
+        readPos = 0;
+        if (get<uint32_t>() != recordingMagic || get<uint32_t>() != recordingVersion)
+        {
+            LogError << "Not a valid input recording: " << filename << endLog;
+            data.clear();
+            return false;
+        }
+        replayWidth = (int)get<uint32_t>();
+        replayHeight = (int)get<uint32_t>();
+        frameCount = 0;
+        replaying = true;
+        LogInfo << "Replaying input from " << filename << endLog;
+        return true;
+    }
+
+    void InputRecorder::stopReplay()
+    {
+        replaying = false;
+        data.clear();
+        readPos = 0;
+    }
+
+    template<typename T> T InputRecorder::get()
+    {
+        T value = T();
+        if (readPos + sizeof(T) > data.size())
+        {
+            //Cut off, for example when the game crashed while recording
+            readPos = data.size();
+            return value;
+        }
+        memcpy(&value, &data[readPos], sizeof(T));
+        readPos += sizeof(T);
+        return value;
+    }
+
+    uint8_t InputRecorder::peekType() const
+    {
+        return (readPos < data.size() ? (uint8_t)data[readPos] : 0);
+    }
+
+    bool InputRecorder::nextFrame(float& elapsed)
+    {
+        if (recording)
+        {
+            put<uint8_t>(RECORD_FRAME);
+            put<float>(elapsed);
+        }
+        if (!replaying) return true;
+
+        //Whatever this frame did not use of the previous one is skipped
+        while (readPos < data.size() && peekType() != RECORD_FRAME)
+        {
+            SDL_Event event;
+            if (peekType() == RECORD_MOUSE)
+            {
+                int x, y;
+                getMouseState(x, y);
+            }
+            else if (!replayEvent(event))
+                readPos = data.size();
+        }
+        if (readPos >= data.size()) return false;
+
+        readPos++;
+        elapsed = get<float>();
+        frameCount++;
+        return true;
+    }
+
+    void InputRecorder::recordEvent(const SDL_Event& event)
+    {
+        if (!recording) return;
+        put<uint8_t>(RECORD_EVENT);
+        put<uint32_t>(event.type);
+        put<uint32_t>(event.common.timestamp);
+        switch (event.type)
+        {
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+                put<int32_t>(event.key.keysym.scancode);
+                put<int32_t>(event.key.keysym.sym);
+                put<uint16_t>(event.key.keysym.mod);
+                put<uint8_t>(event.key.state);
+                put<uint8_t>(event.key.repeat);
+                break;
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP:
+                put<uint8_t>(event.button.button);
+                put<uint8_t>(event.button.state);
+                put<uint8_t>(event.button.clicks);
+                put<int16_t>(event.button.x);
+                put<int16_t>(event.button.y);
+                break;
+            case SDL_MOUSEMOTION:
+                put<uint32_t>(event.motion.state);
+                put<int16_t>(event.motion.x);
+                put<int16_t>(event.motion.y);
+                put<int16_t>(event.motion.xrel);
+                put<int16_t>(event.motion.yrel);
+                break;
+            case SDL_MOUSEWHEEL:
+                put<int16_t>(event.wheel.x);
+                put<int16_t>(event.wheel.y);
+                put<uint8_t>(event.wheel.direction);
+                break;
+            case SDL_TEXTINPUT:
+                {
+                    uint8_t length = (uint8_t)strnlen(event.text.text, sizeof(event.text.text));
+                    put<uint8_t>(length);
+                    file.write(event.text.text, length);
+                }
+                break;
+            case SDL_TEXTEDITING:
+                {
+                    uint8_t length = (uint8_t)strnlen(event.edit.text, sizeof(event.edit.text));
+                    put<uint8_t>(length);
+                    file.write(event.edit.text, length);
+                    put<int32_t>(event.edit.start);
+                    put<int32_t>(event.edit.length);
+                }
+                break;
+            case SDL_CONTROLLERDEVICEADDED:
+            case SDL_CONTROLLERDEVICEREMOVED:
+                put<int32_t>(event.cdevice.which);
+                break;
+            case SDL_CONTROLLERBUTTONDOWN:
+            case SDL_CONTROLLERBUTTONUP:
+                put<int32_t>(event.cbutton.which);
+                put<uint8_t>(event.cbutton.button);
+                put<uint8_t>(event.cbutton.state);
+                break;
+            case SDL_CONTROLLERAXISMOTION:
+                put<int32_t>(event.caxis.which);
+                put<uint8_t>(event.caxis.axis);
+                put<int16_t>(event.caxis.value);
+                break;
+            case SDL_WINDOWEVENT:
+                put<uint8_t>(event.window.event);
+                put<int32_t>(event.window.data1);
+                put<int32_t>(event.window.data2);
+                break;
+            default:
+                break;
+        }
+    }
+
+    bool InputRecorder::replayEvent(SDL_Event& event)
+    {
+        if (!replaying || peekType() != RECORD_EVENT) return false;
+        readPos++;
+        return readEvent(event);
+    }
+
+    bool InputRecorder::readEvent(SDL_Event& event)
+    {
+        memset(&event, 0, sizeof(event));
+        event.type = get<uint32_t>();
+        event.common.timestamp = get<uint32_t>();
+        switch (event.type)
+        {
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+                event.key.keysym.scancode = (SDL_Scancode)get<int32_t>();
+                event.key.keysym.sym = get<int32_t>();
+                event.key.keysym.mod = get<uint16_t>();
+                event.key.state = get<uint8_t>();
+                event.key.repeat = get<uint8_t>();
+                break;
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP:
+                event.button.button = get<uint8_t>();
+                event.button.state = get<uint8_t>();
+                event.button.clicks = get<uint8_t>();
+                event.button.x = get<int16_t>();
+                event.button.y = get<int16_t>();
+                lastMouseX = event.button.x;
+                lastMouseY = event.button.y;
+                break;
+            case SDL_MOUSEMOTION:
+                event.motion.state = get<uint32_t>();
+                event.motion.x = get<int16_t>();
+                event.motion.y = get<int16_t>();
+                event.motion.xrel = get<int16_t>();
+                event.motion.yrel = get<int16_t>();
+                lastMouseX = event.motion.x;
+                lastMouseY = event.motion.y;
+                break;
+            case SDL_MOUSEWHEEL:
+                event.wheel.x = get<int16_t>();
+                event.wheel.y = get<int16_t>();
+                event.wheel.direction = get<uint8_t>();
+                break;
+            case SDL_TEXTINPUT:
+            case SDL_TEXTEDITING:
+                {
+                    char* text = (event.type == SDL_TEXTINPUT ? event.text.text : event.edit.text);
+                    size_t length = std::min((size_t)get<uint8_t>(), sizeof(event.text.text) - 1);
+                    length = std::min(length, data.size() - readPos);
+                    memcpy(text, &data[readPos], length);
+                    readPos += length;
+                    if (event.type == SDL_TEXTEDITING)
+                    {
+                        event.edit.start = get<int32_t>();
+                        event.edit.length = get<int32_t>();
+                    }
+                }
+                break;
+            case SDL_CONTROLLERDEVICEADDED:
+            case SDL_CONTROLLERDEVICEREMOVED:
+                event.cdevice.which = get<int32_t>();
+                break;
+            case SDL_CONTROLLERBUTTONDOWN:
+            case SDL_CONTROLLERBUTTONUP:
+                event.cbutton.which = get<int32_t>();
+                event.cbutton.button = get<uint8_t>();
+                event.cbutton.state = get<uint8_t>();
+                break;
+            case SDL_CONTROLLERAXISMOTION:
+                event.caxis.which = get<int32_t>();
+                event.caxis.axis = get<uint8_t>();
+                event.caxis.value = get<int16_t>();
+                break;
+            case SDL_WINDOWEVENT:
+                event.window.event = get<uint8_t>();
+                event.window.data1 = get<int32_t>();
+                event.window.data2 = get<int32_t>();
+                break;
+            default:
+                LogWarning << "Unknown event in input recording: " << event.type << endLog;
+                return false;
+        }
+        return true;
+    }
+
+    void InputRecorder::getMouseState(int& x, int& y)
+    {
+        if (replaying)
+        {
+            //The position of the last mouse event when the
+            //replay does not read the mouse where the recording did
+            if (peekType() == RECORD_MOUSE)
+            {
+                readPos++;
+                lastMouseX = get<int16_t>();
+                lastMouseY = get<int16_t>();
+            }
+            x = lastMouseX;
+            y = lastMouseY;
+            return;
+        }
+        SDL_GetMouseState(&x, &y);
+        if (recording)
+        {
+            put<uint8_t>(RECORD_MOUSE);
+            put<int16_t>(x);
+            put<int16_t>(y);
+        }
+    }
+}
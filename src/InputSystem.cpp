@@ -1,4 +1,5 @@
 #include "InputSystem.h"
+#include "InputRecorder.h"
 #include "common/Logger.h"
 #include <algorithm>
 #include <string>
@@ -67,6 +68,7 @@ struct InputSystem::Bindings{
     CallbackChainElement<bool(const MousePos&, int, int)> mouseMove;
     CallbackChainElement<bool(int, const MousePos&)> mouseWheel;
     CallbackChainElement<bool(const char*)> textInput;
+    CallbackChainElement<bool(const MousePos&)> mouseLatch;
 
     map<InputKey, CallbackChainElement<bool(bool,const MousePos&)>> keys;
     map<InputButton, CallbackChainElement<bool(bool)>> buttons;
@@ -77,6 +79,10 @@ InputSystem::InputSystem()
     bindings = make_unique<Bindings>();
 
     windowWidth = 0; windowHeight = 0;
+    recorder = 0;
+    coalesceMotion = false;
+    hasPendingMotion = false;
+    hasPendingWheel = false;
     if(keyMap.empty()) {
         //Note that a-z and 0-9 are taken care of separately
         //All strings must be lowercase!
@@ -215,6 +221,42 @@ InputBinding InputSystem::bindTextInput(function<bool(const char*)> f, CHAIN_POS
     return x;
 }
 
+InputBinding InputSystem::bindMouseLatch(function<bool(const MousePos&)> f, CHAIN_POS pos)
+{
+    return bindings->mouseLatch.addNew(f, pos);
+}
+
+void InputSystem::latchMouse()
+{
+    if (!bindings->mouseLatch.next) return;
+
+    //Let SDL read the newest state from the OS. The new events stay queued
+    //and are handled in the next frame
+    SDL_PumpEvents();
+
+    MousePos mousePos;
+    getMouseState(mousePos.x, mousePos.y);
+    mousePos.y = windowHeight - mousePos.y;
+    mousePos.nX = -1.0f + (2.0f * mousePos.x) / float(windowWidth);
+    mousePos.nY = -1.0f + (2.0f * mousePos.y) / float(windowHeight);
+
+    auto elem = bindings->mouseLatch.next;
+    while (elem)
+    {
+        if (elem->f(mousePos))
+            break;
+        elem = elem->next;
+    }
+}
+
+void InputSystem::getMouseState(int& x, int& y)
+{
+    if (recorder)
+        recorder->getMouseState(x, y);
+    else
+        SDL_GetMouseState(&x, &y);
+}
+
 MOUSEBUTTON translateButton(Uint8 btn)
 {
     if( btn == SDL_BUTTON_LEFT )   return MOUSEBUTTON_LEFT;
@@ -224,6 +266,72 @@ MOUSEBUTTON translateButton(Uint8 btn)
 }
 
 void InputSystem::handleInputEvent(const SDL_Event& event)
+{
+    if (coalesceMotion)
+    {
+        if (event.type == SDL_MOUSEMOTION)
+        {
+            if (hasPendingMotion)
+            {
+                SDL_MouseMotionEvent& motion = pendingMotion.motion;
+                motion.timestamp = event.motion.timestamp;
+                motion.state = event.motion.state;
+                motion.x = event.motion.x;
+                motion.y = event.motion.y;
+                motion.xrel += event.motion.xrel;
+                motion.yrel += event.motion.yrel;
+            }
+            else
+                pendingMotion = event;
+            hasPendingMotion = true;
+            return;
+        }
+        if (event.type == SDL_MOUSEWHEEL)
+        {
+            //Flipped and normal deltas can not be summed
+            if (hasPendingWheel && pendingWheel.wheel.direction != event.wheel.direction)
+                flushInput();
+            if (hasPendingWheel)
+            {
+                pendingWheel.wheel.timestamp = event.wheel.timestamp;
+                pendingWheel.wheel.x += event.wheel.x;
+                pendingWheel.wheel.y += event.wheel.y;
+            }
+            else
+                pendingWheel = event;
+            hasPendingWheel = true;
+            return;
+        }
+        flushInput();
+    }
+    dispatchEvent(event);
+}
+
+void InputSystem::setCoalesceMotion(bool coalesce)
+{
+    if (!coalesce)
+        flushInput();
+    coalesceMotion = coalesce;
+}
+
+void InputSystem::flushInput()
+{
+    //Copies, a binding could handle new input
+    if (hasPendingMotion)
+    {
+        hasPendingMotion = false;
+        SDL_Event event = pendingMotion;
+        dispatchEvent(event);
+    }
+    if (hasPendingWheel)
+    {
+        hasPendingWheel = false;
+        SDL_Event event = pendingWheel;
+        dispatchEvent(event);
+    }
+}
+
+void InputSystem::dispatchEvent(const SDL_Event& event)
 {
     MousePos mousePos;
     switch (event.type) {
@@ -237,7 +345,7 @@ void InputSystem::handleInputEvent(const SDL_Event& event)
             mousePos.y = windowHeight - event.motion.y;
             break;
         default:
-            SDL_GetMouseState(&mousePos.x, &mousePos.y);
+            getMouseState(mousePos.x, mousePos.y);
             break;
     }
     mousePos.nX = -1.0f + (2.0f * mousePos.x) / float(windowWidth);
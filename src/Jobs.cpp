@@ -0,0 +1,259 @@
+#include "Jobs.h"
+#include "common/Logger.h"
+
+namespace Arya
+{
+    //0 for the main thread and any thread that is not a worker
+    static thread_local int currentThreadIndex = 0;
+
+    JobSystem::JobSystem() : pendingJobs(0), running(false)
+    {
+        mainThreadId = std::this_thread::get_id();
+        queues.emplace_back(new JobQueue);
+    }
+
+    JobSystem::~JobSystem()
+    {
+        shutdown();
+    }
+
+    bool JobSystem::init(int threadCount)
+    {
+        if (running) return true;
+
+        if (threadCount < 0)
+        {
+            threadCount = (int)std::thread::hardware_concurrency() - 1;
+            if (threadCount < 0) threadCount = 0;
+        }
+
+        running = true;
+        mainThreadId = std::this_thread::get_id();
+        for (int i = 0; i < threadCount; ++i)
+            queues.emplace_back(new JobQueue);
+        for (int i = 0; i < threadCount; ++i)
+            threads.push_back(std::thread([this, i]() { workerLoop(i + 1); }));
+
+        LogInfo << "Job system started with " << threadCount << " worker threads" << endLog;
+        return true;
+    }
+
+    void JobSystem::shutdown()
+    {
+        if (!running) return;
+
+        //Let the main thread finish what is left
+        while (runOneJob(0) || runMainThreadJob()) {}
+
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            running = false;
+        }
+        wakeCondition.notify_all();
+        for (auto& t : threads)
+            t.join();
+        threads.clear();
+        queues.resize(1);
+    }
+
+    int JobSystem::getThreadIndex()
+    {
+        return currentThreadIndex;
+    }
+
+    void JobSystem::run(function<void()> func, JobCounter* counter, JobCounter* dependency, JobAffinity affinity)
+    {
+        if (counter) counter->count++;
+        Job job{std::move(func), counter, affinity};
+
+        if (dependency)
+        {
+            std::lock_guard<std::mutex> lock(dependency->mutex);
+            if (dependency->count > 0)
+            {
+                //Queued by finishJob when the dependency is done
+                std::lock_guard<std::mutex> waitingLock(waitingMutex);
+                unsigned int slot;
+                if (freeWaitingJobs.empty())
+                {
+                    slot = waitingJobs.size();
+                    waitingJobs.push_back(std::move(job));
+                }
+                else
+                {
+                    slot = freeWaitingJobs.back();
+                    freeWaitingJobs.pop_back();
+                    waitingJobs[slot] = std::move(job);
+                }
+                dependency->dependents.push_back(slot);
+                return;
+            }
+        }
+        push(std::move(job));
+    }
+
+    void JobSystem::push(Job job)
+    {
+        if (job.affinity == JOB_MAIN_THREAD)
+        {
+            std::lock_guard<std::mutex> lock(mainQueue.mutex);
+            mainQueue.jobs.push_back(std::move(job));
+            return;
+        }
+
+        unsigned int index = currentThreadIndex;
+        if (index >= queues.size()) index = 0;
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->jobs.push_back(std::move(job));
+        }
+        pendingJobs++;
+        {
+            //Taking the lock prevents a missed wakeup between the
+            //check of pendingJobs and the wait of a worker
+            std::lock_guard<std::mutex> lock(wakeMutex);
+        }
+        wakeCondition.notify_one();
+    }
+
+    bool JobSystem::popJob(unsigned int threadIndex, Job& job)
+    {
+        //Own queue first, newest job first
+        {
+            JobQueue& own = *queues[threadIndex];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty())
+            {
+                job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                return true;
+            }
+        }
+        //Steal the oldest job of another thread
+        unsigned int count = queues.size();
+        for (unsigned int i = 1; i < count; ++i)
+        {
+            JobQueue& other = *queues[(threadIndex + i) % count];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.jobs.empty())
+            {
+                job = std::move(other.jobs.front());
+                other.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool JobSystem::runOneJob(unsigned int threadIndex)
+    {
+        Job job;
+        if (!popJob(threadIndex, job)) return false;
+        pendingJobs--;
+        job.func();
+        finishJob(job.counter);
+        return true;
+    }
+
+    bool JobSystem::runMainThreadJob()
+    {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(mainQueue.mutex);
+            if (mainQueue.jobs.empty()) return false;
+            job = std::move(mainQueue.jobs.front());
+            mainQueue.jobs.pop_front();
+        }
+        job.func();
+        finishJob(job.counter);
+        return true;
+    }
+
+    void JobSystem::runMainThreadJobs()
+    {
+        //Jobs that are queued by these jobs wait for the next call
+        unsigned int count;
+        {
+            std::lock_guard<std::mutex> lock(mainQueue.mutex);
+            count = mainQueue.jobs.size();
+        }
+        for (unsigned int i = 0; i < count; ++i)
+            if (!runMainThreadJob()) break;
+    }
+
+    void JobSystem::finishJob(JobCounter* counter)
+    {
+        if (!counter) return;
+
+        //The count is changed under the lock so that run either sees the
+        //counter done or adds a dependent that is released here
+        vector<unsigned int> ready;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            if (--counter->count == 0)
+                ready.swap(counter->dependents);
+        }
+        for (unsigned int slot : ready)
+        {
+            Job job;
+            {
+                std::lock_guard<std::mutex> lock(waitingMutex);
+                job = std::move(waitingJobs[slot]);
+                waitingJobs[slot].func = nullptr;
+                freeWaitingJobs.push_back(slot);
+            }
+            push(std::move(job));
+        }
+    }
+
+    void JobSystem::workerLoop(unsigned int threadIndex)
+    {
+        currentThreadIndex = threadIndex;
+        while (true)
+        {
+            if (runOneJob(threadIndex)) continue;
+
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCondition.wait(lock, [this]() { return !running || pendingJobs > 0; });
+            if (!running) break;
+        }
+    }
+
+    void JobSystem::wait(JobCounter& counter)
+    {
+        unsigned int index = currentThreadIndex;
+        if (index >= queues.size()) index = 0;
+        bool mainThread = isMainThread();
+        while (counter.count > 0)
+        {
+            if (mainThread && runMainThreadJob()) continue;
+            if (!runOneJob(index))
+                std::this_thread::yield();
+        }
+        //finishJob may still hold the lock after the count reached zero,
+        //after this the counter can be destroyed
+        std::lock_guard<std::mutex> lock(counter.mutex);
+    }
+
+    void JobSystem::parallelFor(unsigned int count, unsigned int grainSize, const function<void(unsigned int, unsigned int)>& func)
+    {
+        if (count == 0) return;
+        if (grainSize == 0) grainSize = 1;
+
+        //Not worth the overhead
+        if (count <= grainSize || threads.empty())
+        {
+            for (unsigned int begin = 0; begin < count; begin += grainSize)
+                func(begin, (begin + grainSize < count ? begin + grainSize : count));
+            return;
+        }
+
+        JobCounter counter;
+        for (unsigned int begin = 0; begin < count; begin += grainSize)
+        {
+            unsigned int end = (begin + grainSize < count ? begin + grainSize : count);
+            run([&func, begin, end]() { func(begin, end); }, &counter);
+        }
+        wait(counter);
+    }
+}
@@ -12,4 +12,6 @@ namespace Arya
     MaterialManager* Locator::materialManager = 0;
     TextureManager* Locator::textureManager = 0;
     Audio* Locator::audio = 0;
+    Preloader* Locator::preloader = 0;
+    JobSystem* Locator::jobSystem = 0;
 }
@@ -2,6 +2,7 @@
 #include "Locator.h"
 #include "Textures.h"
 #include "Files.h"
+#include "Preload.h"
 #include "common/Logger.h"
 
 namespace Arya
@@ -56,6 +57,7 @@ namespace Arya
 
         shared_ptr<Material> mat = make_shared<Material>(Locator::getTextureManager().getTexture(filename));
         addResource(filename, mat);
+        Locator::getPreloader().record(PRELOAD_MATERIAL, filename);
 
         Locator::getFileSystem().releaseFile(materialFile);
         return mat;
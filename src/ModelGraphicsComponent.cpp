@@ -1,5 +1,6 @@
 #include "ModelGraphicsComponent.h"
 #include "Models.h"
+#include "AnimationVertex.h"
 
 namespace Arya
 {
@@ -30,12 +31,45 @@ namespace Arya
         if (animState) animState->setAnimationTime(time);
     }
 
+    int ModelGraphicsComponent::getAnimationId(const char* name) const
+    {
+        if (!model || model->modelType != VertexAnimated) return -1;
+        auto data = static_cast<VertexAnimationData*>(model->getAnimationData());
+        return data ? data->getClipId(name) : -1;
+    }
+
+    void ModelGraphicsComponent::setAnimation(int animationId)
+    {
+        if (animState && model->modelType == VertexAnimated)
+            static_cast<VertexAnimationState*>(animState.get())->setAnimation(animationId);
+    }
+
+    void ModelGraphicsComponent::setSharedAnimation(int animationId)
+    {
+        if (animState && model->modelType == VertexAnimated)
+            static_cast<VertexAnimationState*>(animState.get())->setSharedAnimation(animationId);
+    }
+
+    bool ModelGraphicsComponent::getLocalBounds(vec3& boxMin, vec3& boxMax) const
+    {
+        if (!model) return false;
+        boxMin = model->getBoundingMin();
+        boxMax = model->getBoundingMax();
+        return true;
+    }
+
     void ModelGraphicsComponent::setModel(shared_ptr<Model> newModel)
     {
-        //Set new model and get a new animation state object
-        //(subclass of AnimationState)
+        if (newModel == model) return;
+
+        bool sameAnimations = model && newModel &&
+            model->getAnimationData() == newModel->getAnimationData();
         model = newModel;
+        boundsChanged();
+        if (sameAnimations) return;
 
+        //Get a new animation state object
+        //(subclass of AnimationState)
         animState.reset();
         if (model)
             animState = model->createAnimationState();
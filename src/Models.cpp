@@ -3,6 +3,7 @@
 #include "Geometry.h"
 #include "Locator.h"
 #include "Materials.h"
+#include "Preload.h"
 #include "AnimationVertex.h"
 #include "Shaders.h"
 #include "common/Logger.h"
@@ -104,7 +105,10 @@ namespace Arya
         for (auto mesh : meshes)
             copy->meshes.push_back(new Mesh(*mesh));
         copy->shaderProgram = shaderProgram;
+        copy->instancedShaderProgram = instancedShaderProgram;
         copy->animationData = animationData;
+        copy->boundingMin = boundingMin;
+        copy->boundingMax = boundingMax;
 
         return copy;
     }
@@ -114,6 +118,7 @@ namespace Arya
 
     ModelManager::ModelManager()
     {
+        maxFrameTexels = 0;
     }
 
     ModelManager::~ModelManager()
@@ -134,17 +139,69 @@ namespace Arya
         }
         staticShader->enableUniform(UNIFORM_MOVEMATRIX | UNIFORM_VPMATRIX | UNIFORM_TEXTURE);
 
-        animatedShader = make_shared<ShaderProgram>(
-                "../shaders/vertexanimatedmodel.vert",
-                "../shaders/vertexanimatedmodel.frag");
-        if (!animatedShader->isValid()) {
-            animatedShader = nullptr;
-            LogError << "Could not load vertexanimatedmodel shader." << endLog;
+        // TODO - Move this out of the engine
+        // Entities can set their own tint with a UniformBlock of this layout
+        auto tintLayout = make_shared<UniformLayout>();
+        tintLayout->add("tintColor", UNIFORMTYPE_VEC3);
+        auto tintDefaults = make_shared<UniformBlock>(tintLayout);
+        tintDefaults->setVec3(tintLayout->getOffset("tintColor"), vec3(0.5, 1.0, 0.5));
+
+        // Animated models, variants are compiled when first requested,
+        // for example the shadow variants by Graphics
+        modelShaders = make_shared<ShaderVariants>(
+                "../shaders/model.vert",
+                "../shaders/model.frag");
+        modelShaders->setSetup([tintDefaults](ShaderProgram* shader, std::uint32_t features) {
+                bool instanced = (features & FEATURE_INSTANCED);
+                bool frameTexture = instanced || (features & FEATURE_FRAMETEXTURE);
+                bool animated = frameTexture || (features & FEATURE_ANIMATED);
+
+                shader->enableUniform(UNIFORM_VPMATRIX);
+                if (!instanced)
+                    shader->enableUniform(UNIFORM_MOVEMATRIX);
+                if (animated && !instanced)
+                    shader->enableUniform(UNIFORM_ANIM_INTERPOL);
+                if (frameTexture)
+                    shader->enableUniform(UNIFORM_FRAMEDATA);
+                if (frameTexture && !instanced)
+                    shader->enableUniform(UNIFORM_ANIM_FRAMES);
+                if (features & FEATURE_SHADOW_ONLY)
+                    return;
+
+                shader->enableUniform(UNIFORM_VIEWMATRIX | UNIFORM_TEXTURE | UNIFORM_MATERIALPARAMS);
+                if (features & FEATURE_TINT)
+                {
+                    shader->setUniformDefaults(tintDefaults);
+                    if (instanced)
+                        shader->setInstanceBlock("InstanceUniforms", 0);
+                }
+                if (features & FEATURE_FOG)
+                {
+                    shader->use();
+                    shader->setUniform3fv("fogColor", vec3(0.5f, 0.5f, 0.6f));
+                    shader->setUniform2fv("fogRange", vec2(100.0f, 400.0f));
+                }
+                });
+
+        animatedShader = modelShaders->get(FEATURE_ANIMATED | FEATURE_TINT);
+        if (!animatedShader) {
+            LogError << "Could not load animated model shader." << endLog;
             return false;
         }
-        animatedShader->enableUniform(UNIFORM_MOVEMATRIX | UNIFORM_VIEWMATRIX | UNIFORM_VPMATRIX | UNIFORM_TEXTURE | UNIFORM_MATERIALPARAMS | UNIFORM_ANIM_INTERPOL);
-        // TODO - Move this out of the engine
-        animatedShader->addUniform3fv("tintColor", [](ShaderUniformBase*){ return vec3(0.5, 1.0, 0.5); });
+
+        //Optional: without these, animated models use a VAO per frame
+        maxFrameTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxFrameTexels);
+
+        textureAnimatedShader = modelShaders->get(FEATURE_FRAMETEXTURE | FEATURE_TINT);
+        if (!textureAnimatedShader)
+            LogWarning << "Could not load frame texture shader. Using a VAO per animation frame." << endLog;
+        instancedShader = (textureAnimatedShader ? modelShaders->get(FEATURE_INSTANCED | FEATURE_TINT) : nullptr);
+        if (instancedShader && !instancedShader->hasInstanceBlock())
+        {
+            instancedShader = nullptr;
+            LogWarning << "Could not bind instance uniforms. Instancing disabled." << endLog;
+        }
 
         primitiveShader = make_shared<ShaderProgram>(
                 "../shaders/basiclighting.vert",
@@ -271,7 +328,7 @@ namespace Arya
 
                     //Only add the animation if there are actually enough frames
                     if( newAnim.startFrame < header->frameCount && newAnim.endFrame < header->frameCount )
-                        animData->animations.insert(make_pair(nameBuf, newAnim));
+                        animData->addClip(nameBuf, newAnim);
                     //else
                     //    LogDebug << "(not enough frames) ";
                 }
@@ -291,6 +348,38 @@ namespace Arya
             model->boundingMin.z = boundingBoxData[4];
             model->boundingMax.z = boundingBoxData[5];
 
+            //The frame that every frame interpolates to
+            //The endFrame of one animation will have startFrame as 'nextFrame'
+            vector<int> nextFrames(header->frameCount);
+            for(int f = 0; f < header->frameCount; ++f)
+            {
+                nextFrames[f] = (f+1)%header->frameCount;
+                if(animData)
+                {
+                    for(auto& anim : animData->getClips())
+                    {
+                        if( anim.endFrame == f )
+                        {
+                            nextFrames[f] = anim.startFrame;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            //Store the frames of animated models in a texture when all submeshes fit
+            bool useFrameTexture = (animData && header->frameCount > 1 && textureAnimatedShader);
+            for(int s = 0; useFrameTexture && s < header->submeshCount; ++s)
+            {
+                if( 2LL * header->frameCount * header->submesh[s].vertexCount > maxFrameTexels )
+                    useFrameTexture = false;
+            }
+            if(useFrameTexture)
+            {
+                model->shaderProgram = textureAnimatedShader;
+                model->instancedShaderProgram = instancedShader;
+            }
+
             //Parse all geometries
             for(int s = 0; s < header->submeshCount; ++s)
             {
@@ -307,10 +396,13 @@ namespace Arya
 
                 int floatCount = header->submesh[s].hasNormals ? 8 : 5;
                 int frameBytes = geometry->vertexCount * floatCount * sizeof(GLfloat);
+                char* vertexData = modelfile->getData() + header->submesh[s].bufferOffset;
 
+                //With a frame texture, only the texture coordinates of the
+                //first frame are read from the vertex buffer
                 geometry->createVertexBuffer();
-                geometry->setVertexBufferData(geometry->frameCount * frameBytes,
-                        modelfile->getData() + header->submesh[s].bufferOffset);
+                geometry->setVertexBufferData((useFrameTexture ? 1 : geometry->frameCount) * frameBytes,
+                        vertexData);
 
                 if( geometry->indexCount > 0 )
                 {
@@ -319,13 +411,22 @@ namespace Arya
                             modelfile->getData() + header->submesh[s].indexbufferOffset);
                 }
 
-                //Create a VAO for every frame
-                geometry->createVAOs(geometry->frameCount);
                 int stride = floatCount * sizeof(GLfloat);
 
-                if( geometry->frameCount == 1 )
+                if( useFrameTexture )
+                {
+                    //Animated, all frames in a texture
+                    geometry->createVAOs(1);
+                    geometry->bindVAO(0);
+                    geometry->setVAOdata(1, 2, stride, 12);//tex
+                    geometry->createInstanceBuffer(5);
+                    if( !geometry->createFrameTexture((GLfloat*)vertexData, floatCount, nextFrames) )
+                        LogError << "Could not create frame texture for " << filename << endLog;
+                }
+                else if( geometry->frameCount == 1 )
                 {
                     //Not animated
+                    geometry->createVAOs(1);
                     geometry->bindVAO(0);
                     geometry->setVAOdata(0, 3, stride, 0); //pos
                     geometry->setVAOdata(1, 2, stride, 12);//tex
@@ -334,24 +435,11 @@ namespace Arya
                 }
                 else
                 {
-                    //Animated
-                    //We actually have to parse the list of animations here
-                    //because the endFrame of one animation will have startFrame as 'nextFrame'
+                    //Animated, a VAO for every frame
+                    geometry->createVAOs(geometry->frameCount);
                     for(int f = 0; f < geometry->frameCount; ++f)
                     {
-                        int nextf = (f+1)%geometry->frameCount;
-                        if(animData)
-                        {
-                            for(auto iter : animData->animations)
-                            {
-                                if( iter.second.endFrame == f )
-                                {
-                                    nextf = iter.second.startFrame;
-                                    break;
-                                }
-                            }
-                        }
-                        
+                        int nextf = nextFrames[f];
                         geometry->bindVAO(f);
                         geometry->setVAOdata(0, 3, stride, f*frameBytes + 0); //pos
                         geometry->setVAOdata(3, 3, stride, nextf*frameBytes + 0); //next pos
@@ -366,6 +454,7 @@ namespace Arya
             }
 
             addResource(filename, model);
+            Locator::getPreloader().record(PRELOAD_MODEL, filename);
         }while(0);
 
         Locator::getFileSystem().releaseFile(modelfile);
@@ -0,0 +1,53 @@
+#include "Pool.h"
+
+namespace Arya
+{
+    FixedPool::FixedPool(size_t size, size_t alignment, size_t perBlock)
+    {
+        //Free objects hold the free list pointer
+        if (size < sizeof(FreeObject)) size = sizeof(FreeObject);
+        if (alignment < alignof(FreeObject)) alignment = alignof(FreeObject);
+        objectSize = (size + alignment - 1) / alignment * alignment;
+        objectsPerBlock = (perBlock ? perBlock : 1);
+        freeList = 0;
+    }
+
+    FixedPool::~FixedPool()
+    {
+        for (char* block : blocks)
+            ::operator delete(block);
+    }
+
+    void FixedPool::addBlock()
+    {
+        //::operator new aligns to std::max_align_t
+        char* block = static_cast<char*>(::operator new(objectSize * objectsPerBlock));
+        blocks.push_back(block);
+
+        //Thread the new objects onto the free list, first object first
+        for (size_t i = objectsPerBlock; i-- > 0; )
+        {
+            FreeObject* obj = reinterpret_cast<FreeObject*>(block + i * objectSize);
+            obj->next = freeList;
+            freeList = obj;
+        }
+    }
+
+    void* FixedPool::allocate()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeList) addBlock();
+        FreeObject* obj = freeList;
+        freeList = obj->next;
+        return obj;
+    }
+
+    void FixedPool::deallocate(void* p)
+    {
+        if (!p) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        FreeObject* obj = static_cast<FreeObject*>(p);
+        obj->next = freeList;
+        freeList = obj;
+    }
+}
@@ -0,0 +1,215 @@
+#include "Preload.h"
+#include "Files.h"
+#include "Locator.h"
+#include "Materials.h"
+#include "Models.h"
+#include "Textures.h"
+#include "common/Logger.h"
+#include <fstream>
+
+using std::ifstream;
+using std::ofstream;
+
+namespace Arya
+{
+    static const char* preloadTypeNames[] = { "file", "texture", "material", "model" };
+    static const int preloadTypeCount = 4;
+
+    static const char* manifestFilename = "preload.manifest";
+
+    Preloader::Preloader() : enabled(true)
+    {
+    }
+
+    Preloader::~Preloader()
+    {
+        //If init failed halfway
+        if( !prefetchJobs.isDone() )
+            Locator::getJobSystem().wait(prefetchJobs);
+        clearPrefetched();
+    }
+
+    string Preloader::getManifestPath() const
+    {
+        return Locator::getFileSystem().getApplicationPath() + manifestFilename;
+    }
+
+    void Preloader::record(PreloadType type, const string& name)
+    {
+        if( !enabled ) return;
+
+        string key(preloadTypeNames[type]);
+        key.push_back(' ');
+        key.append(name);
+
+        std::lock_guard<std::mutex> lock(recordMutex);
+        if( recordedKeys.insert(key).second )
+            recorded.push_back(Entry{type, name});
+    }
+
+    bool Preloader::startPrefetch()
+    {
+        if( !enabled ) return false;
+
+        ifstream manifestFile(getManifestPath().c_str());
+        if( !manifestFile.is_open() ) return false;
+
+        set<string> textureFiles;
+        string line;
+        while( std::getline(manifestFile, line) ) {
+            size_t space = line.find(' ');
+            if( space == string::npos || space + 1 >= line.size() ) continue;
+            string typeName = line.substr(0, space);
+            for(int i = 0; i < preloadTypeCount; ++i) {
+                if( typeName == preloadTypeNames[i] ) {
+                    manifest.push_back(Entry{(PreloadType)i, line.substr(space + 1)});
+                    if( i == PRELOAD_TEXTURE )
+                        textureFiles.insert(string("textures/") + manifest.back().name);
+                    break;
+                }
+            }
+        }
+
+        //The file entries are read by jobs, one per file
+        //Images among them are decoded as well
+        for(auto& entry : manifest) {
+            if( entry.type != PRELOAD_FILE ) continue;
+            Prefetched p;
+            p.filename = entry.name;
+            p.data = 0;
+            p.size = 0;
+            p.isImage = (textureFiles.find(entry.name) != textureFiles.end());
+            p.width = 0;
+            p.height = 0;
+            p.pixels = 0;
+            prefetched.push_back(p);
+        }
+
+        if( prefetched.empty() ) return true;
+
+        //Every job has its own entry, prefetched is not resized until they are done
+        JobSystem& jobs = Locator::getJobSystem();
+        for(auto& p : prefetched) {
+            Prefetched* entry = &p;
+            jobs.run([this, entry]() { prefetch(*entry); }, &prefetchJobs);
+        }
+
+        LogInfo << "Prefetching " << prefetched.size() << " files on " << jobs.getThreadCount() << " threads" << endLog;
+        return true;
+    }
+
+    void Preloader::prefetch(Prefetched& p)
+    {
+        const FileSystem& fileSystem = Locator::getFileSystem();
+        if( !fileSystem.readFromDisk(p.filename, p.data, p.size) ) {
+            p.data = 0;
+            return;
+        }
+        if( p.isImage ) {
+            ImageData image;
+            if( TextureManager::decodeImage(p.data, p.size, image) ) {
+                p.width = image.width;
+                p.height = image.height;
+                p.pixels = image.pixels;
+            }
+        }
+    }
+
+    void Preloader::finishPrefetch()
+    {
+        Locator::getJobSystem().wait(prefetchJobs);
+
+        //The FileSystem holds on to the data until uploadResources releases it
+        //These files do not pass through the disk path of getFile so
+        //they are recorded here, to keep them in the next manifest
+        FileSystem& fileSystem = Locator::getFileSystem();
+        for(auto& p : prefetched) {
+            if( p.data == 0 ) continue;
+            record(PRELOAD_FILE, p.filename);
+            heldFiles.push_back(fileSystem.addFile(p.filename, p.data, p.size));
+            p.data = 0;
+        }
+    }
+
+    void Preloader::uploadResources()
+    {
+        if( manifest.empty() ) return;
+
+        //Textures that were decoded on the background threads
+        TextureManager& textureManager = Locator::getTextureManager();
+        int textureCount = 0;
+        for(auto& p : prefetched) {
+            if( p.pixels == 0 ) continue;
+            string name = p.filename.substr(9); //strip "textures/"
+            if( !textureManager.resourceLoaded(name) ) {
+                ImageData image;
+                image.width = p.width;
+                image.height = p.height;
+                image.pixels = p.pixels;
+                textureManager.createTexture(name, image);
+                record(PRELOAD_TEXTURE, name);
+                textureCount++;
+            }
+        }
+
+        //The file data is in memory now so these do not touch the disk
+        int resourceCount = 0;
+        for(auto& entry : manifest) {
+            switch(entry.type) {
+                case PRELOAD_TEXTURE:
+                    Locator::getTextureManager().getTexture(entry.name);
+                    break;
+                case PRELOAD_MATERIAL:
+                    Locator::getMaterialManager().getMaterial(entry.name);
+                    resourceCount++;
+                    break;
+                case PRELOAD_MODEL:
+                    Locator::getModelManager().getModel(entry.name);
+                    resourceCount++;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        //Release the references held for the prefetched files
+        FileSystem& fileSystem = Locator::getFileSystem();
+        for(auto file : heldFiles)
+            fileSystem.releaseFile(file);
+        heldFiles.clear();
+
+        LogInfo << "Preloaded " << textureCount << " textures and " << resourceCount << " materials and models" << endLog;
+
+        clearPrefetched();
+        manifest.clear();
+    }
+
+    bool Preloader::writeManifest()
+    {
+        if( !enabled ) return false;
+
+        ofstream manifestFile(getManifestPath().c_str(), std::ios::trunc);
+        if( !manifestFile.is_open() ) {
+            LogWarning << "Could not write preload manifest " << getManifestPath() << endLog;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(recordMutex);
+        for(auto& entry : recorded)
+            manifestFile << preloadTypeNames[entry.type] << ' ' << entry.name << '\n';
+        return true;
+    }
+
+    void Preloader::clearPrefetched()
+    {
+        for(auto& p : prefetched) {
+            if( p.data ) delete[] p.data;
+            if( p.pixels ) {
+                ImageData image;
+                image.pixels = p.pixels;
+                TextureManager::freeImage(image);
+            }
+        }
+        prefetched.clear();
+    }
+}
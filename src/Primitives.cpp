@@ -53,6 +53,8 @@ namespace Arya
         model->shaderProgram = staticShader;
         mesh = model->createMesh();
         mesh->geometry = geometry;
+        model->boundingMin = vec3(-a, -0.5f, 0.0f);
+        model->boundingMax = vec3(a, 1.0f, 0.0f);
         addResource("triangle", model);
 
         //
@@ -83,6 +85,8 @@ namespace Arya
         model->shaderProgram = staticShader;
         mesh = model->createMesh();
         mesh->geometry = geometry;
+        model->boundingMin = vec3(-1.0f, -1.0f, 0.0f);
+        model->boundingMax = vec3(1.0f, 1.0f, 0.0f);
         addResource("quad", model);
 
         //
@@ -133,6 +137,8 @@ namespace Arya
         model->shaderProgram = staticShader;
         mesh = model->createMesh();
         mesh->geometry = geometry;
+        model->boundingMin = vec3(-1.0f, -a, 0.0f);
+        model->boundingMax = vec3(1.0f, a, 0.0f);
         addResource("hexagon", model);
 
         //
@@ -164,6 +170,8 @@ namespace Arya
         model->shaderProgram = staticShader;
         mesh = model->createMesh();
         mesh->geometry = geometry;
+        model->boundingMin = vec3(-1.0f, -1.0f, 0.0f);
+        model->boundingMax = vec3(1.0f, 1.0f, 0.0f);
         addResource("quad2d", model);
 
         //
@@ -206,6 +214,8 @@ namespace Arya
         model->shaderProgram = staticShader;
         mesh = model->createMesh();
         mesh->geometry = geometry;
+        model->boundingMin = vec3(-1.0f, -1.0f, 0.0f);
+        model->boundingMax = vec3(1.0f, 1.0f, 0.0f);
         addResource("circle", model);
 
         //
@@ -270,6 +280,8 @@ namespace Arya
         model->shaderProgram = primitiveShader;
         mesh = model->createMesh();
         mesh->geometry = geometry;
+        model->boundingMin = vec3(-a, -0.5f, 0.0f);
+        model->boundingMax = vec3(a, 1.0f, 1.0f);
         addResource("thicktriangle", model);
 
     }
@@ -17,6 +17,7 @@ RenderTarget::RenderTarget()
     frameBuffer = 0;
     texture = 0;
     depthBuffer = 0;
+    integerColor = false;
 }
 
 RenderTarget::~RenderTarget()
@@ -29,6 +30,91 @@ RenderTarget::~RenderTarget()
         glDeleteFramebuffers(1, &frameBuffer);
 }
 
+PixelReadback::PixelReadback()
+{
+    glGenBuffers(bufferCount, buffers);
+    for (int i = 0; i < bufferCount; ++i)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), 0, GL_STREAM_READ);
+        fences[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    first = 0;
+    count = 0;
+}
+
+PixelReadback::~PixelReadback()
+{
+    for (int i = 0; i < bufferCount; ++i)
+        if (fences[i])
+            glDeleteSync(fences[i]);
+    glDeleteBuffers(bufferCount, buffers);
+}
+
+bool PixelReadback::request(int x, int y)
+{
+    if (count == bufferCount) return false;
+    int index = (first + count) % bufferCount;
+
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[index]);
+    glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    count++;
+    return true;
+}
+
+bool PixelReadback::poll(unsigned int& value)
+{
+    if (count == 0) return false;
+
+    // Timeout zero: only check, never wait
+    GLenum status = glClientWaitSync(fences[first], 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+    glDeleteSync(fences[first]);
+    fences[first] = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[first]);
+    GLuint* data = (GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT);
+    bool ok = (data != 0);
+    if (data)
+    {
+        value = *data;
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    first = (first + 1) % bufferCount;
+    count--;
+    return ok;
+}
+
+UniformBuffer::UniformBuffer()
+{
+    buffer = 0;
+}
+
+UniformBuffer::~UniformBuffer()
+{
+    if (buffer)
+        glDeleteBuffers(1, &buffer);
+}
+
+void UniformBuffer::upload(const void* data, unsigned int size, unsigned int bindingPoint)
+{
+    //Created on first use, there might be no context when this is constructed
+    if (!buffer)
+        glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, data, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
+}
+
 Renderer::Renderer()
 {
 }
@@ -113,7 +199,7 @@ void Renderer::enableDepthTest(bool enable)
     glDepthFunc(enable ? GL_LESS : GL_ALWAYS);
 }
 
-shared_ptr<RenderTarget> Renderer::createRenderTarget(int width, int height, bool color, bool depth)
+shared_ptr<RenderTarget> Renderer::createRenderTarget(int width, int height, bool color, bool depth, bool integerColor)
 {
     if (width <= 0 || height <= 0) return nullptr;
     if (!color && !depth) return nullptr;
@@ -121,6 +207,7 @@ shared_ptr<RenderTarget> Renderer::createRenderTarget(int width, int height, boo
     shared_ptr<RenderTarget> target = make_shared<RenderTarget>();
     target->width = width;
     target->height = height;
+    target->integerColor = color && integerColor;
 
     glGenFramebuffers(1, &target->frameBuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, target->frameBuffer);
@@ -131,7 +218,10 @@ shared_ptr<RenderTarget> Renderer::createRenderTarget(int width, int height, boo
         glBindTexture(GL_TEXTURE_2D, target->texture);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        if (integerColor)
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
 
         glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target->texture, 0);
     }
@@ -211,6 +301,25 @@ void Renderer::setViewport(int width, int height)
     glViewport(0, 0, width, height);
 }
 
+void Renderer::setScissor(int x, int y, int width, int height)
+{
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, y, width, height);
+}
+
+void Renderer::disableScissor()
+{
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void Renderer::clearIntegerTarget()
+{
+    // glClear with a float color is undefined for integer targets
+    const GLuint zero[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, zero);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
 void Renderer::renderMesh(Mesh* mesh, ShaderProgram* shader, int frame)
 {
     if (!mesh->geometry) return;
@@ -224,13 +333,47 @@ void Renderer::renderMesh(Mesh* mesh, ShaderProgram* shader, int frame)
 
 void Renderer::renderGeometry(Geometry* geom, Material* mat, ShaderProgram* shader, int frame)
 {
-    if (frame > geom->frameCount) return;
+    if (frame >= geom->frameCount) return;
     glActiveTexture(GL_TEXTURE0);
     shader->setTexture(0);
     glBindTexture(GL_TEXTURE_2D, mat->texture->handle);
     shader->setMaterialParams(vec4(mat->specAmp,mat->specPow,mat->ambient,mat->diffuse));
 
+    if (geom->hasFrameTexture())
+    {
+        bindFrameTexture(geom, shader);
+        shader->setAnimFrames(frame, geom->getNextFrame(frame));
+    }
+
     geom->draw(frame);
 }
 
+void Renderer::renderMeshInstanced(Mesh* mesh, ShaderProgram* shader, const GeometryInstance* instances, int instanceCount)
+{
+    Geometry* geom = mesh->geometry.get();
+    if (!geom || !geom->hasFrameTexture()) return;
+
+    shared_ptr<Material> mat = mesh->material;
+    if (!mat || !mat->texture)
+        mat = Locator::getMaterialManager().getMaterial("default");
+
+    glActiveTexture(GL_TEXTURE0);
+    shader->setTexture(0);
+    glBindTexture(GL_TEXTURE_2D, mat->texture->handle);
+    shader->setMaterialParams(vec4(mat->specAmp,mat->specPow,mat->ambient,mat->diffuse));
+
+    bindFrameTexture(geom, shader);
+
+    geom->drawInstanced(instances, instanceCount);
+}
+
+void Renderer::bindFrameTexture(Geometry* geom, ShaderProgram* shader)
+{
+    // Texture unit 1 is used for the shadow map
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, geom->getFrameTexture());
+    glActiveTexture(GL_TEXTURE0);
+    shader->setFrameData(2, geom->vertexCount);
+}
+
 } // namespace Arya
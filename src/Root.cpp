@@ -1,19 +1,31 @@
 #include "common/Logger.h"
+#include "common/Trace.h"
 #include "Files.h"
+#include "FramePacer.h"
+#include "FrameSnapshot.h"
 #include "Graphics.h"
 #include "CommandHandler.h"
 #include "Console.h"
 #include "InputSystem.h"
+#include "InputRecorder.h"
+#include "Jobs.h"
 #include "Interface.h"
 #include "Locator.h"
 #include "Materials.h"
 #include "Models.h"
+#include "Preload.h"
 #include "Root.h"
 #include "Textures.h"
 #include "World.h"
 #include "Audio.h"
+#include "TripleBuffer.h"
 
 #include <SDL2/SDL.h>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sstream>
 
 namespace Arya
 {
@@ -27,21 +39,44 @@ namespace Arya
         ~SDLValues(){}
     };
 
+    //State shared by the main thread and the simulation thread
+    struct Root::SimulationThread
+    {
+        std::thread thread;
+        //Held while the world is simulated, and by the main thread
+        //while it handles input and the interface
+        std::mutex worldMutex;
+        //The simulation thread waits until its last snapshot was taken
+        std::mutex waitMutex;
+        std::condition_variable snapshotTaken;
+        bool running;
+        TripleBuffer<FrameSnapshot> snapshots;
+    };
+
     Root::Root()
     {
         sdlValues = new SDLValues;
 
         Locator::provide(this);
 
+        preloader = new Preloader();
+        Locator::provide(preloader);
+
         fileSystem = new FileSystem();
         Locator::provide(fileSystem);
 
+        jobSystem = new JobSystem;
+        Locator::provide(jobSystem);
+        framePacer = new FramePacer;
+
         world = new World;
         interface = new Interface;
         graphics = new Graphics;
         commandHandler = new CommandHandler;
         console = new Console;
         inputSystem = new InputSystem;
+        inputRecorder = new InputRecorder;
+        inputSystem->setRecorder(inputRecorder);
         modelManager = new ModelManager;
         materialManager = new MaterialManager;
         textureManager = new TextureManager;
@@ -59,20 +94,36 @@ namespace Arya
         windowHeight = 0;
         fullscreen = false;
         timer = 0;
+        frameTraceStart = 0;
+        frameNumber = 0;
+        fixedStep = 0.0f;
+        maxSteps = 5;
+        accumulator = 0.0;
+        interpolationAlpha = 1.0f;
+        threadedSimulation = false;
+        simulation = 0;
     }
 
     Root::~Root()
     {
+        //Stops the prefetch threads if init failed halfway
+        delete preloader;
+        preloader = 0;
+        Locator::provide(preloader);
+
         delete audioManager;
         delete textureManager;
         delete materialManager;
         delete modelManager;
         delete inputSystem;
+        delete inputRecorder;
         delete console;
         delete commandHandler;
         delete graphics;
         delete interface;
         delete world;
+        delete jobSystem;
+        delete framePacer;
         delete fileSystem;
         audioManager = 0;
         textureManager = 0;
@@ -80,9 +131,12 @@ namespace Arya
         modelManager = 0;
         fileSystem = 0;
         inputSystem = 0;
+        inputRecorder = 0;
         console = 0;
         commandHandler = 0;
         world = 0;
+        jobSystem = 0;
+        framePacer = 0;
         //Unset the Locator pointers
         Locator::provide(textureManager);
         Locator::provide(materialManager);
@@ -92,6 +146,7 @@ namespace Arya
         Locator::provide(commandHandler);
         Locator::provide(world);
         Locator::provide(fileSystem);
+        Locator::provide(jobSystem);
         Locator::provide((Root*)0);
 
         if( sdlValues->context ) SDL_GL_DeleteContext(sdlValues->context);
@@ -102,6 +157,12 @@ namespace Arya
 
     bool Root::init(const char* windowTitle, int _width, int _height, bool _fullscreen)
     {
+        jobSystem->init();
+
+        //Read the files of the previous session on the job threads
+        //while SDL and OpenGL initialize
+        preloader->startPrefetch();
+
         if( SDL_Init(SDL_INIT_TIMER | SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_EVENTS) != 0 ) {
             LogError << "Failed to initialize SDL. Error message: " << SDL_GetError() << endLog;
             return false;
@@ -141,6 +202,11 @@ namespace Arya
             return false;
         }
 
+        //The swap interval belongs to the context
+        framePacer->setVsync(framePacer->getVsync());
+
+        preloader->finishPrefetch();
+
         if (!graphics->init(windowWidth, windowHeight)) return false;
         if (!textureManager->init()) return false;
         if (!materialManager->init()) return false;
@@ -151,9 +217,13 @@ namespace Arya
         inputSystem->initializeControllers();
 
         if (!console->init()) return false; //console must be after interface and inputsystem
+        bindFrameCommands();
 
         audioManager->init();
 
+        //Upload everything the previous session used in one go
+        preloader->uploadResources();
+
         return true;
     }
 
@@ -161,27 +231,301 @@ namespace Arya
     {
         LogInfo << "Game loop started." << endLog;
         loopRunning = true;
-        timer = SDL_GetTicks();
+        if (threadedSimulation)
+        {
+            threadedGameLoop(callback);
+            gameLoopStopped();
+            return;
+        }
+        //SDL_GetTicks only has millisecond resolution
+        double frequency = (double)SDL_GetPerformanceFrequency();
+        timer = SDL_GetPerformanceCounter();
+        accumulator = 0.0;
         while(loopRunning) {
-            //Calling OpenGL draw functions will queueu instructions for the GPU
-            //When calling SwapBuffers the program waits untill the GPU is done
-            //Therefore that is the moment that we should do the game logic and physics
-            //and so on and do the buffer swap afterwards.
+            uint64_t pollTime = SDL_GetPerformanceCounter();
+            float elapsed = float((pollTime - timer) / frequency);
+            timer = pollTime;
+            //A replay uses the time of the recorded frame
+            if (!inputRecorder->nextFrame(elapsed))
+                break;
+
+            //Input is handled right before the simulation so that it is
+            //used in the frame that is drawn next, and not one frame later
+            handleEvents();
+            jobSystem->runMainThreadJobs();
+            //Log messages of all threads go to the console here
+            logger.dispatchCallback();
+
+            simulate(callback, elapsed);
+            //The presentation follows the real time
+            interface->update(elapsed);
+            graphics->update(elapsed);
+
+            //The camera has moved, sample the cursor once more
+            //just before drawing
+            inputSystem->latchMouse();
             render();
 
-            int pollTime = SDL_GetTicks();
-            float elapsed = 0.001f*(pollTime - timer);
-            timer = pollTime;
+            swapBuffers();
+        }
+
+        gameLoopStopped();
+    }
+
+    void Root::gameLoopStopped()
+    {
+        preloader->writeManifest();
 
+        inputRecorder->stopRecording();
+        if (inputRecorder->isReplaying())
+        {
+            LogInfo << "Replay finished after " << inputRecorder->getFrameCount() << " frames" << endLog;
+            inputRecorder->stopReplay();
+        }
+
+        LogInfo << "Frame times\n" << framePacer->getStatsText() << endLog;
+        framePacer->writeStats(fileSystem->getApplicationPath() + "framestats.txt");
+    }
+
+    void Root::swapBuffers()
+    {
+        //Everything of this frame is done, wait for the frame limit
+        //just before the swap to keep the latency low
+        framePacer->limit();
+        SDL_GL_SwapWindow(sdlValues->window);
+        framePacer->frameDone();
+
+        if (frameTraceStart != 0)
+            traceSpan(TRACE_FRAME, frameTraceStart, frameNumber);
+        frameTraceStart = tracer.now();
+        frameNumber++;
+    }
+
+    void Root::bindFrameCommands()
+    {
+        commandHandler->bind("framestats", [this](const string& line) {
+                std::istringstream args(line);
+                string command, option;
+                args >> command >> option;
+                if (option == "reset")
+                    framePacer->resetStats();
+                else
+                    LogInfo << framePacer->getStatsText() << endLog;
+                } );
+        commandHandler->bind("vsync", [this](const string& line) {
+                std::istringstream args(line);
+                string command, mode;
+                args >> command >> mode;
+                if (mode == "off")
+                    framePacer->setVsync(VSYNC_OFF);
+                else if (mode == "on")
+                    framePacer->setVsync(VSYNC_ON);
+                else if (mode == "adaptive")
+                    framePacer->setVsync(VSYNC_ADAPTIVE);
+                else
+                    LogInfo << "Usage: vsync on|off|adaptive" << endLog;
+                } );
+        commandHandler->bind("inputlatency", [this](const string& line) {
+                std::istringstream args(line);
+                string command, mode;
+                args >> command >> mode;
+                if (mode == "on" || mode == "off")
+                    framePacer->setLatencyMeasurement(mode == "on");
+                else
+                    LogInfo << "Usage: inputlatency on|off, shown by framestats" << endLog;
+                } );
+        commandHandler->bind("trace", [](const string& line) {
+                std::istringstream args(line);
+                string command, mode;
+                args >> command >> mode;
+                if (mode == "on" || mode == "off")
+                    tracer.setEnabled(mode == "on");
+                else
+                    LogInfo << "Usage: trace on|off, the trace is " << (tracer.isEnabled() ? "on" : "off") << endLog;
+                } );
+        commandHandler->bind("tracedump", [this](const string& line) {
+                std::istringstream args(line);
+                string command, filename;
+                args >> command >> filename;
+                if (filename.empty())
+                    filename = fileSystem->getApplicationPath() + "trace.bin";
+                tracer.dump(filename);
+                } );
+        commandHandler->bind("tracestream", [](const string& line) {
+                std::istringstream args(line);
+                string command, filename;
+                args >> command >> filename;
+                if (filename == "off")
+                    tracer.stopStream();
+                else if (!filename.empty())
+                    tracer.startStream(filename);
+                else
+                    LogInfo << "Usage: tracestream <filename>|off" << endLog;
+                } );
+        commandHandler->bind("maxfps", [this](const string& line) {
+                std::istringstream args(line);
+                string command;
+                float rate = -1.0f;
+                args >> command >> rate;
+                if (rate >= 0.0f)
+                    framePacer->setTargetRate(rate);
+                else
+                    LogInfo << "Usage: maxfps <rate>, 0 for no limit" << endLog;
+                } );
+    }
+
+    void Root::simulate(const std::function<void(float)>& callback, float elapsed)
+    {
+        TraceScope trace(TRACE_SIMULATE);
+        if (fixedStep > 0.0f)
+        {
+            accumulator += elapsed;
+            int steps = 0;
+            while (accumulator >= fixedStep && steps < maxSteps)
+            {
+                callback(fixedStep);
+                world->update(fixedStep);
+                accumulator -= fixedStep;
+                steps++;
+            }
+            //Too far behind to catch up, drop the rest
+            if (accumulator >= fixedStep)
+                accumulator = std::fmod(accumulator, (double)fixedStep);
+            interpolationAlpha = float(accumulator / fixedStep);
+            world->setInterpolationAlpha(interpolationAlpha);
+            trace.setArg(0, steps);
+        }
+        else
+        {
             callback(elapsed);
             world->update(elapsed);
-            interface->update(elapsed);
-            graphics->update(elapsed);
+            trace.setArg(0, 1);
+        }
+    }
 
-            handleEvents();
+    void Root::threadedGameLoop(const std::function<void(float)>& callback)
+    {
+        simulation = new SimulationThread;
+        simulation->running = true;
+        simulation->thread = std::thread([this, &callback]() { simulationLoop(callback); });
+
+        double frequency = (double)SDL_GetPerformanceFrequency();
+        uint64_t frameTimer = SDL_GetPerformanceCounter();
+        auto& snapshots = simulation->snapshots;
+        while(loopRunning) {
+            uint64_t pollTime = SDL_GetPerformanceCounter();
+            float elapsed = float((pollTime - frameTimer) / frequency);
+            frameTimer = pollTime;
+            if (!inputRecorder->nextFrame(elapsed))
+                break;
+
+            {
+                std::lock_guard<std::mutex> lock(simulation->worldMutex);
+                handleEvents();
+                jobSystem->runMainThreadJobs();
+                logger.dispatchCallback();
+                interface->update(elapsed);
+                graphics->update(elapsed);
+                inputSystem->latchMouse();
+            }
+
+            graphics->clear(getWindowWidth(), getWindowHeight());
+
+            //Draw the newest simulation step. The previous one is not drawn
+            //again so its models and materials are released here, on the
+            //thread of the OpenGL context
+            if (snapshots.hasNew())
+            {
+                snapshots.getReadBuffer().releaseResources();
+                snapshots.acquire();
+                {
+                    std::lock_guard<std::mutex> lock(simulation->waitMutex);
+                }
+                simulation->snapshotTaken.notify_one();
+            }
+            graphics->render(snapshots.getReadBuffer());
+            {
+                std::lock_guard<std::mutex> lock(simulation->worldMutex);
+                graphics->render(interface);
+            }
+
+            swapBuffers();
+        }
 
-            SDL_GL_SwapWindow(sdlValues->window);
+        {
+            std::lock_guard<std::mutex> lock(simulation->waitMutex);
+            simulation->running = false;
         }
+        simulation->snapshotTaken.notify_one();
+        simulation->thread.join();
+        delete simulation;
+        simulation = 0;
+    }
+
+    void Root::simulationLoop(const std::function<void(float)>& callback)
+    {
+        double frequency = (double)SDL_GetPerformanceFrequency();
+        timer = SDL_GetPerformanceCounter();
+        accumulator = 0.0;
+        auto& snapshots = simulation->snapshots;
+        while(true) {
+            //Simulating frames that are never drawn is a waste
+            {
+                std::unique_lock<std::mutex> lock(simulation->waitMutex);
+                simulation->snapshotTaken.wait(lock, [this, &snapshots]() {
+                        return !simulation->running || !snapshots.hasNew(); });
+                if (!simulation->running) break;
+            }
+
+            std::lock_guard<std::mutex> lock(simulation->worldMutex);
+            uint64_t pollTime = SDL_GetPerformanceCounter();
+            float elapsed = float((pollTime - timer) / frequency);
+            timer = pollTime;
+
+            simulate(callback, elapsed);
+            graphics->buildSnapshot(world, snapshots.getWriteBuffer(), true);
+            snapshots.publish();
+        }
+    }
+
+    bool Root::startRecording(const std::string& filename)
+    {
+        if (threadedSimulation)
+            LogWarning << "The simulation thread does not use the recorded frame times, a replay will differ" << endLog;
+        return inputRecorder->startRecording(filename, windowWidth, windowHeight);
+    }
+
+    bool Root::startReplay(const std::string& filename, bool fast, bool hidden)
+    {
+        if (!inputRecorder->startReplay(filename))
+            return false;
+        if (threadedSimulation)
+            LogWarning << "The simulation thread does not use the recorded frame times, the replay will differ" << endLog;
+
+        int width = inputRecorder->getReplayWidth();
+        int height = inputRecorder->getReplayHeight();
+        if (width > 0 && height > 0 && (width != windowWidth || height != windowHeight))
+        {
+            SDL_SetWindowSize(sdlValues->window, width, height);
+            windowResized(width, height);
+        }
+        if (fast)
+        {
+            framePacer->setVsync(VSYNC_OFF);
+            framePacer->setTargetRate(0.0f);
+        }
+        if (hidden)
+            SDL_HideWindow(sdlValues->window);
+        return true;
+    }
+
+    void Root::setFixedTimestep(float step, int steps)
+    {
+        fixedStep = (step > 0.0f ? step : 0.0f);
+        maxSteps = (steps > 0 ? steps : 1);
+        accumulator = 0.0;
+        interpolationAlpha = 1.0f;
+        world->setInterpolation(fixedStep > 0.0f);
     }
 
     void Root::stopGameLoop()
@@ -203,6 +547,7 @@ namespace Arya
     void Root::handleEvents()
     {
         SDL_Event event;
+        bool replaying = inputRecorder->isReplaying();
         while(SDL_PollEvent(&event)) {
             switch(event.type) {
                 case SDL_KEYDOWN:
@@ -218,6 +563,10 @@ namespace Arya
                 case SDL_CONTROLLERBUTTONDOWN:
                 case SDL_CONTROLLERBUTTONUP:
                 case SDL_CONTROLLERAXISMOTION:
+                    //The live input is ignored during a replay
+                    if (replaying) break;
+                    inputRecorder->recordEvent(event);
+                    framePacer->inputEvent(event.common.timestamp);
                     inputSystem->handleInputEvent(event);
                     break;
                 case SDL_QUIT:
@@ -226,6 +575,8 @@ namespace Arya
                 case SDL_WINDOWEVENT:
                     switch(event.window.event) {
                         case SDL_WINDOWEVENT_RESIZED:
+                            if (replaying) break;
+                            inputRecorder->recordEvent(event);
                             windowResized(event.window.data1, event.window.data2);
                             break;
                         case SDL_WINDOWEVENT_CLOSE:
@@ -247,6 +598,21 @@ namespace Arya
                     break;
             }
         }
+
+        //The recorded events of this frame, in the order they were handled
+        if (replaying)
+        {
+            while (inputRecorder->replayEvent(event))
+            {
+                if (event.type == SDL_WINDOWEVENT)
+                    windowResized(event.window.data1, event.window.data2);
+                else
+                    inputSystem->handleInputEvent(event);
+            }
+        }
+
+        //Motion that was merged, see InputSystem::setCoalesceMotion
+        inputSystem->flushInput();
     }
 
     void Root::render()
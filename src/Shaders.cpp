@@ -3,6 +3,8 @@
 #include "Files.h"
 #include "Locator.h"
 #include <GL/glew.h>
+#include <sstream>
+#include <algorithm>
 
 namespace Arya
 {
@@ -26,9 +28,65 @@ namespace Arya
 
     bool Shader::addSourceFile(string f)
     {
-        File* source = Locator::getFileSystem().getFile(f);
-        if(!source) return false;
-        sources.push_back(source);
+        //Later sources start with #line, the first has to start with #version
+        string text;
+        if (!preprocess(f, text, !sources.empty())) return false;
+        sources.push_back(text);
+        return true;
+    }
+
+    void Shader::addDefine(const string& name)
+    {
+        defines.push_back(name);
+    }
+
+    bool Shader::preprocess(const string& filename, string& out, bool numbered)
+    {
+        //Every file is included once
+        for (auto& name : sourceNames)
+            if (name == filename)
+                return true;
+
+        File* file = Locator::getFileSystem().getFile(filename);
+        if (!file) return false;
+        std::istringstream lines(string(file->getData(), file->getSize()));
+        Locator::getFileSystem().releaseFile(file);
+
+        //Used as source string number of #line so errors refer to the right file
+        int fileNumber = sourceNames.size();
+        sourceNames.push_back(filename);
+        string directory = filename.substr(0, filename.find_last_of('/') + 1);
+
+        if (numbered)
+            out += "#line 1 " + std::to_string(fileNumber) + "\n";
+
+        string line;
+        int lineNumber = 0;
+        while (std::getline(lines, line))
+        {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if (start == string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                out += line;
+                out += '\n';
+                continue;
+            }
+
+            size_t open = line.find('"', start + 8);
+            size_t close = (open == string::npos ? open : line.find('"', open + 1));
+            if (close == string::npos)
+            {
+                LogError << "Invalid #include in " << filename << " line " << lineNumber << endLog;
+                return false;
+            }
+            if (!preprocess(directory + line.substr(open + 1, close - open - 1), out, true))
+            {
+                LogError << "Could not include file in " << filename << " line " << lineNumber << endLog;
+                return false;
+            }
+            out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileNumber) + "\n";
+        }
         return true;
     }
 
@@ -49,11 +107,28 @@ namespace Arya
                 default: LogError << "Error compiling shader: Invalid type." << endLog; return false;
             }
 
+            //The defines go right after #version, which has to come first
+            string first = sources[0];
+            if (!defines.empty())
+            {
+                size_t version = first.find("#version");
+                size_t insert = (version == string::npos ? 0 : first.find('\n', version));
+                insert = (insert == string::npos ? first.size() : insert + 1);
+                int versionLine = 1 + std::count(first.begin(), first.begin() + insert, '\n');
+
+                string text;
+                for (auto& d : defines)
+                    text += "#define " + d + "\n";
+                text += "#line " + std::to_string(versionLine) + " 0\n";
+                first.insert(insert, text);
+            }
+
             const GLchar** gl_sources = new const GLchar*[sources.size()];
             GLint* lengths = new GLint[sources.size()];
             for(unsigned int i = 0; i < sources.size(); ++i) {
-                gl_sources[i] = sources[i]->getData();
-                lengths[i] = sources[i]->getSize();
+                const string& source = (i == 0 ? first : sources[i]);
+                gl_sources[i] = source.c_str();
+                lengths[i] = source.size();
             }
 
             glShaderSource(handle, sources.size(), gl_sources, lengths);
@@ -82,6 +157,9 @@ namespace Arya
                 {
                     LogError << "no log available";
                 }
+                //The numbers in the log refer to these files
+                for(unsigned int i = 0; i < sourceNames.size(); ++i)
+                    LogError << "\n" << i << ": " << sourceNames[i];
                 LogError << endLog;
 
                 glDeleteShader(handle);
@@ -106,21 +184,42 @@ namespace Arya
         handle = 0;
         linked = false;
         builtinUniforms = UNIFORM_NONE;
+        instanceBlockBinding = 0;
+        instanceBlockCapacity = 0;
+        features = FEATURE_NONE;
         init();
         valid = false;
     }
 
     ShaderProgram::ShaderProgram(string vertexFile, string fragmentFile)
+    {
+        load(vertexFile, fragmentFile, vector<string>());
+    }
+
+    ShaderProgram::ShaderProgram(string vertexFile, string fragmentFile, const vector<string>& defines)
+    {
+        load(vertexFile, fragmentFile, defines);
+    }
+
+    void ShaderProgram::load(const string& vertexFile, const string& fragmentFile, const vector<string>& defines)
     {
         handle = 0;
         linked = false;
         builtinUniforms = UNIFORM_NONE;
+        instanceBlockBinding = 0;
+        instanceBlockCapacity = 0;
+        features = FEATURE_NONE;
         init();
 
         valid = false;
 
         Shader* vertex = new Shader(Arya::VERTEX);
         Shader* fragment = new Shader(Arya::FRAGMENT);
+        for (auto& d : defines)
+        {
+            vertex->addDefine(d);
+            fragment->addDefine(d);
+        }
         if( !vertex->addSourceFile(vertexFile)
                 || !vertex->compile() 
                 || !fragment->addSourceFile(fragmentFile)
@@ -170,6 +269,8 @@ namespace Arya
     bool ShaderProgram::link()
     {
         glLinkProgram(handle);
+        //Locations can change when a program is linked again
+        uniforms.clear();
 
         GLint result;
         glGetProgramiv(handle, GL_LINK_STATUS, &result);
@@ -209,11 +310,9 @@ namespace Arya
         if(it != uniforms.end()) return it->second;
         GLint loc = glGetUniformLocation(handle, name);
         if (loc == -1)
-        {
             LogWarning << "ShaderProgram::getUniformLocation : Uniform " << name << " not found." << endLog;
-            return -1;
-        }
-        uniforms.insert(std::pair<string,GLuint>(name, loc));
+        //glUniform ignores location -1, so a missing uniform stays harmless
+        uniforms.emplace(name, loc);
         return loc;
     }
 
@@ -222,6 +321,11 @@ namespace Arya
         glUniform1i(getUniformLocation(name), val);
     }
 
+    void ShaderProgram::setUniform1ui(const char* name, unsigned int val)
+    {
+        glUniform1ui(getUniformLocation(name), val);
+    }
+
     void ShaderProgram::setUniform1f(const char* name, float val)
     {
         glUniform1f(getUniformLocation(name), val);
@@ -309,6 +413,21 @@ namespace Arya
             setUniform1f("interpolation", t);
     }
 
+    void ShaderProgram::setFrameData(int t, int vertexCount)
+    {
+        if (builtinUniforms & UNIFORM_FRAMEDATA)
+        {
+            setUniform1i("frameData", t);
+            setUniform1i("vertexCount", vertexCount);
+        }
+    }
+
+    void ShaderProgram::setAnimFrames(int frame, int nextFrame)
+    {
+        if (builtinUniforms & UNIFORM_ANIM_FRAMES)
+            glUniform2i(getUniformLocation("animFrames"), frame, nextFrame);
+    }
+
     bool ShaderProgram::addUniform1i(const char* name, function<int(ShaderUniformBase*)> f)
     {
         GLint loc = glGetUniformLocation(handle, name);
@@ -383,12 +502,197 @@ namespace Arya
 
     void ShaderProgram::doUniforms(ShaderUniformBase* e)
     {
-        for (auto a : uniforms1i) glUniform1i(a.handle, a.func(e));
-        for (auto a : uniforms1f) glUniform1f(a.handle, a.func(e));
-        for (auto a : uniforms2fv) glUniform2fv(a.handle, 1, &(a.func(e))[0]);
-        for (auto a : uniforms3fv) glUniform3fv(a.handle, 1, &(a.func(e))[0]);
-        for (auto a : uniforms4fv) glUniform4fv(a.handle, 1, &(a.func(e))[0]);
-        for (auto a : uniformsMat4fv) glUniformMatrix4fv(a.handle, 1, false, &(a.func(e))[0][0]);
+        for (auto& a : uniforms1i) glUniform1i(a.handle, a.func(e));
+        for (auto& a : uniforms1f) glUniform1f(a.handle, a.func(e));
+        for (auto& a : uniforms2fv) glUniform2fv(a.handle, 1, &(a.func(e))[0]);
+        for (auto& a : uniforms3fv) glUniform3fv(a.handle, 1, &(a.func(e))[0]);
+        for (auto& a : uniforms4fv) glUniform4fv(a.handle, 1, &(a.func(e))[0]);
+        for (auto& a : uniformsMat4fv) glUniformMatrix4fv(a.handle, 1, false, &(a.func(e))[0][0]);
     }
 
+    //---------------------------
+    // Uniform blocks
+    //---------------------------
+
+    void ShaderProgram::setUniformDefaults(shared_ptr<const UniformBlock> defaults)
+    {
+        uniformDefaults = defaults;
+        blockBindings.clear();
+        if (!defaults) return;
+
+        for (auto& f : defaults->getLayout()->getFields())
+        {
+            GLint loc = glGetUniformLocation(handle, f.name.c_str());
+            if (loc != -1)
+                blockBindings.push_back(BlockBinding{loc, f.type, f.offset});
+        }
+    }
+
+    void ShaderProgram::applyUniformBlock(const UniformBlock* block)
+    {
+        if (!block)
+            applyUniformData(0, 0);
+        else
+            applyUniformData(block->getLayout(), block->getData());
+    }
+
+    void ShaderProgram::applyUniformData(const UniformLayout* layout, const char* data)
+    {
+        if (!uniformDefaults) return;
+        if (!data || layout != uniformDefaults->getLayout())
+            data = uniformDefaults->getData();
+
+        for (auto& b : blockBindings)
+        {
+            const void* value = data + b.offset;
+            switch (b.type)
+            {
+                case UNIFORMTYPE_INT: glUniform1iv(b.handle, 1, (const GLint*)value); break;
+                case UNIFORMTYPE_FLOAT: glUniform1fv(b.handle, 1, (const GLfloat*)value); break;
+                case UNIFORMTYPE_VEC2: glUniform2fv(b.handle, 1, (const GLfloat*)value); break;
+                case UNIFORMTYPE_VEC3: glUniform3fv(b.handle, 1, (const GLfloat*)value); break;
+                case UNIFORMTYPE_VEC4: glUniform4fv(b.handle, 1, (const GLfloat*)value); break;
+                case UNIFORMTYPE_MAT4: glUniformMatrix4fv(b.handle, 1, false, (const GLfloat*)value); break;
+            }
+        }
+    }
+
+    bool ShaderProgram::setInstanceBlock(const char* blockName, unsigned int bindingPoint)
+    {
+        instanceBlockCapacity = 0;
+        if (!uniformDefaults || !uniformDefaults->getSize())
+        {
+            LogError << "ShaderProgram::setInstanceBlock : no uniform defaults set." << endLog;
+            return false;
+        }
+
+        GLuint index = glGetUniformBlockIndex(handle, blockName);
+        if (index == GL_INVALID_INDEX)
+        {
+            LogError << "ShaderProgram::setInstanceBlock : " << blockName << " not found." << endLog;
+            return false;
+        }
+        glUniformBlockBinding(handle, index, bindingPoint);
+
+        GLint blockSize = 0;
+        glGetActiveUniformBlockiv(handle, index, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+        instanceBlockName = blockName;
+        instanceBlockBinding = bindingPoint;
+        instanceBlockCapacity = blockSize / uniformDefaults->getSize();
+        return instanceBlockCapacity > 0;
+    }
+
+    //---------------------------
+    // Variants
+    //---------------------------
+
+    template <typename T>
+    static void copyUniforms(const vector<ShaderUniform<T> >& from, vector<ShaderUniform<T> >& to, GLuint handle)
+    {
+        for (auto a : from) //copy, the handle changes
+        {
+            a.handle = glGetUniformLocation(handle, a.name);
+            if (a.handle != -1)
+                to.push_back(a);
+        }
+    }
+
+    shared_ptr<ShaderProgram> ShaderProgram::createVariant(string fragmentFile)
+    {
+        Shader* fragment = new Shader(Arya::FRAGMENT);
+        if (!fragment->addSourceFile(fragmentFile) || !fragment->compile())
+        {
+            delete fragment;
+            return nullptr;
+        }
+
+        shared_ptr<ShaderProgram> variant = std::make_shared<ShaderProgram>();
+        for (Shader* s : shaders)
+            if (s->type != Arya::FRAGMENT)
+                variant->attach(s);
+        variant->attach(fragment);
+        if (!variant->link())
+            return nullptr;
+
+        //Uniforms only used by the old fragment shader are gone
+        static const struct { UNIFORM_FLAG flag; const char* name; } builtinNames[] = {
+            { UNIFORM_MOVEMATRIX, "mMatrix" },
+            { UNIFORM_VIEWMATRIX, "viewMatrix" },
+            { UNIFORM_VPMATRIX, "vpMatrix" },
+            { UNIFORM_TEXTURE, "tex" },
+            { UNIFORM_MATERIALPARAMS, "material" },
+            { UNIFORM_ANIM_INTERPOL, "interpolation" },
+            { UNIFORM_LIGHTMATRIX, "lightMatrix" },
+            { UNIFORM_SHADOWTEXTURE, "shadowMap" },
+            { UNIFORM_FRAMEDATA, "frameData" },
+            { UNIFORM_ANIM_FRAMES, "animFrames" }
+        };
+        for (auto& b : builtinNames)
+            if ((builtinUniforms & b.flag) && glGetUniformLocation(variant->handle, b.name) != -1)
+                variant->builtinUniforms |= b.flag;
+
+        copyUniforms(uniforms1i, variant->uniforms1i, variant->handle);
+        copyUniforms(uniforms1f, variant->uniforms1f, variant->handle);
+        copyUniforms(uniforms2fv, variant->uniforms2fv, variant->handle);
+        copyUniforms(uniforms3fv, variant->uniforms3fv, variant->handle);
+        copyUniforms(uniforms4fv, variant->uniforms4fv, variant->handle);
+        copyUniforms(uniformsMat4fv, variant->uniformsMat4fv, variant->handle);
+
+        variant->setUniformDefaults(uniformDefaults);
+        if (instanceBlockCapacity > 0)
+            variant->setInstanceBlock(instanceBlockName.c_str(), instanceBlockBinding);
+
+        return variant;
+    }
+
+    ShaderProgram* ShaderProgram::getFeatureVariant(std::uint32_t f)
+    {
+        if (f == features) return this;
+        auto variants = family.lock();
+        if (!variants) return nullptr;
+        return variants->get(f).get();
+    }
+
+    //---------------------------------------------------------
+    // SHADERVARIANTS
+    //---------------------------------------------------------
+
+    ShaderVariants::ShaderVariants(string vertexFile, string fragmentFile)
+        : vertexFile(vertexFile), fragmentFile(fragmentFile)
+    {
+    }
+
+    shared_ptr<ShaderProgram> ShaderVariants::get(std::uint32_t features)
+    {
+        auto it = variants.find(features);
+        if (it != variants.end()) return it->second;
+
+        static const struct { SHADER_FEATURE feature; const char* define; } featureDefines[] = {
+            { FEATURE_ANIMATED, "ANIMATED" },
+            { FEATURE_FRAMETEXTURE, "FRAME_TEXTURE" },
+            { FEATURE_INSTANCED, "INSTANCED" },
+            { FEATURE_SHADOW_ONLY, "SHADOW_ONLY" },
+            { FEATURE_FOG, "FOG" },
+            { FEATURE_TINT, "TINT" }
+        };
+        vector<string> defines;
+        for (auto& f : featureDefines)
+            if (features & f.feature)
+                defines.push_back(f.define);
+
+        shared_ptr<ShaderProgram> program = std::make_shared<ShaderProgram>(vertexFile, fragmentFile, defines);
+        if (!program->isValid())
+        {
+            LogError << "Could not compile variant " << features << " of " << vertexFile << endLog;
+            program = nullptr;
+        }
+        else
+        {
+            program->family = shared_from_this();
+            program->features = features;
+            if (setup) setup(program.get(), features);
+        }
+        variants[features] = program;
+        return program;
+    }
 }
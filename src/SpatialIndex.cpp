@@ -0,0 +1,475 @@
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Arya
+{
+    const uint32_t SpatialIndex::none;
+
+    static inline float surfaceArea(const vec3& boxMin, const vec3& boxMax)
+    {
+        vec3 d = boxMax - boxMin;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    static inline bool overlaps(const vec3& aMin, const vec3& aMax, const vec3& bMin, const vec3& bMax)
+    {
+        return aMin.x <= bMax.x && aMax.x >= bMin.x
+            && aMin.y <= bMax.y && aMax.y >= bMin.y
+            && aMin.z <= bMax.z && aMax.z >= bMin.z;
+    }
+
+    static inline bool contains(const vec3& outerMin, const vec3& outerMax, const vec3& innerMin, const vec3& innerMax)
+    {
+        return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z
+            && innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+    }
+
+    static inline float distanceSquared(const vec3& p, const vec3& boxMin, const vec3& boxMax)
+    {
+        vec3 d = glm::max(boxMin - p, glm::max(vec3(0.0f), p - boxMax));
+        return glm::dot(d, d);
+    }
+
+    //Entry distance of the ray into the box, or -1 when it misses
+    static inline float rayEnter(const vec3& origin, const vec3& invDir, float maxDistance, const vec3& boxMin, const vec3& boxMax)
+    {
+        vec3 t1 = (boxMin - origin) * invDir;
+        vec3 t2 = (boxMax - origin) * invDir;
+        vec3 tNear = glm::min(t1, t2);
+        vec3 tFar = glm::max(t1, t2);
+        float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float leave = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        return enter <= leave ? enter : -1.0f;
+    }
+
+    SpatialIndex::SpatialIndex(float m)
+    {
+        root = none;
+        freeList = none;
+        proxyCount = 0;
+        margin = m;
+    }
+
+    SpatialIndex::~SpatialIndex()
+    {
+    }
+
+    uint32_t SpatialIndex::allocateNode()
+    {
+        uint32_t node;
+        if (freeList == none)
+        {
+            node = nodes.size();
+            nodes.push_back(Node());
+        }
+        else
+        {
+            node = freeList;
+            freeList = nodes[node].parent;
+        }
+        Node& n = nodes[node];
+        n.parent = none;
+        n.child1 = none;
+        n.child2 = none;
+        n.height = 0;
+        n.userData = none;
+        return node;
+    }
+
+    void SpatialIndex::freeNode(uint32_t node)
+    {
+        nodes[node].parent = freeList;
+        nodes[node].height = -1;
+        freeList = node;
+    }
+
+    uint32_t SpatialIndex::insert(const vec3& boxMin, const vec3& boxMax, uint32_t userData)
+    {
+        uint32_t leaf = allocateNode();
+        Node& n = nodes[leaf];
+        n.exactMin = boxMin;
+        n.exactMax = boxMax;
+        n.boxMin = boxMin - vec3(margin);
+        n.boxMax = boxMax + vec3(margin);
+        n.userData = userData;
+        insertLeaf(leaf);
+        proxyCount++;
+        return leaf;
+    }
+
+    void SpatialIndex::remove(uint32_t proxy)
+    {
+        removeLeaf(proxy);
+        freeNode(proxy);
+        proxyCount--;
+    }
+
+    bool SpatialIndex::move(uint32_t proxy, const vec3& boxMin, const vec3& boxMax)
+    {
+        Node& n = nodes[proxy];
+        n.exactMin = boxMin;
+        n.exactMax = boxMax;
+        if (contains(n.boxMin, n.boxMax, boxMin, boxMax))
+            return false;
+
+        removeLeaf(proxy);
+        nodes[proxy].boxMin = boxMin - vec3(margin);
+        nodes[proxy].boxMax = boxMax + vec3(margin);
+        insertLeaf(proxy);
+        return true;
+    }
+
+    void SpatialIndex::insertLeaf(uint32_t leaf)
+    {
+        if (root == none)
+        {
+            root = leaf;
+            nodes[root].parent = none;
+            return;
+        }
+
+        //Find the best sibling: descend while that is cheaper
+        //than making the current node the sibling
+        vec3 leafMin = nodes[leaf].boxMin;
+        vec3 leafMax = nodes[leaf].boxMax;
+        uint32_t index = root;
+        while (!nodes[index].isLeaf())
+        {
+            const Node& n = nodes[index];
+            float area = surfaceArea(n.boxMin, n.boxMax);
+            float combinedArea = surfaceArea(glm::min(n.boxMin, leafMin), glm::max(n.boxMax, leafMax));
+
+            //Cost of a new parent for this node and the leaf
+            float cost = 2.0f * combinedArea;
+            //Minimum cost of pushing the leaf further down the tree
+            float inheritanceCost = 2.0f * (combinedArea - area);
+
+            float childCost[2];
+            uint32_t children[2] = { n.child1, n.child2 };
+            for (int i = 0; i < 2; ++i)
+            {
+                const Node& c = nodes[children[i]];
+                float enlarged = surfaceArea(glm::min(c.boxMin, leafMin), glm::max(c.boxMax, leafMax));
+                if (c.isLeaf())
+                    childCost[i] = enlarged + inheritanceCost;
+                else
+                    childCost[i] = enlarged - surfaceArea(c.boxMin, c.boxMax) + inheritanceCost;
+            }
+
+            if (cost < childCost[0] && cost < childCost[1])
+                break;
+            index = (childCost[0] < childCost[1] ? children[0] : children[1]);
+        }
+
+        uint32_t sibling = index;
+        uint32_t oldParent = nodes[sibling].parent;
+        uint32_t newParent = allocateNode();
+        {
+            Node& p = nodes[newParent];
+            p.parent = oldParent;
+            p.boxMin = glm::min(nodes[sibling].boxMin, leafMin);
+            p.boxMax = glm::max(nodes[sibling].boxMax, leafMax);
+            p.height = nodes[sibling].height + 1;
+            p.child1 = sibling;
+            p.child2 = leaf;
+        }
+        if (oldParent != none)
+        {
+            if (nodes[oldParent].child1 == sibling)
+                nodes[oldParent].child1 = newParent;
+            else
+                nodes[oldParent].child2 = newParent;
+        }
+        else
+            root = newParent;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        //Walk back up to fix heights and boxes
+        index = nodes[leaf].parent;
+        while (index != none)
+        {
+            index = balance(index);
+            Node& n = nodes[index];
+            const Node& c1 = nodes[n.child1];
+            const Node& c2 = nodes[n.child2];
+            n.height = 1 + std::max(c1.height, c2.height);
+            n.boxMin = glm::min(c1.boxMin, c2.boxMin);
+            n.boxMax = glm::max(c1.boxMax, c2.boxMax);
+            index = n.parent;
+        }
+    }
+
+    void SpatialIndex::removeLeaf(uint32_t leaf)
+    {
+        if (leaf == root)
+        {
+            root = none;
+            return;
+        }
+
+        uint32_t parent = nodes[leaf].parent;
+        uint32_t grandParent = nodes[parent].parent;
+        uint32_t sibling = (nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1);
+
+        if (grandParent == none)
+        {
+            root = sibling;
+            nodes[sibling].parent = none;
+            freeNode(parent);
+            return;
+        }
+
+        //The sibling takes the place of the parent
+        if (nodes[grandParent].child1 == parent)
+            nodes[grandParent].child1 = sibling;
+        else
+            nodes[grandParent].child2 = sibling;
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+
+        uint32_t index = grandParent;
+        while (index != none)
+        {
+            index = balance(index);
+            Node& n = nodes[index];
+            const Node& c1 = nodes[n.child1];
+            const Node& c2 = nodes[n.child2];
+            n.boxMin = glm::min(c1.boxMin, c2.boxMin);
+            n.boxMax = glm::max(c1.boxMax, c2.boxMax);
+            n.height = 1 + std::max(c1.height, c2.height);
+            index = n.parent;
+        }
+    }
+
+    //Rotates the subtree at a when it is imbalanced and returns its new root
+    uint32_t SpatialIndex::balance(uint32_t a)
+    {
+        Node& A = nodes[a];
+        if (A.isLeaf() || A.height < 2)
+            return a;
+
+        uint32_t b = A.child1;
+        uint32_t c = A.child2;
+        int32_t balanceFactor = nodes[c].height - nodes[b].height;
+
+        //The higher child becomes the root of the subtree
+        if (balanceFactor > 1 || balanceFactor < -1)
+        {
+            uint32_t up = (balanceFactor > 1 ? c : b);
+            uint32_t other = (balanceFactor > 1 ? b : c);
+            Node& U = nodes[up];
+            uint32_t f = U.child1;
+            uint32_t g = U.child2;
+
+            //Swap a and up
+            U.child1 = a;
+            U.parent = A.parent;
+            A.parent = up;
+
+            if (U.parent != none)
+            {
+                if (nodes[U.parent].child1 == a)
+                    nodes[U.parent].child1 = up;
+                else
+                    nodes[U.parent].child2 = up;
+            }
+            else
+                root = up;
+
+            //The higher child of up stays, the other moves to a
+            uint32_t keep = (nodes[f].height > nodes[g].height ? f : g);
+            uint32_t move = (keep == f ? g : f);
+            U.child2 = keep;
+            if (balanceFactor > 1)
+                A.child2 = move;
+            else
+                A.child1 = move;
+            nodes[move].parent = a;
+
+            const Node& O = nodes[other];
+            const Node& M = nodes[move];
+            const Node& K = nodes[keep];
+            A.boxMin = glm::min(O.boxMin, M.boxMin);
+            A.boxMax = glm::max(O.boxMax, M.boxMax);
+            A.height = 1 + std::max(O.height, M.height);
+            U.boxMin = glm::min(A.boxMin, K.boxMin);
+            U.boxMax = glm::max(A.boxMax, K.boxMax);
+            U.height = 1 + std::max(A.height, K.height);
+
+            return up;
+        }
+        return a;
+    }
+
+    void SpatialIndex::collectLeaves(uint32_t node, vector<uint32_t>& result) const
+    {
+        vector<uint32_t> stack;
+        stack.push_back(node);
+        while (!stack.empty())
+        {
+            const Node& n = nodes[stack.back()];
+            stack.pop_back();
+            if (n.isLeaf())
+                result.push_back(n.userData);
+            else
+            {
+                stack.push_back(n.child1);
+                stack.push_back(n.child2);
+            }
+        }
+    }
+
+    void SpatialIndex::queryBox(const vec3& boxMin, const vec3& boxMax, vector<uint32_t>& result) const
+    {
+        if (root == none) return;
+        vector<uint32_t> stack;
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            const Node& n = nodes[stack.back()];
+            stack.pop_back();
+            if (!overlaps(n.boxMin, n.boxMax, boxMin, boxMax)) continue;
+            if (n.isLeaf())
+            {
+                if (overlaps(n.exactMin, n.exactMax, boxMin, boxMax))
+                    result.push_back(n.userData);
+            }
+            else
+            {
+                stack.push_back(n.child1);
+                stack.push_back(n.child2);
+            }
+        }
+    }
+
+    void SpatialIndex::querySphere(const vec3& center, float radius, vector<uint32_t>& result) const
+    {
+        if (root == none) return;
+        float radiusSquared = radius * radius;
+        vector<uint32_t> stack;
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            const Node& n = nodes[stack.back()];
+            stack.pop_back();
+            if (distanceSquared(center, n.boxMin, n.boxMax) > radiusSquared) continue;
+            if (n.isLeaf())
+            {
+                if (distanceSquared(center, n.exactMin, n.exactMax) <= radiusSquared)
+                    result.push_back(n.userData);
+            }
+            else
+            {
+                stack.push_back(n.child1);
+                stack.push_back(n.child2);
+            }
+        }
+    }
+
+    void SpatialIndex::queryFrustum(const mat4& vp, vector<uint32_t>& result) const
+    {
+        if (root == none) return;
+
+        //Planes pointing inwards, from the rows of the matrix
+        vec4 planes[6];
+        vec4 row0(vp[0][0], vp[1][0], vp[2][0], vp[3][0]);
+        vec4 row1(vp[0][1], vp[1][1], vp[2][1], vp[3][1]);
+        vec4 row2(vp[0][2], vp[1][2], vp[2][2], vp[3][2]);
+        vec4 row3(vp[0][3], vp[1][3], vp[2][3], vp[3][3]);
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+
+        //Returns 0 outside, 1 intersecting, 2 fully inside
+        auto classify = [&planes](const vec3& boxMin, const vec3& boxMax) {
+            int inside = 2;
+            for (int i = 0; i < 6; ++i)
+            {
+                const vec4& p = planes[i];
+                vec3 farthest(p.x > 0 ? boxMax.x : boxMin.x, p.y > 0 ? boxMax.y : boxMin.y, p.z > 0 ? boxMax.z : boxMin.z);
+                if (p.x * farthest.x + p.y * farthest.y + p.z * farthest.z + p.w < 0) return 0;
+                vec3 nearest(p.x > 0 ? boxMin.x : boxMax.x, p.y > 0 ? boxMin.y : boxMax.y, p.z > 0 ? boxMin.z : boxMax.z);
+                if (p.x * nearest.x + p.y * nearest.y + p.z * nearest.z + p.w < 0) inside = 1;
+            }
+            return inside;
+        };
+
+        vector<uint32_t> stack;
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            uint32_t index = stack.back();
+            stack.pop_back();
+            const Node& n = nodes[index];
+            if (n.isLeaf())
+            {
+                if (classify(n.exactMin, n.exactMax))
+                    result.push_back(n.userData);
+                continue;
+            }
+            int c = classify(n.boxMin, n.boxMax);
+            if (c == 2)
+                collectLeaves(index, result);
+            else if (c == 1)
+            {
+                stack.push_back(n.child1);
+                stack.push_back(n.child2);
+            }
+        }
+    }
+
+    uint32_t SpatialIndex::raycast(const vec3& origin, const vec3& direction, float maxDistance, float* distance) const
+    {
+        if (root == none) return none;
+
+        //Division by zero gives infinity, which the slab test handles
+        vec3 invDir(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+        uint32_t best = none;
+        float bestDistance = maxDistance;
+
+        vector<std::pair<float, uint32_t>> stack;
+        float enter = rayEnter(origin, invDir, bestDistance, nodes[root].boxMin, nodes[root].boxMax);
+        if (enter >= 0.0f) stack.push_back(std::make_pair(enter, root));
+        while (!stack.empty())
+        {
+            std::pair<float, uint32_t> top = stack.back();
+            stack.pop_back();
+            if (top.first > bestDistance) continue;
+
+            const Node& n = nodes[top.second];
+            if (n.isLeaf())
+            {
+                float t = rayEnter(origin, invDir, bestDistance, n.exactMin, n.exactMax);
+                if (t >= 0.0f && (best == none || t < bestDistance))
+                {
+                    best = n.userData;
+                    bestDistance = t;
+                }
+                continue;
+            }
+
+            //Visit the nearest child first
+            float t1 = rayEnter(origin, invDir, bestDistance, nodes[n.child1].boxMin, nodes[n.child1].boxMax);
+            float t2 = rayEnter(origin, invDir, bestDistance, nodes[n.child2].boxMin, nodes[n.child2].boxMax);
+            if (t1 >= 0.0f && t2 >= 0.0f && t1 < t2)
+            {
+                stack.push_back(std::make_pair(t2, n.child2));
+                stack.push_back(std::make_pair(t1, n.child1));
+            }
+            else
+            {
+                if (t1 >= 0.0f) stack.push_back(std::make_pair(t1, n.child1));
+                if (t2 >= 0.0f) stack.push_back(std::make_pair(t2, n.child2));
+            }
+        }
+
+        if (best != none && distance) *distance = bestDistance;
+        return best;
+    }
+}
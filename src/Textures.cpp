@@ -2,6 +2,7 @@
 #include "common/Logger.h"
 #include "Files.h"
 #include "Locator.h"
+#include "Preload.h"
 #include <sstream>
 #include <GL/glew.h>
 
@@ -45,40 +46,21 @@ namespace Arya
     }
 
     shared_ptr<Texture> TextureManager::loadResource( string filename ){
-        filename.insert(0, "textures/");
-        File* imagefile = Locator::getFileSystem().getFile(filename);
+        File* imagefile = Locator::getFileSystem().getFile(string("textures/") + filename);
         if( imagefile == 0 ) return 0;
 
         shared_ptr<Texture> texture = nullptr;
 
-        int width, height, channels;
-        // NOTE: using STBI_default as last arg gives wrong pixel data
-        unsigned char* ptr = stbi_load_from_memory((stbi_uc*)imagefile->getData(), imagefile->getSize(), &width, &height, &channels, STBI_rgb_alpha); 
-        if(ptr)
+        ImageData image;
+        if( decodeImage(imagefile->getData(), imagefile->getSize(), image) )
         {
-            texture = make_shared<Texture>();
-            texture->width = width;
-            texture->height = height;
-
-            glGenTextures(1, &texture->handle);
-            glBindTexture(GL_TEXTURE_2D, texture->handle);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture->width, texture->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptr);
-
-            //high quality, low speed
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            //low quality, high speed
-            //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-
-            addResource(filename, texture);
-
-            stbi_image_free(ptr);
+            texture = createTexture(filename, image);
+            freeImage(image);
+            Locator::getPreloader().record(PRELOAD_TEXTURE, filename);
         }
         else
         {
-            LogError << "Unable to read image data of " << filename << ". Reason: " << stbi_failure_reason() << endLog;
+            LogError << "Unable to read image data of textures/" << filename << ". Reason: " << stbi_failure_reason() << endLog;
         }
 
         //OpenGL has the image data now
@@ -86,6 +68,41 @@ namespace Arya
         return texture;
     }
 
+    bool TextureManager::decodeImage(const char* data, unsigned int size, ImageData& image)
+    {
+        int channels;
+        // NOTE: using STBI_default as last arg gives wrong pixel data
+        image.pixels = stbi_load_from_memory((const stbi_uc*)data, size, &image.width, &image.height, &channels, STBI_rgb_alpha);
+        return image.pixels != 0;
+    }
+
+    void TextureManager::freeImage(ImageData& image)
+    {
+        if( image.pixels ) stbi_image_free(image.pixels);
+        image.pixels = 0;
+    }
+
+    shared_ptr<Texture> TextureManager::createTexture(string name, const ImageData& image)
+    {
+        shared_ptr<Texture> texture = make_shared<Texture>();
+        texture->width = image.width;
+        texture->height = image.height;
+
+        glGenTextures(1, &texture->handle);
+        glBindTexture(GL_TEXTURE_2D, texture->handle);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture->width, texture->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+
+        //high quality, low speed
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        //low quality, high speed
+        //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        addResource(name, texture);
+        return texture;
+    }
+
     void TextureManager::loadDefaultTexture(){
         if( resourceLoaded("default") ) return;
 
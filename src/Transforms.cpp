@@ -0,0 +1,398 @@
+#include "Transforms.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define ARYA_TRANSFORMS_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace Arya
+{
+    const uint32_t TransformSystem::none;
+
+    TransformSystem::TransformSystem()
+    {
+        anyDirty = false;
+        needsSort = false;
+    }
+
+    TransformSystem::~TransformSystem()
+    {
+    }
+
+    uint32_t TransformSystem::create()
+    {
+        uint32_t id;
+        if (freeIds.empty())
+        {
+            id = internalIndex.size();
+            internalIndex.push_back(0);
+        }
+        else
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+
+        if (id < hasPrevious.size())
+            hasPrevious[id] = 0;
+
+        //A transform without parent can go anywhere so it goes last
+        internalIndex[id] = worldMatrices.size();
+        posX.push_back(0.0f);
+        posY.push_back(0.0f);
+        posZ.push_back(0.0f);
+        cosYaw.push_back(1.0f);
+        sinYaw.push_back(0.0f);
+        cosPitch.push_back(1.0f);
+        sinPitch.push_back(0.0f);
+        scaleX.push_back(1.0f);
+        scaleY.push_back(1.0f);
+        scaleZ.push_back(1.0f);
+        parents.push_back(none);
+        childCount.push_back(0);
+        dirty.push_back(0);
+        ids.push_back(id);
+        worldMatrices.push_back(mat4(1.0f));
+        return id;
+    }
+
+    void TransformSystem::destroy(uint32_t id)
+    {
+        uint32_t index = internalIndex[id];
+
+        if (childCount[index] > 0)
+        {
+            for (uint32_t i = 0; i < parents.size(); ++i)
+            {
+                if (parents[i] == index)
+                {
+                    parents[i] = none;
+                    dirty[i] = 1;
+                    anyDirty.store(true, std::memory_order_relaxed);
+                }
+            }
+        }
+        if (parents[index] != none)
+            childCount[parents[index]]--;
+
+        //Move the last transform into the hole. Its parent
+        //could now come after it, and when the order is not sorted
+        //yet it could even have children.
+        uint32_t last = worldMatrices.size() - 1;
+        if (index != last)
+        {
+            moveTransform(last, index);
+            if (parents[index] != none && parents[index] > index)
+                needsSort = true;
+            if (childCount[index] > 0)
+            {
+                for (uint32_t i = 0; i < last; ++i)
+                    if (parents[i] == last) parents[i] = index;
+                needsSort = true;
+            }
+        }
+
+        posX.pop_back();
+        posY.pop_back();
+        posZ.pop_back();
+        cosYaw.pop_back();
+        sinYaw.pop_back();
+        cosPitch.pop_back();
+        sinPitch.pop_back();
+        scaleX.pop_back();
+        scaleY.pop_back();
+        scaleZ.pop_back();
+        parents.pop_back();
+        childCount.pop_back();
+        dirty.pop_back();
+        ids.pop_back();
+        worldMatrices.pop_back();
+
+        internalIndex[id] = none;
+        freeIds.push_back(id);
+    }
+
+    void TransformSystem::moveTransform(uint32_t from, uint32_t to)
+    {
+        posX[to] = posX[from];
+        posY[to] = posY[from];
+        posZ[to] = posZ[from];
+        cosYaw[to] = cosYaw[from];
+        sinYaw[to] = sinYaw[from];
+        cosPitch[to] = cosPitch[from];
+        sinPitch[to] = sinPitch[from];
+        scaleX[to] = scaleX[from];
+        scaleY[to] = scaleY[from];
+        scaleZ[to] = scaleZ[from];
+        parents[to] = parents[from];
+        childCount[to] = childCount[from];
+        dirty[to] = dirty[from];
+        ids[to] = ids[from];
+        worldMatrices[to] = worldMatrices[from];
+        internalIndex[ids[to]] = to;
+    }
+
+    void TransformSystem::storePrevious()
+    {
+        //By id, so reordering the arrays does not affect them
+        previousMatrices.resize(internalIndex.size());
+        hasPrevious.resize(internalIndex.size());
+        for (uint32_t i = 0; i < worldMatrices.size(); ++i)
+        {
+            previousMatrices[ids[i]] = worldMatrices[i];
+            hasPrevious[ids[i]] = 1;
+        }
+    }
+
+    mat4 TransformSystem::getInterpolatedMatrix(uint32_t id, float alpha) const
+    {
+        const mat4& current = worldMatrices[internalIndex[id]];
+        if (id >= hasPrevious.size() || !hasPrevious[id])
+            return current;
+        //Blending the matrices is not exact for rotations
+        //but close enough for the small changes of one step
+        const mat4& previous = previousMatrices[id];
+        return mat4(previous[0] + alpha * (current[0] - previous[0]),
+                previous[1] + alpha * (current[1] - previous[1]),
+                previous[2] + alpha * (current[2] - previous[2]),
+                previous[3] + alpha * (current[3] - previous[3]));
+    }
+
+    void TransformSystem::setPosition(uint32_t id, const vec3& pos)
+    {
+        uint32_t index = internalIndex[id];
+        posX[index] = pos.x;
+        posY[index] = pos.y;
+        posZ[index] = pos.z;
+        dirty[index] = 1;
+        anyDirty.store(true, std::memory_order_relaxed);
+    }
+
+    void TransformSystem::setRotation(uint32_t id, float yaw, float pitch)
+    {
+        //The sines and cosines are computed here, once per change,
+        //so that update only has to multiply and add
+        uint32_t index = internalIndex[id];
+        cosYaw[index] = std::cos(yaw);
+        sinYaw[index] = std::sin(yaw);
+        cosPitch[index] = std::cos(pitch);
+        sinPitch[index] = std::sin(pitch);
+        dirty[index] = 1;
+        anyDirty.store(true, std::memory_order_relaxed);
+    }
+
+    void TransformSystem::setScale(uint32_t id, const vec3& scale)
+    {
+        uint32_t index = internalIndex[id];
+        scaleX[index] = scale.x;
+        scaleY[index] = scale.y;
+        scaleZ[index] = scale.z;
+        dirty[index] = 1;
+        anyDirty.store(true, std::memory_order_relaxed);
+    }
+
+    void TransformSystem::setParent(uint32_t id, uint32_t parentId)
+    {
+        uint32_t index = internalIndex[id];
+        uint32_t parentIndex = (parentId == none ? none : internalIndex[parentId]);
+        if (parents[index] == parentIndex) return;
+
+        if (parents[index] != none)
+            childCount[parents[index]]--;
+        parents[index] = parentIndex;
+        if (parentIndex != none)
+        {
+            childCount[parentIndex]++;
+            if (parentIndex > index)
+                needsSort = true;
+        }
+        dirty[index] = 1;
+        anyDirty.store(true, std::memory_order_relaxed);
+    }
+
+    void TransformSystem::sortHierarchy()
+    {
+        needsSort = false;
+        uint32_t count = worldMatrices.size();
+
+        //Depth in the hierarchy, roots have depth 0
+        vector<uint32_t> depth(count, none);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t d = 0;
+            uint32_t p = i;
+            while (parents[p] != none && depth[p] == none)
+            {
+                p = parents[p];
+                d++;
+                if (d > count) break; //cycle
+            }
+            if (depth[p] != none) d += depth[p];
+            depth[i] = d;
+        }
+
+        vector<uint32_t> order(count);
+        for (uint32_t i = 0; i < count; ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+                [&depth](uint32_t a, uint32_t b) { return depth[a] < depth[b]; });
+
+        vector<uint32_t> newIndex(count);
+        for (uint32_t i = 0; i < count; ++i) newIndex[order[i]] = i;
+
+        auto permute = [&order](auto& v) {
+            auto old = v;
+            for (uint32_t i = 0; i < order.size(); ++i) v[i] = old[order[i]];
+        };
+        permute(posX);
+        permute(posY);
+        permute(posZ);
+        permute(cosYaw);
+        permute(sinYaw);
+        permute(cosPitch);
+        permute(sinPitch);
+        permute(scaleX);
+        permute(scaleY);
+        permute(scaleZ);
+        permute(parents);
+        permute(childCount);
+        permute(ids);
+        permute(worldMatrices);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (parents[i] != none) parents[i] = newIndex[parents[i]];
+            internalIndex[ids[i]] = i;
+            dirty[i] = 1;
+        }
+        anyDirty.store(true, std::memory_order_relaxed);
+    }
+
+    static inline void multiplyMatrix(const mat4& a, const mat4& b, mat4& out)
+    {
+#ifdef ARYA_TRANSFORMS_SSE
+        __m128 a0 = _mm_loadu_ps(&a[0][0]);
+        __m128 a1 = _mm_loadu_ps(&a[1][0]);
+        __m128 a2 = _mm_loadu_ps(&a[2][0]);
+        __m128 a3 = _mm_loadu_ps(&a[3][0]);
+        for (int c = 0; c < 4; ++c)
+        {
+            __m128 r = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+            _mm_storeu_ps(&out[c][0], r);
+        }
+#else
+        out = a * b;
+#endif
+    }
+
+    // Local matrix = translate * rotateZ(yaw) * rotateX(pitch) * scale
+    //
+    //   column 0 = sx * ( cy,     sy,     0  )
+    //   column 1 = sy * ( -sy*cp, cy*cp,  sp )
+    //   column 2 = sz * ( sy*sp,  -cy*sp, cp )
+    //   column 3 = ( px, py, pz, 1 )
+    void TransformSystem::computeLocalMatrices()
+    {
+        uint32_t count = worldMatrices.size();
+        uint32_t i = 0;
+#ifdef ARYA_TRANSFORMS_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (; i + 4 <= count; i += 4)
+        {
+            if (!(dirty[i] | dirty[i+1] | dirty[i+2] | dirty[i+3])) continue;
+
+            __m128 cy = _mm_loadu_ps(&cosYaw[i]);
+            __m128 sy = _mm_loadu_ps(&sinYaw[i]);
+            __m128 cp = _mm_loadu_ps(&cosPitch[i]);
+            __m128 sp = _mm_loadu_ps(&sinPitch[i]);
+            __m128 sx = _mm_loadu_ps(&scaleX[i]);
+            __m128 sY = _mm_loadu_ps(&scaleY[i]);
+            __m128 sz = _mm_loadu_ps(&scaleZ[i]);
+
+            __m128 c0x = _mm_mul_ps(cy, sx);
+            __m128 c0y = _mm_mul_ps(sy, sx);
+            __m128 c0z = zero;
+            __m128 c0w = zero;
+
+            __m128 c1x = _mm_sub_ps(zero, _mm_mul_ps(_mm_mul_ps(sy, cp), sY));
+            __m128 c1y = _mm_mul_ps(_mm_mul_ps(cy, cp), sY);
+            __m128 c1z = _mm_mul_ps(sp, sY);
+            __m128 c1w = zero;
+
+            __m128 c2x = _mm_mul_ps(_mm_mul_ps(sy, sp), sz);
+            __m128 c2y = _mm_sub_ps(zero, _mm_mul_ps(_mm_mul_ps(cy, sp), sz));
+            __m128 c2z = _mm_mul_ps(cp, sz);
+            __m128 c2w = zero;
+
+            __m128 c3x = _mm_loadu_ps(&posX[i]);
+            __m128 c3y = _mm_loadu_ps(&posY[i]);
+            __m128 c3z = _mm_loadu_ps(&posZ[i]);
+            __m128 c3w = one;
+
+            //After transposing, register k holds the column for transform i+k
+            _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+            _MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+            _MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+            _MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+            __m128 col0[4] = { c0x, c0y, c0z, c0w };
+            __m128 col1[4] = { c1x, c1y, c1z, c1w };
+            __m128 col2[4] = { c2x, c2y, c2z, c2w };
+            __m128 col3[4] = { c3x, c3y, c3z, c3w };
+            for (int k = 0; k < 4; ++k)
+            {
+                if (!dirty[i+k]) continue;
+                mat4& m = worldMatrices[i+k];
+                _mm_storeu_ps(&m[0][0], col0[k]);
+                _mm_storeu_ps(&m[1][0], col1[k]);
+                _mm_storeu_ps(&m[2][0], col2[k]);
+                _mm_storeu_ps(&m[3][0], col3[k]);
+            }
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            if (!dirty[i]) continue;
+            mat4& m = worldMatrices[i];
+            m[0] = glm::vec4(cosYaw[i] * scaleX[i], sinYaw[i] * scaleX[i], 0.0f, 0.0f);
+            m[1] = glm::vec4(-sinYaw[i] * cosPitch[i] * scaleY[i], cosYaw[i] * cosPitch[i] * scaleY[i], sinPitch[i] * scaleY[i], 0.0f);
+            m[2] = glm::vec4(sinYaw[i] * sinPitch[i] * scaleZ[i], -cosYaw[i] * sinPitch[i] * scaleZ[i], cosPitch[i] * scaleZ[i], 0.0f);
+            m[3] = glm::vec4(posX[i], posY[i], posZ[i], 1.0f);
+        }
+    }
+
+    void TransformSystem::update()
+    {
+        if (needsSort) sortHierarchy();
+        if (!anyDirty.load(std::memory_order_relaxed)) return;
+        anyDirty.store(false, std::memory_order_relaxed);
+
+        uint32_t count = worldMatrices.size();
+
+        //Parents come first so one pass reaches all descendants
+        for (uint32_t i = 0; i < count; ++i)
+            if (parents[i] != none && dirty[parents[i]])
+                dirty[i] = 1;
+
+        computeLocalMatrices();
+
+        //The parent matrix is final before its children are visited
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (!dirty[i]) continue;
+            if (parents[i] != none)
+            {
+                mat4 local = worldMatrices[i];
+                multiplyMatrix(worldMatrices[parents[i]], local, worldMatrices[i]);
+            }
+            changed.push_back(ids[i]);
+        }
+
+        std::fill(dirty.begin(), dirty.end(), 0);
+    }
+}
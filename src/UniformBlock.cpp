@@ -0,0 +1,45 @@
+#include "UniformBlock.h"
+
+namespace Arya
+{
+    //std140 size and base alignment
+    static unsigned int typeSize(UniformType type, unsigned int* alignment = 0)
+    {
+        unsigned int size = 4, align = 4;
+        switch (type)
+        {
+            case UNIFORMTYPE_INT:
+            case UNIFORMTYPE_FLOAT: size = 4; align = 4; break;
+            case UNIFORMTYPE_VEC2: size = 8; align = 8; break;
+            case UNIFORMTYPE_VEC3: size = 12; align = 16; break;
+            case UNIFORMTYPE_VEC4: size = 16; align = 16; break;
+            case UNIFORMTYPE_MAT4: size = 64; align = 16; break;
+        }
+        if (alignment) *alignment = align;
+        return size;
+    }
+
+    unsigned int UniformLayout::add(const string& name, UniformType type)
+    {
+        unsigned int alignment;
+        unsigned int bytes = typeSize(type, &alignment);
+
+        //size is rounded up to 16 so start at the end of the last field
+        unsigned int end = 0;
+        if (!fields.empty())
+            end = fields.back().offset + typeSize(fields.back().type);
+
+        unsigned int offset = (end + alignment - 1) / alignment * alignment;
+        fields.push_back(Field{name, type, offset});
+        size = (offset + bytes + 15) / 16 * 16;
+        return offset;
+    }
+
+    int UniformLayout::getOffset(const string& name) const
+    {
+        for (auto& f : fields)
+            if (f.name == name)
+                return f.offset;
+        return -1;
+    }
+}
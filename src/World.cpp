@@ -1,42 +1,270 @@
 #include "World.h"
+#include "AnimationVertex.h"
 #include "Entity.h"
+#include "GraphicsComponent.h"
+#include "Jobs.h"
+#include "Locator.h"
 #include "Terrain.h"
+#include <cmath>
 
 namespace Arya
 {
+    //Number of entities per job in update
+    //This must not depend on the number of threads
+    static const unsigned int updateGrainSize = 64;
+
+    //Deferred changes of the chunk that the current thread is updating
+    static thread_local vector<function<void()>>* currentChanges = 0;
+
     World::World()
     {
+        updating = false;
+        interpolating = false;
+        interpolationAlpha = 1.0f;
+        animations = make_shared<VertexAnimationSystem>();
         terrain = new Terrain;
         //skybox = new Skybox;
     }
 
     World::~World()
     {
+        // Entities owned by a shared_ptr might outlive World
+        // so they have to forget about it
+        for (unsigned int i = entities.size(); i-- > 0; )
+        {
+            Entity* e = entities[i];
+            if (slots[e->handle.index].ownedByWorld)
+                delete e;
+            else
+            {
+                e->world = 0;
+                e->transform = TransformSystem::none;
+                e->bounds = SpatialIndex::none;
+            }
+        }
+        entities.clear();
+
         //delete skybox;
         delete terrain;
     }
 
     void World::update(float elapsedTime)
     {
-        // Remove expired entities from the list while updating
-        shared_ptr<Entity> ent;
-        for (auto e = entities.begin(); e != entities.end();)
+        unsigned int count = entities.size();
+        unsigned int chunkCount = (count + updateGrainSize - 1) / updateGrainSize;
+        if (chunkChanges.size() < chunkCount)
+            chunkChanges.resize(chunkCount);
+
+        JobSystem& jobs = Locator::getJobSystem();
+
+        // The matrices of the last update, as computed by updateBounds
+        if (interpolating)
+            transforms.storePrevious();
+
+        animations->update(elapsedTime, &jobs);
+
+        updating = true;
+        auto updateChunk = [this, elapsedTime](unsigned int begin, unsigned int end) {
+            currentChanges = &chunkChanges[begin / updateGrainSize];
+            for (unsigned int i = begin; i < end; ++i)
+                entities[i]->update(elapsedTime);
+            currentChanges = 0;
+        };
+        jobs.parallelFor(count, updateGrainSize, updateChunk);
+        updating = false;
+
+        // Sync point: apply the deferred changes in entity order
+        for (unsigned int c = 0; c < chunkCount; ++c)
         {
-            ent = e->lock();
-            if (!ent)
-            {
-                e = entities.erase(e);
-            }
-            else
-            {
-                ent->update(elapsedTime);
-                e++;
-            }
+            for (auto& change : chunkChanges[c])
+                change();
+            chunkChanges[c].clear();
+        }
+        for (auto& change : otherChanges)
+            change();
+        otherChanges.clear();
+
+        updateBounds();
+    }
+
+    void World::setInterpolation(bool enabled)
+    {
+        interpolating = enabled;
+        interpolationAlpha = 1.0f;
+    }
+
+    void World::setBounds(Entity* e)
+    {
+        const mat4& m = transforms.getWorldMatrix(e->transform);
+        vec3 localMin(0.0f), localMax(0.0f);
+        GraphicsComponent* gr = e->graphicsComponent.get();
+        if (!gr || !gr->getLocalBounds(localMin, localMax))
+            localMin = localMax = vec3(0.0f);
+
+        //Box around the transformed box
+        vec3 center = 0.5f * (localMin + localMax);
+        vec3 extent = 0.5f * (localMax - localMin);
+        vec3 worldCenter = vec3(m * vec4(center, 1.0f));
+        vec3 worldExtent;
+        for (int i = 0; i < 3; ++i)
+            worldExtent[i] = std::fabs(m[0][i]) * extent.x + std::fabs(m[1][i]) * extent.y + std::fabs(m[2][i]) * extent.z;
+
+        if (e->bounds == SpatialIndex::none)
+            e->bounds = spatialIndex.insert(worldCenter - worldExtent, worldCenter + worldExtent, e->handle.index);
+        else
+            spatialIndex.move(e->bounds, worldCenter - worldExtent, worldCenter + worldExtent);
+    }
+
+    void World::updateBounds()
+    {
+        transforms.update();
+
+        for (uint32_t id : transforms.getChanged())
+        {
+            //The transform could be destroyed since
+            if (id >= transformSlots.size() || transformSlots[id] == TransformSystem::none) continue;
+            dirtyBounds.push_back(transformSlots[id]);
+        }
+        transforms.clearChanged();
+
+        for (uint32_t index : dirtyBounds)
+        {
+            const EntitySlot& slot = slots[index];
+            Entity* e = (slot.denseIndex < entities.size() ? entities[slot.denseIndex] : 0);
+            if (e && e->handle.index == index)
+                setBounds(e);
+        }
+        dirtyBounds.clear();
+    }
+
+    void World::markBoundsDirty(Entity* e)
+    {
+        dirtyBounds.push_back(e->handle.index);
+    }
+
+    void World::collectQueryResult(EntityList& result)
+    {
+        for (uint32_t index : queryResult)
+            result.push_back(entities[slots[index].denseIndex]);
+        queryResult.clear();
+    }
+
+    void World::queryBox(const vec3& boxMin, const vec3& boxMax, EntityList& result)
+    {
+        updateBounds();
+        spatialIndex.queryBox(boxMin, boxMax, queryResult);
+        collectQueryResult(result);
+    }
+
+    void World::querySphere(const vec3& center, float radius, EntityList& result)
+    {
+        updateBounds();
+        spatialIndex.querySphere(center, radius, queryResult);
+        collectQueryResult(result);
+    }
+
+    void World::queryFrustum(const mat4& viewProjection, EntityList& result)
+    {
+        updateBounds();
+        spatialIndex.queryFrustum(viewProjection, queryResult);
+        collectQueryResult(result);
+    }
+
+    Entity* World::raycast(const vec3& origin, const vec3& direction, float maxDistance, float* distance)
+    {
+        updateBounds();
+        uint32_t index = spatialIndex.raycast(origin, direction, maxDistance, distance);
+        if (index == SpatialIndex::none) return nullptr;
+        return entities[slots[index].denseIndex];
+    }
+
+    EntityHandle World::createEntity()
+    {
+        Entity* e = new Entity(Entity::this_is_private{});
+        addEntity(e, true);
+        return e->handle;
+    }
+
+    void World::applyChange(function<void()> change)
+    {
+        if (!updating)
+            change();
+        else if (currentChanges)
+            currentChanges->push_back(std::move(change));
+        else
+        {
+            std::lock_guard<std::mutex> lock(otherChangesMutex);
+            otherChanges.push_back(std::move(change));
         }
     }
 
-    void World::addEntity(weak_ptr<Entity> e)
+    void World::destroyEntity(EntityHandle handle)
     {
+        if (updating)
+        {
+            applyChange([this, handle]() { destroyEntity(handle); });
+            return;
+        }
+        Entity* e = getEntity(handle);
+        if (e && slots[handle.index].ownedByWorld)
+            delete e;
+    }
+
+    void World::addEntity(Entity* e, bool ownedByWorld)
+    {
+        uint32_t index;
+        if (freeSlots.empty())
+        {
+            index = slots.size();
+            slots.push_back(EntitySlot{0, 0, false});
+        }
+        else
+        {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+
+        EntitySlot& slot = slots[index];
+        slot.denseIndex = entities.size();
+        slot.ownedByWorld = ownedByWorld;
         entities.push_back(e);
+
+        e->world = this;
+        e->handle = EntityHandle(index, slot.generation);
+
+        e->transform = transforms.create();
+        transforms.setPosition(e->transform, e->position);
+        transforms.setRotation(e->transform, e->yaw, e->pitch);
+        e->updateScale();
+
+        //The bounds are added by updateBounds, as the transform is dirty
+        if (transformSlots.size() <= e->transform)
+            transformSlots.resize(e->transform + 1, TransformSystem::none);
+        transformSlots[e->transform] = index;
+    }
+
+    void World::removeEntity(Entity* e)
+    {
+        EntitySlot& slot = slots[e->handle.index];
+
+        // Move the last entity into the hole
+        Entity* last = entities.back();
+        entities[slot.denseIndex] = last;
+        slots[last->handle.index].denseIndex = slot.denseIndex;
+        entities.pop_back();
+
+        // Invalidates all handles to this slot
+        slot.generation++;
+        freeSlots.push_back(e->handle.index);
+
+        transforms.destroy(e->transform);
+        transformSlots[e->transform] = TransformSystem::none;
+        if (e->bounds != SpatialIndex::none)
+            spatialIndex.remove(e->bounds);
+
+        e->world = 0;
+        e->handle = EntityHandle();
+        e->transform = TransformSystem::none;
+        e->bounds = SpatialIndex::none;
     }
 }
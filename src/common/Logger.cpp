@@ -1,6 +1,16 @@
 #include "common/Logger.h"
 #include <ctime>
 #include <iostream>
+#include <fstream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
 
 //Color output into terminals
 #ifdef __linux__
@@ -12,30 +22,220 @@ namespace Arya
     //The global object
     Logger logger;
 
+    static std::atomic<int> loggerCount(0);
+
+    //Bounded multi-producer queue of messages (Vyukov), read by the writer thread.
+    //All loggers share it, so messages of the engine and the game are written
+    //in the order they were logged and lines never end up inside each other.
+    //The strings in the slots keep their capacity, so after a while
+    //pushing a message does not allocate.
+    struct Logger::Queue
+    {
+        struct Slot
+        {
+            std::atomic<unsigned int> sequence;
+            const Logger* owner;
+            LOGLEVEL level;
+            std::time_t time;
+            const char* file;
+            int line;
+            std::string text;
+        };
+
+        static const unsigned int capacity = 1024; //power of two
+        std::unique_ptr<Slot[]> slots;
+        std::atomic<unsigned int> enqueuePos;
+        unsigned int dequeuePos; //only used by the writer thread
+        std::atomic<unsigned int> writtenCount;
+
+        std::thread thread;
+        std::mutex startMutex;
+        std::atomic<bool> running;
+        std::atomic<bool> sleeping;
+        std::mutex wakeMutex;
+        std::condition_variable wake;
+
+        //Held by the writer thread while it writes, guards stdout,
+        //the outputs of the loggers and the list of loggers
+        std::mutex outputMutex;
+        std::vector<const Logger*> loggers;
+        bool colorOutput;
+        std::string output; //a line for stdout, written with one call
+        std::chrono::steady_clock::time_point lastSweep;
+
+        Queue() : enqueuePos(0), dequeuePos(0), writtenCount(0),
+            running(false), sleeping(false), colorOutput(false)
+        {
+            slots.reset(new Slot[capacity]);
+            for (unsigned int i = 0; i < capacity; ++i)
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        ~Queue()
+        {
+            stop();
+        }
+
+        bool hasMessage() const
+        {
+            return slots[dequeuePos & (capacity - 1)].sequence.load(std::memory_order_acquire) == dequeuePos + 1;
+        }
+
+        void start();
+        void stop();
+        void run();
+        void print(LOGLEVEL level, const std::string& text);
+    };
+
+    //The outputs of one logger, used by the writer thread while it
+    //holds the output mutex
+    struct Logger::Writer
+    {
+        //A message that was written recently, see setRepeatInterval
+        struct Repeat
+        {
+            const char* file;
+            int line;
+            LOGLEVEL level;
+            std::string text;
+            unsigned int count; //not written since start
+            std::chrono::steady_clock::time_point start;
+        };
+
+        std::ofstream filestream;
+        std::time_t stampTime; //timestamp is only formatted when the second changes
+        char stamp[80];
+
+        //Keyed by a hash of the message
+        std::atomic<int> repeatInterval; //milliseconds
+        static const unsigned int maxRepeats = 1024;
+        std::unordered_map<std::size_t, Repeat> repeats;
+        std::string summary;
+
+        //Messages for the callback, passed on by dispatchCallback
+        std::vector<std::string> callbackBatch; //written since the last pass
+        std::atomic<bool> hasCallback;
+        std::mutex callbackMutex;
+        std::deque<std::string> callbackLines;
+
+        Writer() : stampTime(0), repeatInterval(5000), hasCallback(false)
+        {
+            stamp[0] = 0;
+        }
+
+        void process(const Logger& owner, const Queue::Slot& slot);
+        bool sweepRepeats(const Logger& owner, bool all);
+        void writeRepeat(const Logger& owner, Repeat& repeat);
+        void write(const Logger& owner, LOGLEVEL level, std::time_t time, const std::string& text);
+        void passCallbackLines();
+    };
+
+    Logger::Queue& Logger::queue()
+    {
+        //Created by the first logger, so it is destroyed after the last one
+        static Queue q;
+        return q;
+    }
+
     Logger::Logger()
     {
         stdoutLogLevel = L_INFO | L_WARNING | L_ERROR | L_CRITICALERROR | L_DEBUG;
         fileLogLevel = L_WARNING | L_ERROR | L_CRITICALERROR;
         callbackLogLevel = L_INFO | L_WARNING | L_ERROR | L_CRITICALERROR | L_DEBUG;
-        currentLogLevel = L_NONE;
         callbackFunc = nullptr;
+        hasCallback = false;
+        index = loggerCount++ % maxLoggers;
+        writer.reset(new Writer);
+
+        Queue& q = queue();
+        std::lock_guard<std::mutex> lock(q.outputMutex);
+        q.loggers.push_back(this);
     }
 
     Logger::~Logger()
     {
-        filestream.close();
+        //The writer thread writes what is left of this logger
+        Queue& q = queue();
+        sync();
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(q.outputMutex);
+            //Counts that were not written yet
+            if (writer->sweepRepeats(*this, true))
+            {
+                std::cout.flush();
+                writer->filestream.flush();
+            }
+            q.loggers.erase(std::remove(q.loggers.begin(), q.loggers.end(), this), q.loggers.end());
+            last = q.loggers.empty();
+        }
+        if (last)
+            q.stop();
+        writer->filestream.close();
+    }
+
+    LogRecord& Logger::record()
+    {
+        static thread_local LogRecord records[maxLoggers];
+        return records[index];
     }
 
     bool Logger::setOutputFile(const char* filename, bool append)
     {
         using std::ofstream;
-        filestream.open(filename, (append ? ofstream::out | ofstream::app : ofstream::out));
-        return filestream.is_open();
+        std::lock_guard<std::mutex> lock(queue().outputMutex);
+        writer->filestream.open(filename, (append ? ofstream::out | ofstream::app : ofstream::out));
+        return writer->filestream.is_open();
     }
 
     void Logger::closeOutputFile()
     {
-        filestream.close();
+        std::lock_guard<std::mutex> lock(queue().outputMutex);
+        writer->filestream.close();
+    }
+
+    void Logger::setLoggerCallback(std::function<void(const std::string&)> func)
+    {
+        callbackFunc = func;
+        hasCallback = (func != nullptr);
+        writer->hasCallback = (func != nullptr);
+        if (!func)
+        {
+            std::lock_guard<std::mutex> lock(writer->callbackMutex);
+            writer->callbackLines.clear();
+        }
+    }
+
+    void Logger::dispatchCallback()
+    {
+        std::deque<std::string> lines;
+        {
+            std::lock_guard<std::mutex> lock(writer->callbackMutex);
+            lines.swap(writer->callbackLines);
+        }
+        if (callbackFunc)
+            for (auto& line : lines)
+                callbackFunc(line);
+    }
+
+    void Logger::sync()
+    {
+        Queue& q = queue();
+        if (!q.running) return;
+        unsigned int target = q.enqueuePos.load();
+        while ((int)(q.writtenCount.load() - target) < 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(q.wakeMutex);
+            }
+            q.wake.notify_one();
+            std::this_thread::yield();
+        }
+    }
+
+    void Logger::setRepeatInterval(float seconds)
+    {
+        writer->repeatInterval = (seconds > 0.0f ? int(seconds * 1000.0f) : 0);
     }
 
     Logger& endLog(Logger& logger)
@@ -46,47 +246,273 @@ namespace Arya
 
     void Logger::flush()
     {
-        if( stdoutLogLevel & currentLogLevel ){
-            bool colorOutput = false;
+        LogRecord& rec = record();
+        LOGLEVEL level = rec.level;
+        rec.level = L_NONE;
+        if( !isEnabled(level) ) return;
+
+        Queue& w = queue();
+        if (!w.running)
+            w.start();
+
+        //Claim a slot, waiting for the writer when the ring is full
+        unsigned int pos = w.enqueuePos.load(std::memory_order_relaxed);
+        Queue::Slot* slot;
+        while (true)
+        {
+            slot = &w.slots[pos & (Queue::capacity - 1)];
+            unsigned int sequence = slot->sequence.load(std::memory_order_acquire);
+            int diff = (int)(sequence - pos);
+            if (diff == 0)
+            {
+                if (w.enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                std::this_thread::yield();
+                pos = w.enqueuePos.load(std::memory_order_relaxed);
+            }
+            else
+                pos = w.enqueuePos.load(std::memory_order_relaxed);
+        }
+        slot->owner = this;
+        slot->level = level;
+        slot->time = std::time(NULL);
+        slot->file = rec.file;
+        slot->line = rec.line;
+        slot->text.assign(rec.buffer.text);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+
+        if (w.sleeping)
+        {
+            {
+                std::lock_guard<std::mutex> lock(w.wakeMutex);
+            }
+            w.wake.notify_one();
+        }
+
+        //Make sure it is out before a crash
+        if (level == L_CRITICALERROR)
+            sync();
+    }
+
+    void Logger::Queue::start()
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        if (running) return;
 #ifdef __linux
-            //check if standard output is actually a terminal and not forwarded to a file
-            if (isatty(fileno(stdout))) colorOutput = true;
+        //check if standard output is actually a terminal and not forwarded to a file
+        colorOutput = (isatty(fileno(stdout)) != 0);
 #endif
-            if (colorOutput) {
-                switch(currentLogLevel) {
-                    case L_CRITICALERROR:
-                    case L_ERROR:
-                        std::cout << "\x1b[31m";
-                        break;
-                    case L_WARNING:
-                        std::cout << "\x1b[33m";
-                        break;
-                    case L_INFO:
-                        std::cout << "\x1b[32m";
-                        break;
-                    default:
-                        break;
+        lastSweep = std::chrono::steady_clock::now();
+        running = true;
+        thread = std::thread([this]() { run(); });
+    }
+
+    void Logger::Queue::stop()
+    {
+        //The writer thread writes what is left before it stops
+        std::lock_guard<std::mutex> lock(startMutex);
+        if (!running) return;
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            running = false;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    void Logger::Queue::run()
+    {
+        while (true)
+        {
+            bool wrote = false;
+            {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                while (hasMessage())
+                {
+                    Slot& slot = slots[dequeuePos & (capacity - 1)];
+                    slot.owner->writer->process(*slot.owner, slot);
+                    slot.sequence.store(dequeuePos + capacity, std::memory_order_release);
+                    dequeuePos++;
+                    writtenCount++;
+                    wrote = true;
+                }
+                //Summaries of the messages that were repeated
+                auto now = std::chrono::steady_clock::now();
+                if (now - lastSweep > std::chrono::milliseconds(100))
+                {
+                    lastSweep = now;
+                    for (auto owner : loggers)
+                        if (owner->writer->sweepRepeats(*owner, false))
+                            wrote = true;
                 }
-                std::cout << streambuff.str();
-                std::cout << "\x1b[0m" << std::endl;
-            } else {
-                std::cout << streambuff.str() << std::endl;
+                //One flush for the whole batch
+                if (wrote)
+                {
+                    std::cout.flush();
+                    for (auto owner : loggers)
+                        owner->writer->filestream.flush();
+                }
+                for (auto owner : loggers)
+                    owner->writer->passCallbackLines();
+            }
+            if (wrote) continue;
+
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            if (!running && !hasMessage()) break;
+            sleeping = true;
+            wake.wait_for(lock, std::chrono::milliseconds(50),
+                    [this]() { return !running || hasMessage(); });
+            sleeping = false;
+        }
+    }
+
+    void Logger::Queue::print(LOGLEVEL level, const std::string& text)
+    {
+        //One write for the whole line, escape codes included
+        output.clear();
+        if (colorOutput) {
+            switch(level) {
+                case L_CRITICALERROR:
+                case L_ERROR:
+                    output.append("\x1b[31m");
+                    break;
+                case L_WARNING:
+                    output.append("\x1b[33m");
+                    break;
+                case L_INFO:
+                    output.append("\x1b[32m");
+                    break;
+                default:
+                    break;
+            }
+            output.append(text);
+            output.append("\x1b[0m");
+        } else {
+            output.append(text);
+        }
+        output.push_back('\n');
+        std::cout.write(output.data(), output.size());
+    }
+
+    void Logger::Writer::passCallbackLines()
+    {
+        if (callbackBatch.empty()) return;
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        for (auto& line : callbackBatch)
+            callbackLines.push_back(std::move(line));
+        //Nobody is reading them
+        while (callbackLines.size() > 2000)
+            callbackLines.pop_front();
+        callbackBatch.clear();
+    }
+
+    void Logger::Writer::process(const Logger& owner, const Queue::Slot& slot)
+    {
+        int interval = repeatInterval.load(std::memory_order_relaxed);
+        if (interval <= 0 || slot.level == L_CRITICALERROR || slot.file == 0)
+        {
+            write(owner, slot.level, slot.time, slot.text);
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        std::size_t key = std::hash<std::string>()(slot.text);
+        key ^= std::hash<const void*>()(slot.file) + 0x9e3779b9 + (key << 6) + (key >> 2);
+        key ^= std::size_t(slot.line) * 31 + slot.level;
+
+        auto it = repeats.find(key);
+        if (it == repeats.end())
+        {
+            //Too many different messages, do not keep track of more
+            if (repeats.size() < maxRepeats)
+                repeats.emplace(key, Repeat{slot.file, slot.line, slot.level, slot.text, 0, now});
+            write(owner, slot.level, slot.time, slot.text);
+            return;
+        }
+
+        Repeat& repeat = it->second;
+        if (repeat.file == slot.file && repeat.line == slot.line
+                && repeat.level == slot.level && repeat.text == slot.text)
+        {
+            if (now - repeat.start < std::chrono::milliseconds(interval))
+            {
+                repeat.count++;
+                return;
+            }
+            //The summary includes this message
+            if (repeat.count > 0)
+            {
+                repeat.count++;
+                writeRepeat(owner, repeat);
+                repeat.start = now;
+                return;
             }
         }
-        if( fileLogLevel & currentLogLevel ){
-            char buf[80];
-            std::time_t now = std::time(NULL);
-            strftime(buf, sizeof(buf), "[%Y-%m-%d %X] ", std::localtime(&now));
-            filestream << buf << streambuff.str() << std::endl;
+        else
+        {
+            //Hash collision, the newest message takes the entry
+            repeat.file = slot.file;
+            repeat.line = slot.line;
+            repeat.level = slot.level;
+            repeat.text = slot.text;
+            repeat.count = 0;
         }
-        if(callbackFunc)
-            if(callbackLogLevel & currentLogLevel)
-                callbackFunc(streambuff.str());
+        repeat.start = now;
+        write(owner, slot.level, slot.time, slot.text);
+    }
 
-        currentLogLevel = L_NONE;
-        streambuff.str(std::string());
-        streambuff.seekp(0);
-        streambuff.clear();
+    bool Logger::Writer::sweepRepeats(const Logger& owner, bool all)
+    {
+        bool wrote = false;
+        auto now = std::chrono::steady_clock::now();
+        auto interval = std::chrono::milliseconds(repeatInterval.load(std::memory_order_relaxed));
+        for (auto it = repeats.begin(); it != repeats.end(); )
+        {
+            Repeat& repeat = it->second;
+            if (!all && now - repeat.start < interval)
+            {
+                ++it;
+                continue;
+            }
+            if (repeat.count > 0)
+            {
+                writeRepeat(owner, repeat);
+                repeat.start = now;
+                wrote = true;
+                ++it;
+            }
+            else
+                it = repeats.erase(it);
+        }
+        return wrote;
+    }
+
+    void Logger::Writer::writeRepeat(const Logger& owner, Repeat& repeat)
+    {
+        summary.assign(repeat.text);
+        summary.append(" (repeated ");
+        summary.append(std::to_string(repeat.count));
+        summary.append(repeat.count == 1 ? " time)" : " times)");
+        repeat.count = 0;
+        write(owner, repeat.level, std::time(NULL), summary);
+    }
+
+    void Logger::Writer::write(const Logger& owner, LOGLEVEL level, std::time_t time, const std::string& text)
+    {
+        if (hasCallback && (owner.callbackLogLevel & level))
+            callbackBatch.push_back(text);
+        if( owner.stdoutLogLevel & level )
+            queue().print(level, text);
+        if( (owner.fileLogLevel & level) && filestream.is_open() ){
+            if (time != stampTime) {
+                stampTime = time;
+                strftime(stamp, sizeof(stamp), "[%Y-%m-%d %X] ", std::localtime(&stampTime));
+            }
+            filestream << stamp << text << '\n';
+        }
     }
 
 }
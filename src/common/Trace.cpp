@@ -0,0 +1,338 @@
+#include "common/Trace.h"
+#include "common/Logger.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <algorithm>
+
+namespace Arya
+{
+    //The global object
+    Tracer tracer;
+
+    static const uint64_t recordMask = Tracer::recordsPerThread - 1;
+
+    //Ring buffer of one thread. A record is stored as four atomic words so
+    //that dump and the stream can copy records while the thread writes.
+    //Records that were overwritten during the copy are left out.
+    struct Tracer::Buffer
+    {
+        uint16_t thread;
+        std::atomic<uint64_t> position; //records written, only changed by the owner
+        uint64_t streamed; //only used by the stream
+        std::unique_ptr<std::atomic<uint64_t>[]> words;
+
+        Buffer(uint16_t thread) : thread(thread), position(0), streamed(0),
+            words(new std::atomic<uint64_t>[4 * recordsPerThread]()) {}
+
+        //Appends the records [from, position) that are still there
+        //Returns the first record that was copied, the ones before were lost
+        uint64_t copy(uint64_t from, std::vector<TraceRecord>& out, uint64_t& next) const;
+    };
+
+    struct Tracer::Data
+    {
+        std::chrono::steady_clock::time_point start;
+
+        std::mutex buffersMutex;
+        std::vector<std::unique_ptr<Buffer>> buffers;
+        std::vector<Buffer*> freeBuffers; //of threads that have ended
+
+        std::mutex namesMutex;
+        std::vector<std::pair<uint32_t, string>> events;
+        std::vector<std::pair<uint32_t, string>> strings;
+        std::map<string, int32_t> stringIds;
+
+        //The stream, guarded by streamMutex
+        std::mutex streamMutex;
+        std::condition_variable streamWake;
+        std::thread streamThread;
+        bool streaming;
+        std::ofstream stream;
+        size_t eventsWritten, stringsWritten;
+        std::vector<TraceRecord> streamRecords;
+
+        void streamLoop();
+        void writeStreamChunk();
+    };
+
+    //Gives the buffer back when the thread ends, so that threads that
+    //come and go do not add buffers
+    struct TraceThread
+    {
+        Tracer::Buffer* buffer = 0;
+        ~TraceThread() { if (buffer) tracer.releaseBuffer(buffer); }
+    };
+    static thread_local TraceThread traceThread;
+
+    static void writeHeader(std::ostream& out)
+    {
+        TraceFileHeader header = { traceMagic, traceVersion, sizeof(TraceRecord), 0 };
+        out.write((const char*)&header, sizeof(header));
+    }
+
+    static void writeNames(std::ostream& out, TraceChunkType type,
+            const std::vector<std::pair<uint32_t, string>>& names, size_t first)
+    {
+        if (first >= names.size()) return;
+        TraceChunk chunk = { (uint32_t)type, 0 };
+        for (size_t i = first; i < names.size(); ++i)
+            chunk.size += 2 * sizeof(uint32_t) + names[i].second.size();
+        out.write((const char*)&chunk, sizeof(chunk));
+        for (size_t i = first; i < names.size(); ++i)
+        {
+            uint32_t entry[2] = { names[i].first, (uint32_t)names[i].second.size() };
+            out.write((const char*)entry, sizeof(entry));
+            out.write(names[i].second.data(), names[i].second.size());
+        }
+    }
+
+    static void writeRecords(std::ostream& out, std::vector<TraceRecord>& records)
+    {
+        if (records.empty()) return;
+        //Every thread is in order, the file is in order of time
+        std::stable_sort(records.begin(), records.end(),
+                [](const TraceRecord& a, const TraceRecord& b) { return a.time < b.time; });
+        TraceChunk chunk = { TRACE_CHUNK_RECORDS, (uint32_t)(records.size() * sizeof(TraceRecord)) };
+        out.write((const char*)&chunk, sizeof(chunk));
+        out.write((const char*)records.data(), records.size() * sizeof(TraceRecord));
+    }
+
+    uint64_t Tracer::Buffer::copy(uint64_t from, std::vector<TraceRecord>& out, uint64_t& next) const
+    {
+        uint64_t end = position.load(std::memory_order_acquire);
+        uint64_t begin = std::max(from, end > recordsPerThread ? end - recordsPerThread : 0);
+        size_t first = out.size();
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            const std::atomic<uint64_t>* w = &words[(i & recordMask) * 4];
+            uint64_t header = w[1].load(std::memory_order_relaxed);
+            uint64_t args01 = w[2].load(std::memory_order_relaxed);
+            uint64_t args23 = w[3].load(std::memory_order_relaxed);
+            TraceRecord r;
+            r.time = w[0].load(std::memory_order_relaxed);
+            r.duration = (uint32_t)header;
+            r.event = (uint16_t)(header >> 32);
+            r.thread = (uint16_t)(header >> 48);
+            r.args[0] = (int32_t)(uint32_t)args01;
+            r.args[1] = (int32_t)(uint32_t)(args01 >> 32);
+            r.args[2] = (int32_t)(uint32_t)args23;
+            r.args[3] = (int32_t)(uint32_t)(args23 >> 32);
+            out.push_back(r);
+        }
+
+        //Record i is overwritten by record i + recordsPerThread, which
+        //can be in progress while position is at it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = position.load(std::memory_order_relaxed);
+        uint64_t valid = (after >= recordsPerThread ? after - recordsPerThread + 1 : 0);
+        if (valid > begin)
+        {
+            uint64_t lost = std::min(valid, end) - begin;
+            out.erase(out.begin() + first, out.begin() + first + lost);
+            begin += lost;
+        }
+        next = end;
+        return begin;
+    }
+
+    Tracer::Tracer() : enabled(true), data(new Data)
+    {
+        data->start = std::chrono::steady_clock::now();
+        data->streaming = false;
+        data->eventsWritten = data->stringsWritten = 0;
+        registerEvent(TRACE_DROPPED, "dropped", "thread,count");
+        registerEvent(TRACE_FRAME, "frame", "frame");
+        registerEvent(TRACE_SIMULATE, "simulate", "steps");
+        registerEvent(TRACE_RESOURCE_LOAD, "resource load", "$file,loaded");
+    }
+
+    Tracer::~Tracer()
+    {
+        stopStream();
+    }
+
+    uint64_t Tracer::now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - data->start).count();
+    }
+
+    void Tracer::registerEvent(uint16_t id, const string& name, const string& argNames)
+    {
+        std::lock_guard<std::mutex> lock(data->namesMutex);
+        //A new entry also when it is registered again, the last one counts
+        data->events.push_back(std::make_pair((uint32_t)id, name + "|" + argNames));
+    }
+
+    int32_t Tracer::intern(const string& text)
+    {
+        std::lock_guard<std::mutex> lock(data->namesMutex);
+        auto it = data->stringIds.find(text);
+        if (it != data->stringIds.end()) return it->second;
+        int32_t id = (int32_t)data->strings.size();
+        data->stringIds.insert(std::make_pair(text, id));
+        data->strings.push_back(std::make_pair((uint32_t)id, text));
+        return id;
+    }
+
+    Tracer::Buffer* Tracer::acquireBuffer()
+    {
+        std::lock_guard<std::mutex> lock(data->buffersMutex);
+        if (!data->freeBuffers.empty())
+        {
+            Buffer* buffer = data->freeBuffers.back();
+            data->freeBuffers.pop_back();
+            return buffer;
+        }
+        data->buffers.emplace_back(new Buffer((uint16_t)data->buffers.size()));
+        return data->buffers.back().get();
+    }
+
+    void Tracer::releaseBuffer(Buffer* buffer)
+    {
+        std::lock_guard<std::mutex> lock(data->buffersMutex);
+        data->freeBuffers.push_back(buffer);
+    }
+
+    void Tracer::record(uint16_t event, uint64_t time, uint64_t duration,
+            int32_t a, int32_t b, int32_t c, int32_t d)
+    {
+        Buffer* buffer = traceThread.buffer;
+        if (!buffer)
+            buffer = traceThread.buffer = acquireBuffer();
+
+        uint64_t pos = buffer->position.load(std::memory_order_relaxed);
+        std::atomic<uint64_t>* w = &buffer->words[(pos & recordMask) * 4];
+        uint64_t header = std::min(duration, (uint64_t)UINT32_MAX)
+            | ((uint64_t)event << 32) | ((uint64_t)buffer->thread << 48);
+        //A reader that sees these words also sees the position before them
+        std::atomic_thread_fence(std::memory_order_release);
+        w[0].store(time, std::memory_order_relaxed);
+        w[1].store(header, std::memory_order_relaxed);
+        w[2].store((uint64_t)(uint32_t)a | ((uint64_t)(uint32_t)b << 32), std::memory_order_relaxed);
+        w[3].store((uint64_t)(uint32_t)c | ((uint64_t)(uint32_t)d << 32), std::memory_order_relaxed);
+        buffer->position.store(pos + 1, std::memory_order_release);
+    }
+
+    bool Tracer::dump(const string& filename)
+    {
+        std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            LogWarning << "Could not write trace to " << filename << endLog;
+            return false;
+        }
+
+        writeHeader(file);
+        {
+            std::lock_guard<std::mutex> lock(data->namesMutex);
+            writeNames(file, TRACE_CHUNK_EVENTS, data->events, 0);
+            writeNames(file, TRACE_CHUNK_STRINGS, data->strings, 0);
+        }
+        std::vector<TraceRecord> records;
+        {
+            std::lock_guard<std::mutex> lock(data->buffersMutex);
+            uint64_t next;
+            for (auto& buffer : data->buffers)
+                buffer->copy(0, records, next);
+        }
+        size_t count = records.size();
+        writeRecords(file, records);
+        LogInfo << "Wrote " << count << " trace records to " << filename << endLog;
+        return true;
+    }
+
+    bool Tracer::startStream(const string& filename)
+    {
+        stopStream();
+
+        std::lock_guard<std::mutex> lock(data->streamMutex);
+        data->stream.open(filename.c_str(), std::ios::binary | std::ios::trunc);
+        if (!data->stream.is_open())
+        {
+            LogWarning << "Could not open trace stream " << filename << endLog;
+            return false;
+        }
+        writeHeader(data->stream);
+        data->eventsWritten = data->stringsWritten = 0;
+        {
+            //Starts with what is in the buffers now
+            std::lock_guard<std::mutex> lock(data->buffersMutex);
+            for (auto& buffer : data->buffers)
+            {
+                uint64_t position = buffer->position.load();
+                buffer->streamed = (position > recordsPerThread ? position - recordsPerThread : 0);
+            }
+        }
+        data->streaming = true;
+        data->streamThread = std::thread([this]() { data->streamLoop(); });
+        return true;
+    }
+
+    void Tracer::stopStream()
+    {
+        {
+            std::lock_guard<std::mutex> lock(data->streamMutex);
+            if (!data->streaming) return;
+            data->streaming = false;
+        }
+        data->streamWake.notify_one();
+        data->streamThread.join();
+        data->stream.close();
+    }
+
+    bool Tracer::isStreaming() const
+    {
+        std::lock_guard<std::mutex> lock(data->streamMutex);
+        return data->streaming;
+    }
+
+    void Tracer::Data::streamLoop()
+    {
+        std::unique_lock<std::mutex> lock(streamMutex);
+        while (true)
+        {
+            streamWake.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !streaming; });
+            //The last records are written after stopStream as well
+            writeStreamChunk();
+            if (!streaming) break;
+        }
+    }
+
+    void Tracer::Data::writeStreamChunk()
+    {
+        {
+            std::lock_guard<std::mutex> lock(namesMutex);
+            writeNames(stream, TRACE_CHUNK_EVENTS, events, eventsWritten);
+            writeNames(stream, TRACE_CHUNK_STRINGS, strings, stringsWritten);
+            eventsWritten = events.size();
+            stringsWritten = strings.size();
+        }
+
+        uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        streamRecords.clear();
+        {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            for (auto& buffer : buffers)
+            {
+                uint64_t from = buffer->streamed;
+                uint64_t first = buffer->copy(from, streamRecords, buffer->streamed);
+                if (first > from)
+                {
+                    TraceRecord dropped = { time, 0, TRACE_DROPPED, buffer->thread,
+                        { buffer->thread, (int32_t)(first - from), 0, 0 } };
+                    streamRecords.push_back(dropped);
+                }
+            }
+        }
+        writeRecords(stream, streamRecords);
+        stream.flush();
+    }
+}
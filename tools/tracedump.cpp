@@ -0,0 +1,244 @@
+//Prints a binary trace of Arya (see include/common/Trace.h)
+//as text, Chrome trace (chrome://tracing) or CSV.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include "common/Trace.h"
+
+using namespace std;
+using namespace Arya;
+
+typedef struct{
+    string name;
+    vector<string> args;
+} EventInfo;
+
+enum OutputFormat { FORMAT_TEXT, FORMAT_CHROME, FORMAT_CSV };
+
+map<uint32_t, EventInfo> events;
+map<uint32_t, string> strings;
+
+void readNames(const vector<char>& data, bool isEvents)
+{
+    size_t pos = 0;
+    while (pos + 2 * sizeof(uint32_t) <= data.size())
+    {
+        uint32_t entry[2];
+        memcpy(entry, &data[pos], sizeof(entry));
+        pos += sizeof(entry);
+        if (pos + entry[1] > data.size()) break;
+        string text(&data[pos], entry[1]);
+        pos += entry[1];
+
+        if (!isEvents)
+        {
+            strings[entry[0]] = text;
+            continue;
+        }
+        //"name|arg0,arg1"
+        EventInfo info;
+        size_t bar = text.find('|');
+        info.name = text.substr(0, bar);
+        if (bar != string::npos)
+        {
+            stringstream argNames(text.substr(bar + 1));
+            string arg;
+            while (getline(argNames, arg, ','))
+                info.args.push_back(arg);
+        }
+        events[entry[0]] = info;
+    }
+}
+
+const EventInfo& getEvent(uint32_t id)
+{
+    auto it = events.find(id);
+    if (it == events.end())
+    {
+        EventInfo info;
+        info.name = "event " + to_string(id);
+        for (int i = 0; i < 4; ++i)
+            info.args.push_back("arg" + to_string(i));
+        it = events.insert(make_pair(id, info)).first;
+    }
+    return it->second;
+}
+
+bool isStringArg(const string& name)
+{
+    return !name.empty() && name[0] == '$';
+}
+
+//Value of an argument, strings for names that start with $
+string argValue(const string& name, int32_t value)
+{
+    if (!isStringArg(name))
+        return to_string(value);
+    auto it = strings.find((uint32_t)value);
+    if (it == strings.end())
+        return "string " + to_string(value);
+    return it->second;
+}
+
+string argName(const string& name)
+{
+    return isStringArg(name) ? name.substr(1) : name;
+}
+
+string jsonString(const string& text)
+{
+    string result = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\') { result += '\\'; result += c; }
+        else if ((unsigned char)c < 0x20) { char buf[8]; snprintf(buf, sizeof(buf), "\\u%04x", c); result += buf; }
+        else result += c;
+    }
+    return result + "\"";
+}
+
+string csvString(const string& text)
+{
+    if (text.find_first_of(",\"\n") == string::npos) return text;
+    string result = "\"";
+    for (char c : text)
+    {
+        if (c == '"') result += '"';
+        result += c;
+    }
+    return result + "\"";
+}
+
+void printRecord(const TraceRecord& r, OutputFormat format, bool& first)
+{
+    const EventInfo& info = getEvent(r.event);
+    size_t argCount = info.args.size() < 4 ? info.args.size() : 4;
+    char buf[64];
+
+    if (format == FORMAT_TEXT)
+    {
+        snprintf(buf, sizeof(buf), "%14.6f ms  t%-3u ", r.time * 1e-6, r.thread);
+        cout << buf << info.name;
+        if (r.duration)
+        {
+            snprintf(buf, sizeof(buf), "  %.3f ms", r.duration * 1e-6);
+            cout << buf;
+        }
+        for (size_t i = 0; i < argCount; ++i)
+            cout << "  " << argName(info.args[i]) << "=" << argValue(info.args[i], r.args[i]);
+        cout << '\n';
+    }
+    else if (format == FORMAT_CSV)
+    {
+        snprintf(buf, sizeof(buf), "%.6f,%u,", r.time * 1e-6, r.thread);
+        cout << buf << csvString(info.name);
+        snprintf(buf, sizeof(buf), ",%.6f", r.duration * 1e-6);
+        cout << buf;
+        for (size_t i = 0; i < 4; ++i)
+            cout << ',' << (i < argCount ? csvString(argValue(info.args[i], r.args[i])) : to_string(r.args[i]));
+        cout << '\n';
+    }
+    else
+    {
+        //Chrome trace times are in microseconds
+        if (!first) cout << ",\n";
+        first = false;
+        cout << "{\"name\":" << jsonString(info.name) << ",\"cat\":\"arya\"";
+        if (r.duration)
+            snprintf(buf, sizeof(buf), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", r.time * 1e-3, r.duration * 1e-3);
+        else
+            snprintf(buf, sizeof(buf), ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f", r.time * 1e-3);
+        cout << buf << ",\"pid\":1,\"tid\":" << r.thread << ",\"args\":{";
+        for (size_t i = 0; i < argCount; ++i)
+        {
+            if (i) cout << ',';
+            cout << jsonString(argName(info.args[i])) << ':';
+            if (isStringArg(info.args[i]))
+                cout << jsonString(argValue(info.args[i], r.args[i]));
+            else
+                cout << r.args[i];
+        }
+        cout << "}}";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    OutputFormat format = FORMAT_TEXT;
+    string filename;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg(argv[i]);
+        if (arg == "-chrome") format = FORMAT_CHROME;
+        else if (arg == "-csv") format = FORMAT_CSV;
+        else filename = arg;
+    }
+    if (filename.empty())
+    {
+        cout << "Usage: " << argv[0] << " [-chrome|-csv] tracefile" << endl;
+        cout << "Example: " << argv[0] << " trace.bin" << endl;
+        cout << "Example: " << argv[0] << " -chrome trace.bin > trace.json" << endl;
+        return 0;
+    }
+
+    ifstream file(filename.c_str(), ios::binary);
+    if (!file.is_open())
+    {
+        cerr << "File not found: " << filename << endl;
+        return 1;
+    }
+
+    TraceFileHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || header.magic != traceMagic)
+    {
+        cerr << "File is not an Arya trace: " << filename << endl;
+        return 1;
+    }
+    if (header.version != traceVersion || header.recordSize != sizeof(TraceRecord))
+    {
+        cerr << "Unsupported trace version " << header.version << endl;
+        return 1;
+    }
+
+    if (format == FORMAT_CHROME)
+        cout << "{\"traceEvents\":[\n";
+    else if (format == FORMAT_CSV)
+        cout << "time_ms,thread,event,duration_ms,arg0,arg1,arg2,arg3\n";
+
+    bool first = true;
+    unsigned int recordCount = 0;
+    TraceChunk chunk;
+    vector<char> data;
+    while (file.read((char*)&chunk, sizeof(chunk)))
+    {
+        data.resize(chunk.size);
+        if (!file.read(data.data(), chunk.size))
+        {
+            //A stream that was cut off, for example by a crash
+            cerr << "Trace ends in the middle of a chunk" << endl;
+            break;
+        }
+        if (chunk.type == TRACE_CHUNK_EVENTS || chunk.type == TRACE_CHUNK_STRINGS)
+            readNames(data, chunk.type == TRACE_CHUNK_EVENTS);
+        else if (chunk.type == TRACE_CHUNK_RECORDS)
+        {
+            for (size_t pos = 0; pos + sizeof(TraceRecord) <= data.size(); pos += sizeof(TraceRecord))
+            {
+                TraceRecord r;
+                memcpy(&r, &data[pos], sizeof(r));
+                printRecord(r, format, first);
+                recordCount++;
+            }
+        }
+    }
+
+    if (format == FORMAT_CHROME)
+        cout << "\n]}\n";
+    cerr << recordCount << " records" << endl;
+    return 0;
+}